@@ -0,0 +1,219 @@
+/*
+ * This file is part of SionTower.
+ *
+ * 
+ * David Saltares M&aacute;rquez (C) 2011
+ * <david.saltares@gmail.com>
+ *
+ * 
+ * SionTower examples are free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License ad
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) ant later version.
+ *
+ * SionTower examples are distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SionTower examples.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/**
+ *  @file benchNavmesh.cpp
+ *  @date 19-10-2026
+ *
+ *  Banco de pruebas sin motor gráfico de la malla de navegación. Mide el
+ *  tiempo de cada fase de construcción, el pico de memoria del proceso y
+ *  los caminos por segundo entre celdas aleatorias.
+ *
+ *  Uso: bench_navmesh [-q consultas] [-c tamañoCluster] [-s lado] [malla.mesh.xml ...]
+ *
+ *  -s genera una malla sintética de lado x lado cuadrados (dos celdas por
+ *  cuadrado) con muros para ver dónde deja de escalar Floyd. Sin mallas
+ *  se usan las del directorio media y tres sintéticas.
+ */
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <cstdio>
+#include <algorithm>
+
+#include <OGRE/Ogre.h>
+
+#include "navigationMesh.h"
+#include "cell.h"
+
+
+using std::cout;
+using std::cerr;
+using std::endl;
+
+// Pico de memoria residente en KB (Linux), -1 si no se conoce
+static long getPeakMemory() {
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    
+    while (std::getline(status, line)) {
+        if (line.compare(0, 6, "VmHWM:") == 0)
+            return atol(line.c_str() + 6);
+    }
+    
+    return -1;
+}
+
+// Escribe una malla de side x side cuadrados con muros verticales abiertos
+// cada 8 filas, para que los caminos tengan que rodearlos
+static void writeSyntheticMesh(const std::string& fileName, int side) {
+    std::ofstream file(fileName.c_str());
+    
+    if (!file) {
+        cerr << "bench_navmesh: no se pudo escribir " << fileName << endl;
+        exit(1);
+    }
+    
+    file << "<mesh>\n<submeshes>\n<submesh>\n<faces>\n";
+    
+    for (int z = 0; z < side; ++z) {
+        for (int x = 0; x < side; ++x) {
+            if (x % 4 == 2 && z % 8 != 1)
+                continue;
+            
+            int a = z * (side + 1) + x;
+            int b = a + 1;
+            int c = a + side + 1;
+            int d = c + 1;
+            
+            // Mismo sentido de giro que las mallas exportadas
+            file << "<face v1=\"" << a << "\" v2=\"" << c << "\" v3=\"" << b << "\"/>\n";
+            file << "<face v1=\"" << b << "\" v2=\"" << c << "\" v3=\"" << d << "\"/>\n";
+        }
+    }
+    
+    file << "</faces>\n<geometry>\n<vertexbuffer>\n";
+    
+    for (int z = 0; z <= side; ++z)
+        for (int x = 0; x <= side; ++x)
+            file << "<vertex><position x=\"" << x << "\" y=\"0\" z=\"" << z << "\"/></vertex>\n";
+    
+    file << "</vertexbuffer>\n</geometry>\n</submesh>\n</submeshes>\n</mesh>\n";
+}
+
+static void runBenchmark(const std::string& name,
+                         const std::string& fileName,
+                         int clusterSize,
+                         int queries) {
+    NavigationMesh navigationMesh(fileName, clusterSize);
+    const NavigationMesh::BuildStats& stats = navigationMesh.getBuildStats();
+    int cellNumber = navigationMesh.getCellNumber();
+    
+    if (cellNumber == 0) {
+        cerr << "bench_navmesh: " << fileName << " no contiene celdas" << endl;
+        return;
+    }
+    
+    // Caminos entre centros de celdas aleatorias, siempre la misma secuencia
+    srand(1);
+    std::vector<Cell*> starts(queries), ends(queries);
+    
+    for (int i = 0; i < queries; ++i) {
+        starts[i] = navigationMesh.getCell(rand() % cellNumber);
+        ends[i] = navigationMesh.getCell(rand() % cellNumber);
+    }
+    
+    NavigationMesh::CellPath cellPath;
+    NavigationMesh::PointPath path;
+    int found = 0;
+    Ogre::Timer timer;
+    
+    for (int i = 0; i < queries; ++i)
+        navigationMesh.findCorridor(cellPath, starts[i], ends[i]);
+    
+    Ogre::Real corridorTime = timer.getMicroseconds() * 0.000001f;
+    timer.reset();
+    
+    for (int i = 0; i < queries; ++i)
+        found += navigationMesh.buildPath(path, starts[i]->getCenter(), ends[i]->getCenter(), starts[i], ends[i]);
+    
+    Ogre::Real pathTime = timer.getMicroseconds() * 0.000001f;
+    
+    printf("%-24s %7d %9.2f %9.2f %9.2f %10.2f %9.2f %10ld %12.0f %12.0f %6.1f%%\n",
+           name.c_str(),
+           cellNumber,
+           stats.parse,
+           stats.link,
+           stats.graph,
+           stats.floyd,
+           stats.clusters,
+           getPeakMemory(),
+           queries / std::max(corridorTime, 1e-6f),
+           queries / std::max(pathTime, 1e-6f),
+           100.0f * found / queries);
+}
+
+int main(int argc, char** argv) {
+    int queries = 10000;
+    int clusterSize = 0;
+    std::vector<std::string> meshes;
+    std::vector<int> synthetic;
+    
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        
+        if ((arg == "-q" || arg == "-c" || arg == "-s") && i + 1 < argc) {
+            int value = atoi(argv[++i]);
+            
+            if (arg == "-q")
+                queries = std::max(value, 1);
+            else if (arg == "-c")
+                clusterSize = value;
+            else
+                synthetic.push_back(value);
+        }
+        else if (arg[0] == '-') {
+            cerr << "Uso: bench_navmesh [-q consultas] [-c tamañoCluster] [-s lado] [malla.mesh.xml ...]" << endl;
+            return 1;
+        }
+        else {
+            meshes.push_back(arg);
+        }
+    }
+    
+    if (meshes.empty() && synthetic.empty()) {
+        meshes.push_back("media/navMesh.mesh.xml");
+        meshes.push_back("media/navmesh2.mesh.xml");
+        meshes.push_back("media/navMesh3.mesh.xml");
+        meshes.push_back("media/navMesh4.mesh.xml");
+        synthetic.push_back(8);
+        synthetic.push_back(16);
+        synthetic.push_back(24);
+    }
+    
+    printf("%-24s %7s %9s %9s %9s %10s %9s %10s %12s %12s %7s\n",
+           "malla", "celdas", "xml(ms)", "link(ms)", "grafo(ms)", "floyd(ms)",
+           "clust(ms)", "pico(KB)", "pasillos/s", "caminos/s", "hallados");
+    
+    for (std::vector<std::string>::iterator i = meshes.begin(); i != meshes.end(); ++i)
+        runBenchmark(*i, *i, clusterSize, queries);
+    
+    // Las sintéticas van en orden creciente: el pico de memoria es del proceso
+    std::sort(synthetic.begin(), synthetic.end());
+    
+    for (std::vector<int>::iterator i = synthetic.begin(); i != synthetic.end(); ++i) {
+        std::ostringstream name;
+        name << "rejilla " << *i << "x" << *i;
+        
+        std::string fileName = "bench_navmesh_synthetic.mesh.xml";
+        writeSyntheticMesh(fileName, *i);
+        runBenchmark(name.str(), fileName, clusterSize, queries);
+        remove(fileName.c_str());
+    }
+    
+    return 0;
+}
@@ -0,0 +1,571 @@
+/*
+ * This file is part of SionTower.
+ *
+ * 
+ * David Saltares M&aacute;rquez (C) 2011
+ * <david.saltares@gmail.com>
+ *
+ * 
+ * SionTower examples are free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License ad
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) ant later version.
+ *
+ * SionTower examples are distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SionTower examples.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+/**
+ *  @file benchSimulation.cpp
+ *  @date 19-10-2026
+ *
+ *  Simulación de los niveles sin motor gráfico ni sonido. Carga la malla de
+ *  navegación, el jugador y las apariciones de enemigos de los niveles reales
+ *  y ejecuta la IA de los enemigos (EnemyAI, la misma que usa Enemy, con sus
+ *  datos por tipo, búsqueda de caminos o campo de flujo, nivel de detalle,
+ *  SteeringSystem y VelocityObstacles) a paso fijo y tan rápido como sea
+ *  posible. No es el bucle de StateGame: no hay colisiones ni hechizos en
+ *  vuelo. Las animaciones no se simulan: los ataques son instantáneos. El
+ *  jugador recorre celdas aleatorias de la malla para obligar a los enemigos
+ *  a replanificar y alcanza cada segundo al enemigo visible más cercano, de
+ *  modo que los enemigos mueren y siguen apareciendo otros.
+ *
+ *  Con la misma semilla y sin presupuestos de tiempo (por defecto) la
+ *  simulación es determinista: la suma de control final sólo cambia si
+ *  cambia el comportamiento.
+ *
+ *  Uso: bench_simulation [-t segundos] [-f hercios] [-n copias] [-m máximo]
+ *                        [-b presupuestoIA] [-s semilla] [-c] [nivel ...]
+ *
+ *  -n repite cada aparición n veces para estresar la IA y -m limita los
+ *  enemigos simultáneos (0 sin límite; por defecto el máximo del nivel).
+ *  -c usa el campo de flujo aunque el nivel no lo active. Sin niveles se
+ *  simulan todos los del directorio media/levels.
+ *
+ *  Compilado con make perfil=si escribe al terminar bench_simulation-trace.json
+ *  (ver Profiler). Con make memoria=si informa de las reservas de memoria de
+ *  cada paso (ver AllocationTracker).
+ */
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <cstdio>
+#include <algorithm>
+
+#include <OGRE/Ogre.h>
+#include <boost/bind.hpp>
+
+#include "pugixml.hpp"
+#include "navigationMesh.h"
+#include "cell.h"
+#include "kinematic.h"
+#include "steering.h"
+#include "steeringBehaviours.h"
+#include "pathPlanner.h"
+#include "neighbourGrid.h"
+#include "velocityObstacles.h"
+#include "steeringSystem.h"
+#include "aiScheduler.h"
+#include "enemyAI.h"
+#include "profiler.h"
+#include "allocationTracker.h"
+
+
+using std::cout;
+using std::cerr;
+using std::endl;
+
+// Tipos de Enemy::Type que usa la simulación
+enum {GOBLIN, DEMON, GOLEM, SPIDER, PLAYER};
+
+static const Ogre::Real PLAYER_SPEED = 4.0f;
+
+// El jugador lanza una bola de fuego (Spell::FIRE) por segundo al enemigo
+// visible más cercano a su alcance
+static const Ogre::Real CAST_DELAY = 1.0f;
+static const Ogre::Real CAST_RANGE = 12.0f;
+static const int CAST_POWER = 2;
+
+// Aparición de un enemigo en el nivel
+struct Spawn {
+    int type;
+    Ogre::Vector3 position;
+    Ogre::Real time;
+    
+    bool operator < (const Spawn& spawn) const {return time < spawn.time;}
+};
+
+// Lo que la simulación necesita de un nivel
+struct LevelData {
+    std::string navigationMesh;
+    int clusterSize;
+    bool flowField;
+    int maxEnemies;
+    Ogre::Vector3 playerPosition;
+    std::vector<Spawn> spawns;
+};
+
+// Divide el nombre de una entidad como Level ("enemy.goblin.30.001")
+static std::vector<std::string> splitName(const std::string& name) {
+    std::vector<std::string> parts;
+    std::string::size_type start = 0;
+    
+    while (start <= name.size()) {
+        std::string::size_type end = name.find_first_of("-.", start);
+        
+        if (end == std::string::npos)
+            end = name.size();
+        
+        if (end > start)
+            parts.push_back(name.substr(start, end - start));
+        
+        start = end + 1;
+    }
+    
+    return parts;
+}
+
+static bool loadLevel(const std::string& id, LevelData& level) {
+    pugi::xml_document info;
+    pugi::xml_document scene;
+    std::string infoFile = "media/levels/" + id + "_info.xml";
+    std::string sceneFile = "media/levels/" + id + "_scene.xml";
+    
+    if (!info.load_file(infoFile.c_str()) || !scene.load_file(sceneFile.c_str())) {
+        cerr << "bench_simulation: no se pudo cargar el nivel " << id << endl;
+        return false;
+    }
+    
+    pugi::xml_node navigation = info.child("basicInfo").child("navigation");
+    level.clusterSize = navigation.attribute("clusterSize").as_int();
+    level.flowField = navigation.attribute("flowField").as_bool();
+    pugi::xml_attribute maxEnemies = info.child("basicInfo").child("enemies").attribute("max");
+    level.maxEnemies = maxEnemies? maxEnemies.as_int() : 5;
+    level.navigationMesh = "";
+    level.playerPosition = Ogre::Vector3::ZERO;
+    level.spawns.clear();
+    
+    pugi::xml_node nodes = scene.child("scene").child("nodes");
+    
+    for (pugi::xml_node node = nodes.first_child(); node; node = node.next_sibling()) {
+        pugi::xml_node entity = node.child("entity");
+        
+        if (!entity)
+            continue;
+        
+        pugi::xml_node positionNode = node.child("position");
+        Ogre::Vector3 position(positionNode.attribute("x").as_float(),
+                               positionNode.attribute("y").as_float(),
+                               positionNode.attribute("z").as_float());
+        
+        std::vector<std::string> parts = splitName(entity.attribute("name").value());
+        
+        if ((parts.size() == 3 || parts.size() == 4) && parts[0] == "enemy") {
+            Spawn spawn;
+            spawn.type = GOBLIN;
+            spawn.position = position;
+            spawn.time = atof(parts[2].c_str());
+            
+            // Como en Enemy, los tipos sin modelo propio usan el del gólem
+            if (parts[1] == "demon")
+                spawn.type = DEMON;
+            else if (parts[1] != "goblin")
+                spawn.type = GOLEM;
+            
+            level.spawns.push_back(spawn);
+        }
+        else if (parts.size() == 1 && parts[0] == "player") {
+            level.playerPosition = position;
+        }
+        else if (parts.size() == 1 && parts[0] == "navMesh") {
+            level.navigationMesh = std::string("media/") + entity.attribute("meshFile").value() + ".xml";
+        }
+    }
+    
+    std::stable_sort(level.spawns.begin(), level.spawns.end());
+    
+    if (level.navigationMesh.empty()) {
+        cerr << "bench_simulation: el nivel " << id << " no tiene malla de navegación" << endl;
+        return false;
+    }
+    
+    return true;
+}
+
+// Enemigo sin parte visual: la misma EnemyAI y los mismos datos que Enemy,
+// con IDLE y RUN. Sin animaciones, un ataque es instantáneo y el enemigo
+// vuelve a IDLE, y al quedarse sin energía desaparece.
+class SimEnemy {
+    public:
+        SimEnemy(int type, const Ogre::Vector3& position): type(type),
+                                                           ai(&kinematic),
+                                                           running(false) {
+            const EnemyAI::TypeData& data = EnemyAI::getTypeData(type);
+            kinematic.setPosition(position);
+            kinematic.setMaxSpeed(data.maxSpeed);
+            ai.setAttackDelay(data.attackDelay);
+            energy = data.energy;
+        }
+        
+        int type;
+        Kinematic kinematic;
+        EnemyAI ai;
+        bool running;
+        int energy;
+        int aiAgent;
+};
+
+// Generador congruencial propio para no depender de rand()
+static unsigned int nextRandom(unsigned int& state) {
+    state = state * 1664525u + 1013904223u;
+    return state >> 8;
+}
+
+struct Result {
+    int ticks;
+    int spawned;
+    int peak;
+    int attacks;
+    int kills;
+    Ogre::Real totalTime;
+    Ogre::Real maxTick;
+    Ogre::Real checksum;
+};
+
+static Result simulate(const LevelData& level,
+                       Ogre::Real seconds,
+                       Ogre::Real frequency,
+                       int copies,
+                       int maxEnemies,
+                       Ogre::Real aiBudget,
+                       unsigned int seed) {
+    NavigationMesh navigationMesh(level.navigationMesh, level.clusterSize);
+    
+    // Sin presupuestos de tiempo real para que sea determinista
+    PathPlanner pathPlanner(&navigationMesh, false, Ogre::Math::POS_INFINITY);
+    NeighbourGrid neighbourGrid;
+    VelocityObstacles velocityObstacles(&neighbourGrid);
+    SteeringSystem steeringSystem(&velocityObstacles);
+    AIScheduler aiScheduler;
+    aiScheduler.budget = aiBudget;
+    
+    // El jugador recorre celdas aleatorias
+    Kinematic player(level.playerPosition);
+    player.setMaxSpeed(PLAYER_SPEED);
+    NavigationMesh::PointPath playerPath;
+    FollowPath playerFollow(&player, &playerPath);
+    Steering steering;
+    unsigned int random = seed;
+    Ogre::Real castTime = 0.0f;
+    
+    Cell* playerCell = 0;
+    std::vector<Ogre::Vector3> enemyPositions;
+    std::vector<Cell*> enemyCells;
+    std::vector<bool> playerVisible;
+    
+    std::vector<SimEnemy*> enemies;
+    std::vector<Spawn>::const_iterator nextSpawn = level.spawns.begin();
+    int spawnCopy = 0;
+    
+    Result result;
+    result.ticks = (int)(seconds * frequency);
+    result.spawned = 0;
+    result.peak = 0;
+    result.attacks = 0;
+    result.kills = 0;
+    result.maxTick = 0.0f;
+    result.checksum = 0.0f;
+    
+    Ogre::Real deltaT = 1.0f / frequency;
+    Ogre::Timer total;
+    Ogre::Timer tick;
+    
+    for (int t = 0; t < result.ticks; ++t) {
+        // Un paso por cuadro: las reservas de memoria y los presupuestos de
+        // la IA y de los caminos se cuentan por paso
+        AllocationTracker::newFrame();
+        aiScheduler.resetBudget();
+        pathPlanner.resetBudget();
+        PROFILE_ZONE("benchSimulation/tick");
+        Ogre::Real gameTime = t * deltaT;
+        tick.reset();
+        
+        // Mismo orden que StateGame::update
+        navigationMesh.newFrame();
+        pathPlanner.update();
+        
+        if (level.flowField)
+            navigationMesh.updateFlowField(player.getPosition());
+        
+        // Jugador
+        if (playerPath.empty() || player.getPosition().distance(playerPath.back()) < 1.0f) {
+            Cell* goal = navigationMesh.getCell(nextRandom(random) % navigationMesh.getCellNumber());
+            
+            if (!navigationMesh.buildPath(playerPath, player.getPosition(), goal->getCenter(), 0, goal))
+                playerPath.clear();
+            
+            playerFollow.setPath(&playerPath);
+        }
+        
+        if (!playerPath.empty()) {
+            steering.setNone();
+            playerFollow.getSteering(steering);
+            player.update(steering, deltaT);
+        }
+        
+        // Apariciones, con la regla de StateGame::checkEnemySpawning
+        int room = maxEnemies > 0? maxEnemies : (maxEnemies == 0? -1 : level.maxEnemies);
+        
+        while (nextSpawn != level.spawns.end() &&
+               nextSpawn->time <= gameTime &&
+               (room < 0 || (int)enemies.size() < room)) {
+            // Las copias aparecen en anillo alrededor de la original
+            Ogre::Radian angle(Ogre::Math::TWO_PI * spawnCopy / copies);
+            Ogre::Vector3 offset(Ogre::Math::Cos(angle), 0.0f, Ogre::Math::Sin(angle));
+            Ogre::Vector3 position = nextSpawn->position + offset * (spawnCopy? 1.5f : 0.0f);
+            
+            SimEnemy* enemy = new SimEnemy(nextSpawn->type, position);
+            enemy->ai.setNavigationMesh(&navigationMesh);
+            enemy->ai.setPathPlanner(&pathPlanner);
+            enemy->ai.setFlowField(level.flowField);
+            enemy->ai.setSteeringSystem(&steeringSystem, enemy, EnemyAI::getTypeData(enemy->type).radius);
+            enemy->aiAgent = aiScheduler.addAgent();
+            enemies.push_back(enemy);
+            ++result.spawned;
+            
+            if (++spawnCopy == copies) {
+                spawnCopy = 0;
+                ++nextSpawn;
+            }
+        }
+        
+        result.peak = std::max(result.peak, (int)enemies.size());
+        
+        // Rejilla de vecinos como en StateGame::updateEnemies
+        neighbourGrid.clear();
+        neighbourGrid.addAgent(&player,
+                               player.getPosition(),
+                               player.getVelocity(),
+                               EnemyAI::getTypeData(PLAYER).radius,
+                               false);
+        
+        for (std::vector<SimEnemy*>::iterator i = enemies.begin(); i != enemies.end(); ++i)
+            neighbourGrid.addAgent(*i,
+                                   (*i)->kinematic.getPosition(),
+                                   (*i)->kinematic.getVelocity(),
+                                   EnemyAI::getTypeData((*i)->type).radius,
+                                   (*i)->running);
+        
+        neighbourGrid.build();
+        
+        // Línea de visión como en StateGame::sensePlayer
+        playerCell = navigationMesh.findCell(player.getPosition(), playerCell);
+        enemyPositions.clear();
+        enemyCells.clear();
+        
+        for (std::vector<SimEnemy*>::iterator i = enemies.begin(); i != enemies.end(); ++i) {
+            enemyPositions.push_back((*i)->kinematic.getPosition());
+            enemyCells.push_back((*i)->ai.getCurrentCell());
+        }
+        
+        navigationMesh.lineOfSightTest(player.getPosition(), playerCell, enemyPositions, enemyCells, playerVisible);
+        
+        for (int i = 0; i < (int)enemies.size(); ++i)
+            enemies[i]->ai.setPlayerVisible(playerVisible[i]);
+        
+        // El jugador ataca y los enemigos sin energía desaparecen, como en
+        // StateGame::eraseDeadEnemies, para que sigan apareciendo otros. El
+        // hechizo alcanza al instante a un enemigo visible.
+        castTime += deltaT;
+        
+        if (castTime >= CAST_DELAY) {
+            int target = -1;
+            Ogre::Real distance = CAST_RANGE * CAST_RANGE;
+            
+            for (int i = 0; i < (int)enemies.size(); ++i) {
+                Ogre::Real d = enemies[i]->kinematic.getPosition().squaredDistance(player.getPosition());
+                
+                if (playerVisible[i] && d < distance) {
+                    target = i;
+                    distance = d;
+                }
+            }
+            
+            if (target >= 0) {
+                castTime = 0.0f;
+                enemies[target]->energy -= CAST_POWER;
+                
+                if (enemies[target]->energy <= 0) {
+                    // Su posición final también entra en la suma de control
+                    const Ogre::Vector3& position = enemies[target]->kinematic.getPosition();
+                    result.checksum += (result.spawned + result.kills) * (position.x - position.z);
+                    
+                    aiScheduler.removeAgent(enemies[target]->aiAgent);
+                    delete enemies[target];
+                    enemies.erase(enemies.begin() + target);
+                    ++result.kills;
+                }
+            }
+        }
+        
+        // IA de los enemigos
+        int size = enemies.size();
+        int first = aiScheduler.newFrame(player.getPosition(), 0, size);
+        
+        for (int k = 0; k < size; ++k) {
+            SimEnemy* enemy = enemies[(first + k) % size];
+            Ogre::Real elapsed;
+            
+            // Enemy pide frecuencia completa al atacar y al sufrir daño. Sin
+            // cámara el radio no influye.
+            if (!aiScheduler.schedule(enemy->aiAgent,
+                                      enemy->kinematic.getPosition(),
+                                      EnemyAI::getTypeData(enemy->type).radius,
+                                      false,
+                                      deltaT,
+                                      elapsed)) {
+                enemy->ai.repeat();
+                continue;
+            }
+            
+            // Enemy::stateIdle y Enemy::stateRun
+            enemy->ai.addTime(elapsed);
+            
+            switch (enemy->ai.think(player.getPosition(), enemy->running)) {
+                case EnemyAI::ATTACK:
+                    enemy->ai.resetAttack();
+                    enemy->running = false;
+                    ++result.attacks;
+                    break;
+                case EnemyAI::CHASE:
+                    enemy->running = true;
+                    break;
+                case EnemyAI::LOST:
+                    enemy->running = false;
+                    break;
+                default:
+                    break;
+            }
+        }
+        
+        aiScheduler.endFrame();
+        
+        // Movimiento conjunto y altura sobre la malla
+        steeringSystem.update(deltaT);
+        
+        for (std::vector<SimEnemy*>::iterator i = enemies.begin(); i != enemies.end(); ++i)
+            (*i)->ai.followMesh();
+        
+        result.maxTick = std::max(result.maxTick, tick.getMicroseconds() * 0.001f);
+    }
+    
+    result.totalTime = total.getMicroseconds() * 0.001f;
+    
+    // Suma de control de la posición final de todos los agentes
+    result.checksum += player.getPosition().x + player.getPosition().z;
+    
+    for (int i = 0; i < (int)enemies.size(); ++i) {
+        const Ogre::Vector3& position = enemies[i]->kinematic.getPosition();
+        result.checksum += (i + 1) * (position.x - position.z);
+        delete enemies[i];
+    }
+    
+    return result;
+}
+
+int main(int argc, char** argv) {
+    Ogre::Real seconds = 120.0f;
+    Ogre::Real frequency = 60.0f;
+    int copies = 1;
+    int maxEnemies = -1;
+    Ogre::Real aiBudget = Ogre::Math::POS_INFINITY;
+    unsigned int seed = 1;
+    bool flowField = false;
+    std::vector<std::string> levels;
+    
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        
+        if (arg.size() == 2 && arg[0] == '-' && std::string("tfnmbs").find(arg[1]) != std::string::npos && i + 1 < argc) {
+            Ogre::Real value = atof(argv[++i]);
+            
+            if (arg == "-t")
+                seconds = std::max(value, 0.0f);
+            else if (arg == "-f")
+                frequency = std::max(value, 1.0f);
+            else if (arg == "-n")
+                copies = std::max((int)value, 1);
+            else if (arg == "-m")
+                maxEnemies = (int)value;
+            else if (arg == "-b")
+                aiBudget = value;
+            else
+                seed = (unsigned int)value;
+        }
+        else if (arg == "-c") {
+            flowField = true;
+        }
+        else if (arg[0] == '-') {
+            cerr << "Uso: bench_simulation [-t segundos] [-f hercios] [-n copias] [-m máximo] "
+                 << "[-b presupuestoIA] [-s semilla] [-c] [nivel ...]" << endl;
+            return 1;
+        }
+        else {
+            levels.push_back(arg);
+        }
+    }
+    
+    if (levels.empty()) {
+        levels.push_back("level01");
+        levels.push_back("level02");
+        levels.push_back("level03");
+        levels.push_back("level04");
+    }
+    
+    printf("%-10s %7s %9s %6s %9s %6s %11s %11s %9s %14s\n",
+           "nivel", "ticks", "enemigos", "pico", "ataques", "bajas", "ms/tick",
+           "max(ms)", "xTiempo", "control");
+    
+    for (std::vector<std::string>::iterator i = levels.begin(); i != levels.end(); ++i) {
+        LevelData level;
+        
+        if (!loadLevel(*i, level))
+            continue;
+        
+        level.flowField = level.flowField || flowField;
+        
+        Result result = simulate(level, seconds, frequency, copies, maxEnemies, aiBudget, seed);
+        
+        printf("%-10s %7d %9d %6d %9d %6d %11.4f %11.4f %9.1f %14.4f\n",
+               i->c_str(),
+               result.ticks,
+               result.spawned,
+               result.peak,
+               result.attacks,
+               result.kills,
+               result.totalTime / std::max(result.ticks, 1),
+               result.maxTick,
+               seconds * 1000.0f / std::max(result.totalTime, 1e-3f),
+               result.checksum);
+    }
+    
+    // Con el perfilador compilado, traza de las últimas zonas
+    PROFILE_DUMP("bench_simulation-trace.json");
+    
+    // Con el contador de reservas compilado, su informe
+    if (AllocationTracker::isEnabled()) {
+        printf("\n");
+        AllocationTracker::report(std::cout);
+    }
+    
+    return 0;
+}
@@ -26,7 +26,6 @@
 
 #include <OGRE/Ogre.h>
 #include <boost/unordered_map.hpp>
-#include <boost/function.hpp>
 
 #include "gameMesh.h"
 #include "kinematic.h"
@@ -61,8 +60,21 @@ class Actor: public GameMesh {
         /** Diccionario de animaciones para cada estado del actor */
         typedef boost::unordered_map<State, Ogre::AnimationState*> Animations;
         
-        /** Funciones de actualización lógica según cada estado del actor */
-        typedef boost::unordered_map<State, boost::function<void(Ogre::Real)> > UpdateStateMethods;
+        /** Número de estados, tamaño de las tablas indexadas por State */
+        static const int STATE_NUMBER = ERASE + 1;
+        
+        /**
+         * Función de actualización lógica de un estado. Las clases derivadas
+         * convierten sus métodos con static_cast.
+         */
+        typedef void (Actor::*UpdateStateMethod)(Ogre::Real);
+        
+        /**
+         * Tabla de funciones de actualización indexada por State (0 si el
+         * estado no tiene). Cada clase derivada define una tabla estática
+         * común a todas sus instancias.
+         */
+        typedef UpdateStateMethod UpdateStateMethods[STATE_NUMBER];
         
         /**
          * Constructor
@@ -215,10 +227,25 @@ class Actor: public GameMesh {
         Ogre::AnimationState* _currentAnimation;
         State _currentState;
         State _previousState;
-        UpdateStateMethods _updateMethods;
+        const UpdateStateMethod* _updateMethods;
+        
+        // Tabla sin funciones, por defecto
+        static const UpdateStateMethods NO_UPDATE_METHODS;
         
         void synchronizeFromKinematic();
+        
+        /**
+         * Llama a la función de actualización del estado actual, si la hay
+         */
+        void updateState(Ogre::Real deltaT);
 };
 
+inline void Actor::updateState(Ogre::Real deltaT) {
+    UpdateStateMethod method = _updateMethods[_currentState];
+    
+    if (method)
+        (this->*method)(deltaT);
+}
+
 
 #endif  // SIONTOWER_TRUNK_SRC_INCLUDE_ACTOR_H_
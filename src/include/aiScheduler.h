@@ -0,0 +1,217 @@
+/*
+ * This file is part of SionTower.
+ *
+ * 
+ * David Saltares M&aacute;rquez (C) 2011
+ * <david.saltares@gmail.com>
+ *
+ * 
+ * SionTower examples are free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License ad
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) ant later version.
+ *
+ * SionTower examples are distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SionTower examples.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SIONTOWER_TRUNK_SRC_INCLUDE_AISCHEDULER_H_
+#define SIONTOWER_TRUNK_SRC_INCLUDE_AISCHEDULER_H_
+
+#include <vector>
+
+#include <OGRE/Ogre.h>
+
+
+//! Nivel de detalle de la IA: frecuencia de actualización de cada agente
+
+/**
+ * @date 19-10-2026
+ * 
+ * Asigna a cada agente un periodo de actualización (en frames) según su
+ * distancia al foco (el protagonista) y si la cámara lo ve:
+ * 
+ * - Dentro de fullDistance, o si se pide expresamente, todos los frames.
+ * - Visible y dentro de nearDistance, todos los frames.
+ * - Dentro de farDistance, cada farPeriod / 2 frames; más allá, cada
+ * farPeriod frames.
+ * - Si la cámara no lo ve el periodo se duplica.
+ * 
+ * Los agentes con el mismo periodo se reparten entre frames según su
+ * identificador, de forma que el coste se mantiene estable. Mientras no le
+ * toca, un agente acumula el tiempo transcurrido y lo recibe entero en su
+ * siguiente actualización.
+ * 
+ * Además, la IA de todos los agentes dispone de un presupuesto de budget ms
+ * por cuadro de render, que resetBudget renueva y que comparten todos los
+ * frames (pasos fijos) simulados en ese cuadro. Agotado el presupuesto, los
+ * agentes a los que les tocaba se aplazan al frame siguiente, salvo los que
+ * piden frecuencia completa o están dentro de fullDistance: un enemigo que
+ * persigue al protagonista no puede perderse el frame en el que entra en su
+ * alcance de ataque. Para que no se aplacen siempre los mismos, el recorrido
+ * de cada frame empieza por el primer agente aplazado en el anterior
+ * (round-robin).
+ * 
+ * \code
+ * // Una vez por cuadro de render
+ * aiScheduler->resetBudget();
+ * 
+ * // En cada paso fijo
+ * int first = aiScheduler->newFrame(player->getPosition(), camera, agents.size());
+ * 
+ * for (int k = 0; k < agents.size(); ++k) {
+ *     Agent* agent = agents[(first + k) % agents.size()];
+ *     Ogre::Real elapsed;
+ *     
+ *     if (aiScheduler->schedule(agent->id, position, radius, false, deltaT, elapsed))
+ *         agent->think(elapsed);
+ * }
+ * 
+ * aiScheduler->endFrame();
+ * \endcode
+ */
+class AIScheduler {
+    public:
+        /**
+         * Distancia a la que siempre se actualiza, aunque se haya agotado el
+         * presupuesto (alcance de ataque y margen)
+         */
+        Ogre::Real fullDistance;
+        
+        /** Distancia hasta la que se actualiza todos los frames si es visible */
+        Ogre::Real nearDistance;
+        
+        /** Distancia a partir de la cual se usa el periodo máximo */
+        Ogre::Real farDistance;
+        
+        /** Periodo en frames de los agentes más lejanos y visibles */
+        int farPeriod;
+        
+        /** Milisegundos por cuadro de render para la IA de todos los agentes */
+        Ogre::Real budget;
+        
+        /**
+         * Constructor
+         * 
+         * @param fullDistance distancia a la que siempre se actualiza
+         * @param nearDistance distancia hasta la que se actualiza todos los
+         * frames si es visible
+         * @param farDistance distancia a partir de la cual se usa farPeriod
+         * @param farPeriod periodo en frames de los agentes lejanos
+         * @param budget milisegundos por cuadro de render para la IA
+         */
+        AIScheduler(Ogre::Real fullDistance = 4.0f,
+                    Ogre::Real nearDistance = 15.0f,
+                    Ogre::Real farDistance = 30.0f,
+                    int farPeriod = 4,
+                    Ogre::Real budget = 2.0f);
+        
+        /**
+         * @return identificador del agente, estable hasta que se elimine
+         */
+        int addAgent();
+        
+        /**
+         * Elimina al agente. Su identificador podrá reutilizarse.
+         * 
+         * @param agent identificador devuelto por addAgent
+         */
+        void removeAgent(int agent);
+        
+        /**
+         * Renueva el presupuesto. Debe llamarse una vez por cuadro de render,
+         * antes de sus pasos fijos.
+         */
+        void resetBudget();
+        
+        /**
+         * Comienza un nuevo frame. Debe llamarse justo antes de recorrer a
+         * los agentes.
+         * 
+         * @param focus posición respecto a la que se miden las distancias
+         * @param camera cámara para comprobar la visibilidad (0 para
+         * considerar visibles a todos)
+         * @param agentNumber número de agentes que se van a recorrer
+         * 
+         * @return posición por la que empezar a recorrer a los agentes
+         */
+        int newFrame(const Ogre::Vector3& focus, const Ogre::Camera* camera, int agentNumber);
+        
+        /**
+         * Termina el frame y suma el tiempo consumido al del cuadro
+         */
+        void endFrame();
+        
+        /**
+         * Decide si el agente se actualiza en este frame
+         * 
+         * @param agent identificador del agente
+         * @param position posición del agente
+         * @param radius radio de la esfera que lo envuelve, para la visibilidad
+         * @param fullRate si es true se actualiza en este frame aunque se
+         * haya agotado el presupuesto
+         * @param deltaT tiempo transcurrido desde el frame anterior
+         * @param elapsed tiempo acumulado desde su última actualización, sólo
+         * si se actualiza
+         * 
+         * @return true si el agente debe actualizarse en este frame, false si
+         * no le toca o se ha agotado el presupuesto
+         */
+        bool schedule(int agent,
+                      const Ogre::Vector3& position,
+                      Ogre::Real radius,
+                      bool fullRate,
+                      Ogre::Real deltaT,
+                      Ogre::Real& elapsed);
+        
+        /**
+         * @return número de agentes actualizados en el frame actual
+         */
+        int getUpdatedNumber() const;
+        
+        /**
+         * @return número de agentes aplazados por falta de presupuesto en el
+         * frame actual
+         */
+        int getDeferredNumber() const;
+        
+        /**
+         * @return milisegundos consumidos por la IA en el cuadro de render
+         * actual, hasta el último frame terminado
+         */
+        Ogre::Real getUsedTime() const;
+        
+    private:
+        // Tiempo acumulado y aplazamiento de cada agente por identificador
+        std::vector<Ogre::Real> _accumulated;
+        std::vector<bool> _deferred;
+        std::vector<int> _freeAgents;
+        
+        Ogre::Vector3 _focus;
+        const Ogre::Camera* _camera;
+        unsigned int _frame;
+        int _updated;
+        
+        // Presupuesto y round-robin. _stepStartTime es lo consumido en el
+        // cuadro antes del frame actual
+        Ogre::Timer _timer;
+        Ogre::Real _usedTime;
+        Ogre::Real _stepStartTime;
+        int _deferredNumber;
+        int _first;
+        int _visited;
+        int _firstDeferred;
+        
+        int getPeriod(const Ogre::Vector3& position, Ogre::Real radius) const;
+};
+
+inline int AIScheduler::getUpdatedNumber() const {return _updated;}
+inline int AIScheduler::getDeferredNumber() const {return _deferredNumber;}
+inline Ogre::Real AIScheduler::getUsedTime() const {return _usedTime;}
+
+#endif  // SIONTOWER_TRUNK_SRC_INCLUDE_AISCHEDULER_H_
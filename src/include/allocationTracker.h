@@ -0,0 +1,109 @@
+/*
+ * This file is part of SionTower.
+ *
+ * 
+ * David Saltares M&aacute;rquez (C) 2011
+ * <david.saltares@gmail.com>
+ *
+ * 
+ * SionTower examples are free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License ad
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) ant later version.
+ *
+ * SionTower examples are distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SionTower examples.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SIONTOWER_TRUNK_SRC_INCLUDE_ALLOCATIONTRACKER_H_
+#define SIONTOWER_TRUNK_SRC_INCLUDE_ALLOCATIONTRACKER_H_
+
+#include <string>
+#include <ostream>
+
+
+//! Cuenta las reservas de memoria de cada frame, por zona y por punto de llamada
+
+/**
+ * @date 19-10-2026
+ * 
+ * Si se compila con SIONTOWER_ALLOCATIONS definido (make memoria=si),
+ * sustituye los operator new globales para contar las reservas y sus bytes
+ * a partir de la primera llamada a newFrame. Sin esa opción los operadores
+ * son los de la biblioteca estándar y esta clase no cuenta nada.
+ * 
+ * Cada reserva se atribuye:
+ * 
+ * - Al frame en curso, cerrado por la siguiente llamada a newFrame.
+ * - A la zona del perfilador abierta en su hilo (ver Profiler). Sin el
+ * perfilador compilado (make perfil=si) todas quedan sin zona.
+ * - A su punto de llamada, la pila de las últimas llamadas (sólo con glibc).
+ * Al informar se muestra la primera función que no es de la biblioteca
+ * estándar, de boost ni del propio operator new.
+ * 
+ * El informe lista los peores frames con sus zonas principales, el total
+ * por zona y los puntos de llamada que más reservan. Las liberaciones no se
+ * cuentan.
+ * 
+ * Los objetos de OGRE (derivados de Ogre::AllocatedObject, como nodos,
+ * entidades u Ogre::Timer creados con new) y sus contenedores internos
+ * reservan con la política de memoria de OGRE, que llama a nedmalloc o a
+ * malloc según cómo se compilara y nunca pasa por operator new. Esas
+ * reservas no aparecen en el informe.
+ * 
+ * Capturar la pila hace cada reserva varias veces más lenta, así
+ * que los tiempos medidos con esta opción no son representativos.
+ * 
+ * \code
+ * // Al comenzar cada frame
+ * AllocationTracker::newFrame();
+ * ...
+ * // Al terminar
+ * AllocationTracker::report("siontower-allocations.txt");
+ * \endcode
+ */
+class AllocationTracker {
+    public:
+        /**
+         * @return true si se ha compilado con SIONTOWER_ALLOCATIONS
+         */
+        static bool isEnabled();
+        
+        /**
+         * Cierra el frame en curso y comienza el siguiente. La primera
+         * llamada activa el recuento.
+         */
+        static void newFrame();
+        
+        /**
+         * @return reservas del último frame cerrado
+         */
+        static unsigned long getFrameAllocations();
+        
+        /**
+         * @return bytes reservados en el último frame cerrado
+         */
+        static unsigned long long getFrameBytes();
+        
+        /**
+         * Escribe el informe de reservas
+         * 
+         * @param out flujo de destino
+         */
+        static void report(std::ostream& out);
+        
+        /**
+         * Escribe el informe de reservas
+         * 
+         * @param fileName fichero de destino
+         * @return true si pudo escribirse
+         */
+        static bool report(const std::string& fileName);
+};
+
+#endif  // SIONTOWER_TRUNK_SRC_INCLUDE_ALLOCATIONTRACKER_H_
@@ -40,6 +40,11 @@ class Player;
  * se desplaza, la cámara realiza un seguimiento suavizado. El usuario puede
  * rotar la cámara con el ratón alrededor del personaje y hacer zoom.
  * 
+ * La cámara forma parte de la simulación: el personaje se mueve y apunta
+ * respecto a ella. Se actualiza en cada paso fijo con la posición simulada
+ * del personaje y el movimiento del ratón recibido como eventos, de forma
+ * que una partida reproducida con InputRecorder es igual a cualquier
+ * velocidad de cuadro. Para dibujar se coloca entre los dos últimos pasos.
  */
 class CameraController {
     public:
@@ -47,22 +52,37 @@ class CameraController {
          * Constructor
          * 
          * @param camera cámara que hemos de controlar
-         * @param mouse ratón del sistema
          * @param player jugador al que hacemos el seguimiento
          */
-        CameraController(Ogre::Camera* camera, OIS::Mouse* mouse, Player* player);
+        CameraController(Ogre::Camera* camera, Player* player);
         
         /**
-         * Actualiza la cámara en función del ratón y del personaje. Es
-         * necesario llamar a este método una vez por cuadro de juego.
+         * Actualiza la cámara en función del ratón y del personaje y la
+         * coloca en su posición simulada. Es necesario llamar a este método
+         * en cada paso fijo, antes de actualizar al personaje.
          * 
-         * @param deltaT tiempo en segundos desde el anterior frame.
+         * @param deltaT tiempo en segundos del paso.
          */
         void update(Ogre::Real deltaT);
+        
+        /**
+         * Coloca la cámara para dibujar entre los dos últimos pasos. Debe
+         * llamarse una vez por cuadro de render, tras los pasos.
+         * 
+         * @param alpha fracción del paso aún no simulada, entre 0 y 1
+         */
+        void interpolate(Ogre::Real alpha);
+        
+        /**
+         * Acumula el movimiento del ratón para el siguiente paso: zoom con
+         * la rueda y giro con el botón derecho pulsado.
+         * 
+         * @param arg evento de ratón
+         */
+        void mouseMoved(const OIS::MouseEvent& arg);
     private:
         // Referencias
         Ogre::Camera* _camera;
-        OIS::Mouse* _mouse;
         Player* _player;
         
         // Parámetros constantes
@@ -79,7 +99,21 @@ class CameraController {
         
         Ogre::Vector3 _targetCenter;
         
-        void updateCameraFromParameters();
+        // Coordenadas del paso anterior, para interpolar
+        Ogre::Vector3 _previousCenter;
+        Ogre::Real _previousRadius;
+        Ogre::Real _previousPitch;
+        Ogre::Real _previousYaw;
+        
+        // Movimiento del ratón pendiente de aplicar
+        int _zoom;
+        int _pitchInput;
+        int _yawInput;
+        
+        void updateCameraFromParameters(const Ogre::Vector3& center,
+                                        Ogre::Real radius,
+                                        Ogre::Real pitch,
+                                        Ogre::Real yaw);
 };
 
 #endif  // SIONTOWER_TRUNK_SRC_INCLUDE_CAMERACONTROLLER_H_
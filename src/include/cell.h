@@ -25,8 +25,7 @@
 
 #include <OGRE/Ogre.h>
 
-#include "shape.h"
-#include "line2D.h"
+class NavigationMesh;
 
 //! Celda triangular de una malla de navegación
 
@@ -37,6 +36,10 @@
  * Esta clase modela las celdas que forman el grafo de las mallas de navegación
  * (clase NavigationMesh). Se utilizan para la búsqueda de caminos para
  * entidades inteligentes como los enemigos del juego.
+ * 
+ * Una celda es una vista ligera (malla e índice): los vértices, enlaces,
+ * normales de los lados, centros y planos viven en arrays contiguos de la
+ * malla de navegación, que es la que crea las celdas.
  */
 class Cell {
     public:
@@ -54,35 +57,13 @@ class Cell {
             VERT_C
         };
         
-        /** Enumerado con el resultado de clasificar un camino con respecto a una celda */
-        enum PathResult {
-            NO_RELATIONSHIP,
-            ENDING_CELL,	
-            EXITING_CELL,
-        };
-        
         /**
          * Constructor
          * 
-         * @param id identificador de la celda
-         * @param pointA primer punto del triángulo
-         * @param pointB segundo punto del triángulo
-         * @param pointC tercero punto del triángulo
-         * 
-         * El orden es relevante. Se supone que desde A hasta B, el triángulo
-         * queda a la derecha. Lo mismo debe ocurrir desde B a C y desde
-         * C a A. Esto es útil para optimizar intersecciones con los caminos
-         * dentro de las celdas de la malla.
+         * @param navigationMesh malla que contiene los datos de la celda
+         * @param id identificador de la celda (índice en la malla)
          */
-        Cell(int id,
-             const Ogre::Vector3& pointA,
-             const Ogre::Vector3& pointB,
-             const Ogre::Vector3& pointC);
-            
-        /**
-         * Destructor
-         */
-        ~Cell();
+        Cell(NavigationMesh* navigationMesh, int id);
         
         /**
          * @return identificador de la celda (se utiliza para obtener el
@@ -94,7 +75,7 @@ class Cell {
          * @param index índice del vértice a recuperar
          * @return punto de la celda según el índice
          */
-        const Ogre::Vector3& getVertex(int index);
+        const Ogre::Vector3& getVertex(int index) const;
         
         /**
          * @param side lado de la celda a consultar
@@ -104,63 +85,47 @@ class Cell {
         Cell* getLink(CellSide side) const;
         
         /**
-         * @param side lado por la que las celdas serán vecinas
-         * @param nueva celda vecina del lado side.
-         */
-        void setLink(CellSide side, Cell* cell);
-        
-        /**
-         * @param pointA un vértice de una celda
-         * @param pointB otro vértice de una celda
-         * @param cell celda a la que pertenecen los vértices
+         * @param cell celda vecina
+         * @param pointA primer extremo del lado común (salida)
+         * @param pointB segundo extremo del lado común (salida)
          * 
-         * @return true si los dos vértices pasados como parámetro corresponden
-         * a un lado de la celda actual, false si las dos celdas no son vecinas.
+         * @return true si cell es vecina de la celda actual, false en caso
+         * contrario. El lado común (portal) es el que atraviesan los caminos
+         * al pasar de una celda a otra.
          */
-        bool requestLink(const Ogre::Vector3& pointA,
-                         const Ogre::Vector3& pointB,
-                         Cell* cell);
+        bool getPortal(const Cell* cell,
+                       Ogre::Vector3& pointA,
+                       Ogre::Vector3& pointB) const;
         
         /**
          * @return punto central de la celda
          */
         const Ogre::Vector3& getCenter() const;
+        
+        /**
+         * @return multiplicador del coste de atravesar la celda (1 por
+         * defecto, mayor en zonas peligrosas y menor en zonas preferentes).
+         * Se lee del fichero de la malla y no cambia: Floyd, la búsqueda
+         * jerárquica y la heurística dependen de él. Para encarecer una celda
+         * durante la partida se usa NavigationMesh::setDynamicCost.
+         */
+        Ogre::Real getCost() const;
 
         /**
          * @param point punto a consultar
-         * @return true si el punto está dentro de la celda
+         * @return true si el punto está dentro de la celda en el plano XZ
          */
         bool containsPoint(const Ogre::Vector3& point) const;
         
-        /**
-         * @param path segmento con el camino en línea recta
-         * @param nextCell siguiente celda por la que pasaría el camino
-         * @param side lado por el que sale el camino de la celda (si sale)
-         * @param intersection punto de intersección del camino con la celda
-         * 
-         * @return resultado de clasificar el camino en la celda
-         */
-        PathResult classifyPathToCell(const Line2D& path,
-                                      Cell** nextCell,
-                                      CellSide &side,
-                                      Ogre::Vector2 &intersection);
-        
         /**
          * @param point punto dentro de la celda, se establece point.y
          * para corregir la altura del punto y ajustarse al plano tridimensional
          * que forma la celda
          */
-        void getHeight(Ogre::Vector3 &point);
+        void getHeight(Ogre::Vector3 &point) const;
     private:
-        // ID
+        NavigationMesh* _navigationMesh;
         int _id;
-    
-        // Geometría
-        Ogre::Vector3 _vertex[3];
-        Ogre::Vector3 _center;
-        Cell* _links[3];
-        Line2D _sides[3];
-        Plane _plane;
 };
 
 
@@ -0,0 +1,146 @@
+/*
+ * This file is part of SionTower.
+ *
+ * 
+ * David Saltares M&aacute;rquez (C) 2011
+ * <david.saltares@gmail.com>
+ *
+ * 
+ * SionTower examples are free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License ad
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) ant later version.
+ *
+ * SionTower examples are distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SionTower examples.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SIONTOWER_TRUNK_SRC_INCLUDE_CLUSTERGRAPH_H_
+#define SIONTOWER_TRUNK_SRC_INCLUDE_CLUSTERGRAPH_H_
+
+#include <vector>
+
+#include <OGRE/Ogre.h>
+
+#include "navigationMesh.h"
+
+class Cell;
+
+//! Grafo abstracto de grupos de celdas para la búsqueda jerárquica (HPA*)
+
+/**
+ * @date 19-10-2026
+ * 
+ * Agrupa las celdas de una NavigationMesh en clusters conexos de tamaño
+ * acotado. Las celdas con vecinos en otro cluster son entradas y forman
+ * los nodos del grafo abstracto. Al construirlo se precalcula el coste
+ * entre cada par de entradas de un mismo cluster, de forma que una búsqueda
+ * sólo recorre celdas dentro del cluster de origen y del de destino.
+ * 
+ * El camino se refina de forma perezosa: findPath sólo devuelve el pasillo
+ * de celdas hasta la salida del primer cluster. Al alcanzarlo se debe
+ * volver a buscar desde la nueva posición.
+ * 
+ * Pensado para mallas grandes en las que Floyd es demasiado costoso en
+ * tiempo y memoria.
+ */
+class ClusterGraph {
+    public:
+        /** Resultado de una búsqueda */
+        enum Result {
+            NO_PATH,
+            COMPLETE_PATH,
+            PARTIAL_PATH
+        };
+        
+        /**
+         * Constructor
+         * 
+         * @param navigationMesh malla de navegación con las celdas ya enlazadas
+         * @param clusterSize número máximo de celdas por cluster
+         * 
+         * Agrupa las celdas y precalcula el grafo abstracto.
+         */
+        ClusterGraph(NavigationMesh* navigationMesh, int clusterSize);
+        
+        /**
+         * @param startCell celda de comienzo
+         * @param endCell celda de destino
+         * @param cellPath pasillo de celdas contiguas (salida)
+         * 
+         * @return COMPLETE_PATH si el pasillo llega hasta endCell, PARTIAL_PATH
+         * si sólo llega hasta la primera celda fuera del cluster de origen y
+         * NO_PATH si no existe camino.
+         */
+        Result findPath(Cell* startCell, Cell* endCell, NavigationMesh::CellPath& cellPath);
+        
+        /**
+         * @return número de clusters
+         */
+        int getClusterNumber() const;
+        
+        /**
+         * @return número de entradas (nodos del grafo abstracto)
+         */
+        int getEntranceNumber() const;
+        
+        /**
+         * @param cell celda de la malla
+         * @return cluster al que pertenece la celda
+         */
+        int getCluster(const Cell* cell) const;
+        
+    private:
+        struct Edge {
+            int to;
+            Ogre::Real cost;
+        };
+        
+        struct Entrance {
+            int cell;
+            int cluster;
+            std::vector<Edge> edges;
+        };
+        
+        NavigationMesh* _navigationMesh;
+        int _cellNumber;
+        int _clusterNumber;
+        
+        std::vector<int> _cellCluster;
+        std::vector<int> _cellEntrance;
+        std::vector<std::vector<int> > _clusterEntrances;
+        std::vector<Entrance> _entrances;
+        
+        // Estado reutilizable de las búsquedas sobre celdas
+        std::vector<Ogre::Real> _cellCost;
+        std::vector<int> _cellParent;
+        std::vector<int> _cellStamp;
+        std::vector<int> _cellClosed;
+        
+        // Estado reutilizable de las búsquedas sobre entradas
+        std::vector<Ogre::Real> _entranceCost;
+        std::vector<Ogre::Real> _entranceGoalCost;
+        std::vector<int> _entranceParent;
+        std::vector<int> _entranceStamp;
+        std::vector<int> _entranceClosed;
+        
+        int _searchStamp;
+        
+        void buildClusters(int clusterSize);
+        void buildEntrances();
+        
+        Ogre::Real getCost(int cellA, int cellB);
+        Ogre::Real getHeuristic(const Ogre::Vector3& goal, int cell);
+        bool searchCells(int source, int target, int cluster);
+        void recoverCells(int source, int target, NavigationMesh::CellPath& cellPath);
+};
+
+inline int ClusterGraph::getClusterNumber() const {return _clusterNumber;}
+inline int ClusterGraph::getEntranceNumber() const {return _entrances.size();}
+
+#endif  // SIONTOWER_TRUNK_SRC_INCLUDE_CLUSTERGRAPH_H_
@@ -29,9 +29,13 @@
 #include "navigationMesh.h"
 #include "cell.h"
 #include "kinematic.h"
+#include "pathPlanner.h"
+#include "enemyAI.h"
 #include "soundFX.h"
 
 class StateGame;
+class SteeringSystem;
+class AIScheduler;
 
 
 //! Clase que modela a los enemigos y contiene su comportamiento (IA)
@@ -41,12 +45,14 @@ class StateGame;
  * @date 20-05-2011
  * 
  * La clase Enemy se encarga de modelar a todos los enemigos del juego
- * (Goblin, Demonio, Araña y Gólem). Utiliza las clases SteeringBehaviour y
- * NavigationMesh para modelar su comportamiento.
+ * (Goblin, Demonio, Araña y Gólem). Las decisiones las toma EnemyAI, que
+ * también usa bench_simulation; Enemy añade las animaciones, el sonido y el
+ * daño.
  * 
  * Se ha modelado un comportamiento único para todos los enemigos: perseguir
  * al protagonista y atacar cuando esté dentro del rango de alcance. Los enemigos
- * evitan colisionar entre ellos mismos.
+ * evitan colisionar entre ellos mismos y con el protagonista mediante
+ * VelocityObstacles.
  */
 class Enemy: public Actor {
     public:
@@ -91,31 +97,89 @@ class Enemy: public Actor {
         Type getEnemyType() const;
         
         /**
-         * @param deltaT tiempo en ms desde el último frame
+         * @param type tipo de enemigo (PLAYER para el protagonista)
+         * @return radio en el plano XZ con el que se evita a los demás
+         * agentes
+         */
+        static Ogre::Real getAvoidanceRadius(Type type);
+        
+        /**
+         * @param deltaT tiempo en segundos desde el último frame
          * 
-         * Actualiza al enemigo según la IA
+         * Fase de decisión: actualiza al enemigo según la IA (objetivo,
+         * búsqueda de caminos y cambios de estado). El movimiento pedido se
+         * integra después en SteeringSystem::update y synchronizeMovement.
+         * Con AIScheduler los enemigos lejanos, o los que no caben en el
+         * presupuesto del frame, no piensan y repiten su último movimiento,
+         * pero su animación avanza igualmente.
          */
         virtual void update(Ogre::Real deltaT);
         
+        /**
+         * Fase de integración: ajusta la altura a la malla de navegación y
+         * sincroniza el nodo y el body con la cinemática. Debe llamarse tras
+         * SteeringSystem::update todos los frames.
+         */
+        void synchronizeMovement();
+        
         /**
          * @param navigationMesh malla de navegación para realizar las consultas
          * de la búsqueda de caminos.
          */
         void setNavigationMesh(NavigationMesh* navigationMesh);
         
+        /**
+         * @param pathPlanner servicio al que se solicitan los caminos. El
+         * enemigo sigue su camino anterior hasta recibir el nuevo.
+         */
+        void setPathPlanner(PathPlanner* pathPlanner);
+        
+        /**
+         * @param flowField si es true el enemigo persigue al jugador con el
+         * campo de flujo de la malla en lugar de solicitar caminos
+         */
+        void setFlowField(bool flowField);
+        
+        /**
+         * @param steeringSystem sistema en el que se registra el enemigo para
+         * moverse junto al resto
+         */
+        void setSteeringSystem(SteeringSystem* steeringSystem);
+        
+        /**
+         * @param aiScheduler planificador que decide en qué frames se
+         * actualiza la IA del enemigo (0 para actualizarla siempre)
+         */
+        void setAIScheduler(AIScheduler* aiScheduler);
+        
+        /**
+         * @param playerVisible true si hay línea de visión sobre la malla de
+         * navegación entre el enemigo y el protagonista. Mientras la haya, el
+         * enemigo va derecho hacia él sin pedir caminos.
+         */
+        void setPlayerVisible(bool playerVisible);
+        
+        /**
+         * @param center centro de la zona peligrosa de la que debe huir
+         * @param radius radio de la zona, 0 si no está en ninguna. Huir
+         * tiene prioridad sobre la persecución (ver SteeringSystem).
+         */
+        void setThreat(const Ogre::Vector3& center, Ogre::Real radius);
+        
+        /**
+         * @return celda de la malla de navegación en la que está el enemigo
+         */
+        Cell* getCurrentCell() const;
+        
     private:
         Type _type;
         
-        // Timer de ataque
-        Ogre::Timer* _attackTimer;
-        Ogre::Real _attackDelay;
+        // Persecución, ataque y movimiento
+        EnemyAI _ai;
         
-        // Búsqueda de caminos
-        NavigationMesh* _navigationMesh;
-        NavigationMesh::PointPath _path;
-        NavigationMesh::PointPath::iterator _pathIt;
-        Cell* _currentCell;
-        bool _pathActive;
+        // Nivel de detalle de la IA
+        AIScheduler* _aiScheduler;
+        int _aiAgent;
         
         // Barra de vida
         Ogre::BillboardSet* _bbSetLife;
@@ -131,16 +195,23 @@ class Enemy: public Actor {
         void loadDemonEnemy();
         void loadGolemEnemy();
         
+        void think(Ogre::Real deltaT);
+        
+        // Métodos de actualización
+        static const UpdateStateMethods UPDATE_METHODS;
+        
         void stateDamaged(Ogre::Real deltaT);
         void stateDie(Ogre::Real deltaT);
         void stateAttack(Ogre::Real deltaT);
         void stateIdle(Ogre::Real deltaT);
         void stateRun(Ogre::Real deltaT);
         
-        void goToLocation(const Ogre::Vector3& goal, Cell* goalCell);
-        
         void updateLifeBar();
 };
 
+inline void Enemy::setPlayerVisible(bool playerVisible) {_ai.setPlayerVisible(playerVisible);}
+inline void Enemy::setThreat(const Ogre::Vector3& center, Ogre::Real radius) {_ai.setThreat(center, radius);}
+inline Cell* Enemy::getCurrentCell() const {return _ai.getCurrentCell();}
+
 
 #endif  // SIONTOWER_TRUNK_SRC_INCLUDE_ENEMY_H_
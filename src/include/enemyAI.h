@@ -0,0 +1,248 @@
+/*
+ * This file is part of SionTower.
+ *
+ * 
+ * David Saltares M&aacute;rquez (C) 2011
+ * <david.saltares@gmail.com>
+ *
+ * 
+ * SionTower examples are free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License ad
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) ant later version.
+ *
+ * SionTower examples are distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SionTower examples.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef SIONTOWER_TRUNK_SRC_INCLUDE_ENEMYAI_H_
+#define SIONTOWER_TRUNK_SRC_INCLUDE_ENEMYAI_H_
+
+#include <OGRE/Ogre.h>
+
+#include "kinematic.h"
+#include "steeringBehaviours.h"
+#include "navigationMesh.h"
+#include "pathPlanner.h"
+
+class Cell;
+class SteeringSystem;
+
+
+//! Decisiones de un enemigo independientes del motor gráfico
+
+/**
+ * @date 19-10-2026
+ * 
+ * Contiene la persecución y el ataque de Enemy sin animaciones, sonido ni
+ * nodos de escena, de forma que el juego y bench_simulation ejecutan la misma
+ * IA:
+ * 
+ * - Parado (chasing a false): si el objetivo está a su alcance espera a que
+ * pase el retraso de ataque y ataca; si no, empieza a perseguirlo.
+ * - Persiguiendo (chasing a true): sigue el campo de flujo, va derecho si ve
+ * al objetivo o sigue el camino de PathPlanner, que vuelve a pedir si el
+ * objetivo se aleja, si el camino era parcial o si su pasillo se ha marcado.
+ * Ataca en cuanto lo tiene a su alcance y el retraso ha pasado.
+ * 
+ * El movimiento se pide a SteeringSystem; tras su update, followMesh ajusta
+ * la cinemática a la malla de navegación. Dentro de una zona peligrosa
+ * (setThreat) añade además una huida con más prioridad que la persecución.
+ * 
+ * \code
+ * EnemyAI::Decision decision = enemyAI.think(player->getPosition(), getState() == RUN);
+ * \endcode
+ */
+class EnemyAI {
+    public:
+        /** Resultado de think */
+        enum Decision {
+            WAIT,
+            CHASE,
+            ATTACK,
+            LOST
+        };
+        
+        /** Distancia a la que el enemigo alcanza a su objetivo */
+        static const Ogre::Real ATTACK_RANGE;
+        
+        /** Datos de juego de un tipo de enemigo */
+        struct TypeData {
+            Ogre::Real maxSpeed;
+            Ogre::Real radius;
+            Ogre::Real attackDelay;
+            int energy;
+            int power;
+        };
+        
+        /**
+         * @param type tipo de enemigo (Enemy::Type, de PLAYER sólo es válido
+         * el radio)
+         * @return rapidez máxima, radio en el plano XZ para la evitación,
+         * retraso de ataque, energía y potencia del tipo. Enemy y
+         * bench_simulation usan los mismos.
+         */
+        static const TypeData& getTypeData(int type);
+        
+        /**
+         * Constructor
+         * 
+         * @param kinematic cinemática del enemigo, debe existir mientras
+         * exista la IA
+         */
+        EnemyAI(Kinematic* kinematic);
+        
+        /**
+         * Destructor, descarta la petición de camino en curso y elimina al
+         * agente de SteeringSystem
+         */
+        ~EnemyAI();
+        
+        /**
+         * @param navigationMesh malla de navegación en la que se mueve
+         */
+        void setNavigationMesh(NavigationMesh* navigationMesh);
+        
+        /**
+         * @param pathPlanner servicio al que se solicitan los caminos
+         */
+        void setPathPlanner(PathPlanner* pathPlanner);
+        
+        /**
+         * @param flowField si es true persigue con el campo de flujo de la
+         * malla en lugar de solicitar caminos
+         */
+        void setFlowField(bool flowField);
+        
+        /**
+         * @param steeringSystem sistema en el que se registra para moverse
+         * @param owner identificador del enemigo en la NeighbourGrid
+         * @param radius radio para la evitación local
+         */
+        void setSteeringSystem(SteeringSystem* steeringSystem, const void* owner, Ogre::Real radius);
+        
+        /**
+         * @param attackDelay segundos entre dos ataques
+         */
+        void setAttackDelay(Ogre::Real attackDelay);
+        
+        /**
+         * @param playerVisible true si hay línea de visión con el objetivo
+         */
+        void setPlayerVisible(bool playerVisible);
+        
+        /**
+         * @param center centro de la zona peligrosa más cercana
+         * @param radius radio de la zona, 0 si no hay ninguna
+         */
+        void setThreat(const Ogre::Vector3& center, Ogre::Real radius);
+        
+        /**
+         * @return celda de la malla de navegación en la que está
+         */
+        Cell* getCurrentCell() const;
+        
+        /**
+         * @param deltaT segundos de simulación transcurridos
+         */
+        void addTime(Ogre::Real deltaT);
+        
+        /**
+         * @return true si ha pasado el retraso de ataque desde el último
+         */
+        bool isAttackReady() const;
+        
+        /**
+         * Vuelve a contar el retraso de ataque
+         */
+        void resetAttack();
+        
+        /**
+         * @param target posición del objetivo
+         * @return true si el objetivo está a su alcance
+         */
+        bool isInRange(const Ogre::Vector3& target) const;
+        
+        /**
+         * Decide qué hacer en este frame y pide el movimiento
+         * correspondiente a SteeringSystem
+         * 
+         * @param target posición del objetivo
+         * @param chasing true si ya lo estaba persiguiendo
+         * 
+         * @return WAIT si espera para atacar, CHASE si lo persigue, ATTACK si
+         * debe atacar (ya está parado y mirándolo) y LOST si no hay camino
+         * hacia él
+         */
+        Decision think(const Ogre::Vector3& target, bool chasing);
+        
+        /**
+         * Repite el movimiento del frame anterior, para los frames en los que
+         * no piensa
+         */
+        void repeat();
+        
+        /**
+         * Actualiza la celda actual y ajusta la altura a la malla (rampas y
+         * escaleras). Debe llamarse tras SteeringSystem::update.
+         */
+        void followMesh();
+        
+    private:
+        Kinematic* _kinematic;
+        
+        // Ataque
+        Ogre::Real _attackTime;
+        Ogre::Real _attackDelay;
+        
+        // Búsqueda de caminos
+        NavigationMesh* _navigationMesh;
+        PathPlanner* _pathPlanner;
+        NavigationMesh::PointPath _path;
+        FollowPath _followPath;
+        Cell* _currentCell;
+        bool _pathActive;
+        bool _pathPartial;
+        bool _pathPending;
+        bool _pathLost;
+        Ogre::Vector3 _pathGoal;
+        NavigationMesh::CellPath _corridor;
+        int _pathRevision;
+        bool _playerVisible;
+        
+        // Campo de flujo
+        bool _flowField;
+        
+        // Movimiento conjunto
+        SteeringSystem* _steeringSystem;
+        int _steeringAgent;
+        
+        // Zona peligrosa
+        Kinematic _threat;
+        Ogre::Real _threatRadius;
+        Flee _flee;
+        
+        Decision chase(const Ogre::Vector3& target);
+        bool followFlowField();
+        void avoidThreat();
+        void goToLocation(const Ogre::Vector3& goal);
+        void pathFound(const PathPlanner::Result& result);
+};
+
+inline void EnemyAI::setPathPlanner(PathPlanner* pathPlanner) {_pathPlanner = pathPlanner;}
+inline void EnemyAI::setFlowField(bool flowField) {_flowField = flowField;}
+inline void EnemyAI::setAttackDelay(Ogre::Real attackDelay) {_attackDelay = attackDelay;}
+inline void EnemyAI::setPlayerVisible(bool playerVisible) {_playerVisible = playerVisible;}
+inline void EnemyAI::setThreat(const Ogre::Vector3& center, Ogre::Real radius) {_threat.setPosition(center); _threatRadius = radius;}
+inline Cell* EnemyAI::getCurrentCell() const {return _currentCell;}
+inline void EnemyAI::addTime(Ogre::Real deltaT) {_attackTime += deltaT;}
+inline bool EnemyAI::isAttackReady() const {return _attackTime >= _attackDelay;}
+inline void EnemyAI::resetAttack() {_attackTime = 0.0f;}
+
+#endif  // SIONTOWER_TRUNK_SRC_INCLUDE_ENEMYAI_H_
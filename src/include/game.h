@@ -30,6 +30,8 @@
 #include <MYGUI/MyGUI.h>
 #include <MYGUI/MyGUI_OgrePlatform.h>
 
+#include "inputRecorder.h"
+
 class StateManager;
 class SongManager;
 class SoundFXManager;
@@ -54,10 +56,14 @@ class Game {
         /**
          *  Constructor
          *
+         *  @param inputMode modo de grabaci&oacute;n de la entrada (ver InputRecorder)
+         *  @param inputFile fichero de grabaci&oacute;n de la entrada
+         *
          *  Inicia Ogre, OIS, SDL y MYGUI. Prepara el juego y crea el gestor de
          *  estados.
          */
-        Game();
+        Game(InputRecorder::Mode inputMode = InputRecorder::NONE,
+             const Ogre::String& inputFile = "");
 
         /**
          *  Destructor
@@ -116,6 +122,9 @@ class Game {
         MyGUI::Gui* _myGUI;
         MyGUI::OgrePlatform* _ogrePlatform;
         
+        // Grabación y reproducción de la entrada
+        InputRecorder* _inputRecorder;
+        
         // Gestor Estados
         StateManager* _stateManager;
         
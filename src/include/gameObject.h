@@ -177,11 +177,42 @@ class GameObject {
          *  juego modificando par&aacute;metros del body.
          */
         void synchronizeSceneNode();
+        
+        /**
+         *  Guarda la posición y orientación del nodo antes de un paso fijo de
+         *  simulación. Si el nodo estaba interpolado recupera antes el
+         *  estado simulado.
+         */
+        void saveTransform();
+        
+        /**
+         *  @param alpha fracción del paso fijo transcurrida desde el último
+         *  paso simulado, entre 0 y 1.
+         *
+         *  Coloca el nodo entre la transformación guardada con
+         *  GameObject::saveTransform y la simulada, sólo para dibujarlo. El
+         *  Body no cambia.
+         */
+        void interpolateTransform(Ogre::Real alpha);
+        
+        /**
+         *  Devuelve el nodo a la transformación simulada si estaba
+         *  interpolado.
+         */
+        void restoreTransform();
     protected:
         Ogre::SceneManager* _sceneManager;
         Ogre::SceneNode* _node;
         Body* _body;
         std::vector<Shape*> _shapes;
+        
+        // Interpolación entre pasos fijos
+        Ogre::Vector3 _previousPosition;
+        Ogre::Quaternion _previousOrientation;
+        Ogre::Vector3 _position;
+        Ogre::Quaternion _orientation;
+        bool _savedTransform;
+        bool _interpolated;
 };
 
 #endif  // SIONTOWER_TRUNK_SRC_INCLUDE_GAMEOBJECT_H_
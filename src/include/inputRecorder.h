@@ -0,0 +1,244 @@
+/*
+ * This file is part of SionTower.
+ *
+ * 
+ * David Saltares M&aacute;rquez (C) 2011
+ * <david.saltares@gmail.com>
+ *
+ * 
+ * SionTower examples are free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License ad
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) ant later version.
+ *
+ * SionTower examples are distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SionTower examples.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SIONTOWER_TRUNK_SRC_INCLUDE_INPUTRECORDER_H_
+#define SIONTOWER_TRUNK_SRC_INCLUDE_INPUTRECORDER_H_
+
+#include <vector>
+#include <fstream>
+
+#include <OGRE/Ogre.h>
+#include <OIS/OIS.h>
+
+class ReplayKeyboard;
+class ReplayMouse;
+
+
+//! Graba y reproduce la entrada del jugador para repetir partidas exactas
+
+/**
+ * @date 19-10-2026
+ * 
+ * En modo RECORD guarda en un fichero binario la semilla aleatoria del juego
+ * y los eventos de teclado y ratón que recibe StateManager, agrupados por
+ * paso fijo de simulación. En modo REPLAY lee el fichero, devuelve la misma
+ * semilla y vuelve a entregar los eventos a StateManager en los mismos pasos,
+ * ignorando los dispositivos reales. El estado que se consulta por sondeo
+ * (isKeyDown, getMouseState) lo mantienen un teclado y un ratón de
+ * reproducción que se actualizan con cada evento entregado.
+ * 
+ * Los eventos de un mismo paso se dividen en lotes, uno por cuadro en que
+ * se capturaron. Si un lote provoca un cambio de estado, el resto se entrega
+ * en el cuadro siguiente, igual que ocurrió al grabar.
+ * 
+ * Formato del fichero (little endian):
+ * 
+ * - Cabecera: "STIR", versión (uint32) y semilla (uint32).
+ * - Registros de un byte de tipo (Record) seguidos de sus datos: tecla
+ * (uint16) y texto (uint32) para los de teclado; botón (uint8, sólo al
+ * pulsar o soltar) y estado del ratón (9 int32) para los de ratón.
+ * 
+ * Reproducir sólo garantiza la misma partida si la simulación no depende
+ * del reloj, ver isDeterministic, y con la misma resolución de ventana: el
+ * protagonista apunta con la posición del ratón en píxeles.
+ */
+class InputRecorder {
+    public:
+        /**
+         * Modos de funcionamiento
+         */
+        enum Mode {NONE, RECORD, REPLAY};
+        
+        /**
+         * Constructor
+         * 
+         * @param mode modo de funcionamiento
+         * @param fileName fichero en el que grabar o del que reproducir. Si
+         * no puede abrirse o no es válido, el juego termina con un error.
+         */
+        InputRecorder(Mode mode = NONE, const Ogre::String& fileName = "");
+        
+        /**
+         * Destructor, cierra el fichero de grabación
+         */
+        ~InputRecorder();
+        
+        /**
+         * @return modo de funcionamiento
+         */
+        Mode getMode() const;
+        
+        /**
+         * @return true si se graba o reproduce. En ese caso la simulación
+         * debe prescindir de presupuestos de tiempo y de hilos, cuyos
+         * resultados dependen del reloj.
+         */
+        bool isDeterministic() const;
+        
+        /**
+         * @return semilla para srand: la grabada al reproducir, la hora
+         * actual en otro caso
+         */
+        unsigned int getSeed() const;
+        
+        /**
+         * @return teclado que deben consultar los estados: el de reproducción
+         * en modo REPLAY, keyboard en otro caso
+         */
+        OIS::Keyboard* getKeyboard(OIS::Keyboard* keyboard);
+        
+        /**
+         * @return ratón que deben consultar los estados: el de reproducción
+         * en modo REPLAY, mouse en otro caso
+         */
+        OIS::Mouse* getMouse(OIS::Mouse* mouse);
+        
+        /**
+         * Marca el comienzo de un cuadro, antes de capturar la entrada
+         * 
+         * @param frameTime duración del cuadro anterior, para las
+         * estadísticas de reproducción
+         */
+        void newFrame(Ogre::Real frameTime);
+        
+        /**
+         * @param arg evento de teclado
+         * @return false si el evento debe descartarse (viene de un
+         * dispositivo real durante la reproducción). Al grabar lo guarda.
+         */
+        bool keyPressed(const OIS::KeyEvent& arg);
+        
+        /**
+         * @see keyPressed
+         */
+        bool keyReleased(const OIS::KeyEvent& arg);
+        
+        /**
+         * @see keyPressed
+         */
+        bool mouseMoved(const OIS::MouseEvent& arg);
+        
+        /**
+         * @see keyPressed
+         */
+        bool mousePressed(const OIS::MouseEvent& arg, OIS::MouseButtonID id);
+        
+        /**
+         * @see keyPressed
+         */
+        bool mouseReleased(const OIS::MouseEvent& arg, OIS::MouseButtonID id);
+        
+        /**
+         * Entrega el siguiente lote de eventos grabados del paso actual
+         * 
+         * @param keyListener receptor de los eventos de teclado
+         * @param mouseListener receptor de los eventos de ratón
+         * @return true si se entregó un lote, false si no quedaban (o no se
+         * está reproduciendo)
+         */
+        bool replayBatch(OIS::KeyListener* keyListener, OIS::MouseListener* mouseListener);
+        
+        /**
+         * Cierra el paso de simulación actual
+         */
+        void endTick();
+        
+        /**
+         * @return true si se reproducía y se han consumido todos los pasos
+         */
+        bool hasEnded() const;
+        
+        /**
+         * @return pasos grabados o reproducidos hasta ahora
+         */
+        int getTickNumber() const;
+        
+        /**
+         * @return cuadros dibujados hasta ahora
+         */
+        int getFrameNumber() const;
+        
+        /**
+         * @return duración media de los cuadros en ms
+         */
+        Ogre::Real getMeanFrameTime() const;
+        
+        /**
+         * @return duración del cuadro más largo en ms
+         */
+        Ogre::Real getMaxFrameTime() const;
+        
+    private:
+        // Tipos de registro del fichero
+        enum Record {TICK, BATCH, KEY_PRESSED, KEY_RELEASED,
+                     MOUSE_MOVED, MOUSE_PRESSED, MOUSE_RELEASED};
+        
+        // Evento grabado
+        struct Event {
+            Record type;
+            OIS::KeyCode key;
+            unsigned int text;
+            OIS::MouseButtonID button;
+            OIS::MouseState state;
+        };
+        
+        typedef std::vector<Event> Batch;
+        typedef std::vector<Batch> Tick;
+        
+        Mode _mode;
+        unsigned int _seed;
+        
+        // Grabación
+        std::ofstream _output;
+        bool _batchPending;
+        
+        // Reproducción
+        std::vector<Tick> _ticks;
+        int _batch;
+        ReplayKeyboard* _keyboard;
+        ReplayMouse* _mouse;
+        
+        // Estadísticas
+        int _tick;
+        int _frameNumber;
+        Ogre::Real _totalFrameTime;
+        Ogre::Real _maxFrameTime;
+        
+        void load(const Ogre::String& fileName);
+        bool record(Record type, const OIS::EventArg& arg);
+        static unsigned int readInt(const std::vector<unsigned char>& data,
+                                    size_t& pos,
+                                    bool& valid,
+                                    int bytes);
+        void writeByte(unsigned char value);
+        void writeInt(unsigned int value, int bytes);
+        void writeMouseState(const OIS::MouseState& state);
+};
+
+inline InputRecorder::Mode InputRecorder::getMode() const {return _mode;}
+inline bool InputRecorder::isDeterministic() const {return _mode != NONE;}
+inline unsigned int InputRecorder::getSeed() const {return _seed;}
+inline int InputRecorder::getTickNumber() const {return _tick;}
+inline int InputRecorder::getFrameNumber() const {return _frameNumber;}
+inline Ogre::Real InputRecorder::getMaxFrameTime() const {return _maxFrameTime;}
+
+#endif  // SIONTOWER_TRUNK_SRC_INCLUDE_INPUTRECORDER_H_
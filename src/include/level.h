@@ -55,6 +55,15 @@ class Player;
  *  un objeto de la clase Level sólo contiene la información básica, no ha
  *  cargado el nivel. Tenemos que indicarle explícitamente que cargue el nivel
  *  completo.
+ *
+ *  Los niveles con mallas de navegación grandes pueden activar la búsqueda
+ *  jerárquica de caminos en su fichero de información básica con
+ *  <navigation clusterSize="64" />. Con <navigation flowField="true" /> los
+ *  enemigos persiguen al jugador siguiendo un campo de flujo común en lugar
+ *  de pedir caminos a PathPlanner. Está desactivado por defecto.
+ *
+ *  Como mucho hay 5 enemigos a la vez salvo que el nivel indique otro
+ *  máximo con <enemies max="8" />.
  */
 class Level {
     public:
@@ -140,6 +149,17 @@ class Level {
          **/
         NavigationMesh* getNavigationMesh();
         
+        /**
+         *  @return true si los enemigos del nivel persiguen al jugador con el
+         *  campo de flujo de la malla de navegación
+         **/
+        bool isFlowFieldEnabled() const;
+        
+        /**
+         *  @return número máximo de enemigos simultáneos en el nivel
+         **/
+        int getMaxEnemies() const;
+        
     private:
         // Información básica
         Ogre::String _id;
@@ -159,6 +179,9 @@ class Level {
         std::vector<std::pair <Ogre::SceneNode*, Ogre::Entity*> > _geometry;
         std::vector<std::pair <Ogre::SceneNode*, Ogre::ParticleSystem*> > _particles;
         NavigationMesh* _navigationMesh;
+        int _navigationClusterSize;
+        bool _flowField;
+        int _maxEnemies;
         Ogre::Vector3 _playerPos;
         std::vector<EnemySpawn> _enemySpawns;
         
@@ -24,11 +24,16 @@
 #define SIONTOWER_TRUNK_SRC_INCLUDE_NAVIGATIONMESH_H_
 
 #include <vector>
-#include <list>
+#include <deque>
+#include <map>
 
 #include <OGRE/Ogre.h>
+#include <boost/thread/mutex.hpp>
 
 #include "cell.h"
+#include "smallVector.h"
+
+class ClusterGraph;
 
 //! Grafo de celdas transitable del escenario, utilizado para búsqueda de caminos
 
@@ -42,33 +47,66 @@
  * estáticos usando el algoritmo de Floyd precomputando caminos. Está diseñada
  * como apoyo a la IA de los enemigos.
  * 
+ * En mallas grandes puede sustituirse Floyd por una búsqueda jerárquica
+ * (ClusterGraph) indicando un tamaño de cluster al construirla.
+ * 
+ * El pasillo de celdas que devuelve Floyd se convierte en una polilínea
+ * mínima con el algoritmo del embudo (string pulling) sobre los lados
+ * comunes de las celdas. El suavizado con splines es opcional y puede
+ * evaluarse bajo demanda con getSplinePoint.
+ * 
  * Una malla de navegación se crea a partir de un fichero .mesh.xml exportado
- * desde cualquier programa de diseño 3D compatible como Blender.
+ * desde cualquier programa de diseño 3D compatible como Blender. Cada cara
+ * puede llevar un atributo opcional cost con el multiplicador de coste de la
+ * celda (<face v1="0" v2="1" v3="2" cost="4.0" />). Los costes entre celdas
+ * son distancias reales a través de los portales, no número de celdas.
+ * 
+ * En tiempo de ejecución pueden bloquearse o penalizarse celdas y portales
+ * (puertas, zonas de hechizos, grupos de enemigos). Las tablas precalculadas
+ * no se rehacen: si el pasillo estático no atraviesa ninguna marca sigue
+ * siendo óptimo y, si la atraviesa, se busca con A* usando las distancias
+ * estáticas como heurística. Cada celda guarda la revisión en que cambió
+ * su marca, de forma que sólo se invalidan los pasillos afectados.
  */
 class NavigationMesh {
     public:
         /** Conjunto de celdas que forman el grafo de la malla */
         typedef std::vector<Cell*> Cells;
         
-        /** Camino formado por una lista de celdas */
-        typedef std::list<Cell*> CellPath;
+        /** Camino formado por una secuencia contigua de celdas */
+        typedef SmallVector<Cell*, 32> CellPath;
         
-        /** Camino formado por una lista de puntos */
-        typedef std::list<Ogre::Vector3> PointPath;
+        /**
+         * Camino formado por una secuencia contigua de puntos. Los caminos
+         * del embudo tienen pocos vértices y caben sin reservar memoria.
+         */
+        typedef SmallVector<Ogre::Vector3, 16> PointPath;
+        
+        /** Milisegundos dedicados a cada fase de la construcción */
+        struct BuildStats {
+            Ogre::Real parse;
+            Ogre::Real link;
+            Ogre::Real graph;
+            Ogre::Real floyd;
+            Ogre::Real clusters;
+        };
         
         /**
          * Constructor
          * 
          * @param fileName ruta al fichero .mesh.xml
+         * @param clusterSize si es mayor que 0, número máximo de celdas por
+         * cluster de la búsqueda jerárquica. Si es 0 se utiliza Floyd.
          * 
          * Por ahora sólo soporta ficheros mesh en formato XML, más
          * adelante se añadirá soporte para ficheros binarios .mesh
          * e integración con el sistema de gestión de recursos de Ogre.
          * 
          * Crea la malla de navegación y precomputa todos los caminos
-         * posibles utilizando Floyd y la simplificación de caminos.
+         * posibles utilizando Floyd o, si se indica un tamaño de cluster,
+         * el grafo abstracto de la búsqueda jerárquica.
          */
-        NavigationMesh(const Ogre::String& fileName = "");
+        NavigationMesh(const Ogre::String& fileName = "", int clusterSize = 0);
         
         /**
          * Destructor
@@ -78,15 +116,15 @@ class NavigationMesh {
         /**
          * Añade una celda a la malla de navegación
          * 
-         * @param id identificador de la celda
+         * @param id identificador de la celda, debe ser el número de celdas
+         * añadidas hasta ahora (los datos se indexan por identificador)
          * @param pointA primer punto del triángulo
          * @param pointB segundo punto del triángulo
          * @param pointC tercero punto del triángulo
          * 
-         * El orden es relevante. Se supone que desde A hasta B, el triángulo
-         * queda a la derecha. Lo mismo debe ocurrir desde B a C y desde
-         * C a A. Esto es útil para optimizar intersecciones con los caminos
-         * dentro de las celdas de la malla.
+         * Los vértices con la misma posición se comparten entre celdas y
+         * las normales de los lados se orientan hacia el interior, por lo
+         * que el sentido de giro del triángulo es indiferente.
          */
         void addCell(int id,
                      const Ogre::Vector3& pointA,
@@ -115,11 +153,28 @@ class NavigationMesh {
          * @return número de celdas que contiene la malla 
          */
         int getCellNumber();
+        
+        /**
+         * @param from celda de origen
+         * @param to celda vecina de destino
+         * 
+         * @return coste de pasar de from a to: distancia del centro de from
+         * al punto medio del portal común más la de ese punto al centro de
+         * to, cada tramo multiplicado por el coste de su celda
+         */
+        Ogre::Real getTraversalCost(const Cell* from, const Cell* to) const;
+        
+        /**
+         * @return menor multiplicador de coste de las celdas de la malla. Las
+         * heurísticas lo aplican a la distancia para seguir siendo admisibles
+         */
+        Ogre::Real getMinCost() const;
 
         /**
-         * Reconstruye el camino a partir de las rutas producidas por el
-         * algoritmo de Floyd y aplica un spline
-         * creando puntos intermedios ficticios para suavizar la ruta.
+         * Reconstruye el pasillo de celdas a partir de las rutas producidas
+         * por el algoritmo de Floyd y obtiene el camino más corto dentro de
+         * él con el algoritmo del embudo. El camino resultante sólo tiene
+         * puntos en los vértices donde la ruta gira.
          * 
          * @param path camino de puntos (salida)
          * @param startPos posición de comienzo (debe estar en la malla)
@@ -128,6 +183,9 @@ class NavigationMesh {
          * se facilita se buscará automáticamente (más lento).
          * @param endCell celda final para mayor eficiencia. Si no
          * se facilita se buscará automáticamente (más lento).
+         * @param partial si no es 0, indica a la salida si el camino sólo
+         * llega hasta la salida del primer cluster (búsqueda jerárquica). En
+         * ese caso hay que volver a llamar a buildPath al llegar a su final.
          * 
          * @return true si existe camino, false en caso contrario
          */
@@ -135,24 +193,174 @@ class NavigationMesh {
                        const Ogre::Vector3& startPos,
                        const Ogre::Vector3& endPos,
                        Cell* startCell = 0,
-                       Cell* endCell = 0);
+                       Cell* endCell = 0,
+                       bool* partial = 0);
+        
+        /**
+         * Primer paso de buildPath: obtiene el pasillo de celdas contiguas
+         * entre dos celdas de la malla.
+         * 
+         * @param cellPath pasillo de celdas (salida)
+         * @param startCell celda de inicio
+         * @param endCell celda final
+         * @param partial si no es 0, indica a la salida si el pasillo sólo
+         * llega hasta la salida del primer cluster
+         * 
+         * @return true si existe camino, false en caso contrario
+         * 
+         * Respeta las celdas y portales bloqueados o penalizados. Puede
+         * llamarse desde el hilo de búsqueda de caminos.
+         */
+        bool findCorridor(CellPath& cellPath,
+                          Cell* startCell,
+                          Cell* endCell,
+                          bool* partial = 0);
+        
+        /**
+         * Como findCorridor para varias celdas de inicio y una misma celda
+         * final. Una única búsqueda de Dijkstra desde la celda final hacia
+         * atrás resuelve todos los pasillos; termina en cuanto ha alcanzado
+         * todas las celdas de inicio. Con Floyd y sin marcas dinámicas cada
+         * pasillo es una consulta a la tabla y no hace falta buscar.
+         * 
+         * @param cellPaths pasillos de celdas (salida), uno por celda de
+         * inicio y vacío si no hay camino. Nunca son parciales.
+         * @param startCells celdas de inicio
+         * @param endCell celda final común
+         * 
+         * Respeta las celdas y portales bloqueados o penalizados. Puede
+         * llamarse desde el hilo de búsqueda de caminos.
+         */
+        void findCorridors(std::vector<CellPath>& cellPaths,
+                           const std::vector<Cell*>& startCells,
+                           Cell* endCell);
+        
+        /**
+         * Segundo paso de buildPath: obtiene el camino más corto dentro de un
+         * pasillo con el algoritmo del embudo.
+         * 
+         * @param cellPath pasillo de celdas contiguas
+         * @param startPos posición de comienzo (dentro de la primera celda)
+         * @param endPos posición de destino (dentro de la última celda)
+         * @param path camino de puntos (salida, se añaden al final)
+         */
+        void stringPull(const CellPath& cellPath,
+                        const Ogre::Vector3& startPos,
+                        const Ogre::Vector3& endPos,
+                        PointPath& path);
+        
+        /**
+         * @return grafo de la búsqueda jerárquica, 0 si se utiliza Floyd
+         */
+        ClusterGraph* getClusterGraph();
+        
+        /**
+         * @return tiempos de las fases de construcción de la malla
+         */
+        const BuildStats& getBuildStats() const;
+        
+        /**
+         * Añade puntos intermedios a un camino siguiendo un spline de
+         * Catmull-Rom. Es un paso opcional, buildPath ya no lo aplica.
+         * 
+         * @param path camino a suavizar (entrada y salida)
+         * @param pointsPerUnit puntos generados por unidad de longitud
+         * 
+         * @return true si se pudo suavizar, false si el camino tiene
+         * menos de dos puntos
+         */
+        static bool smoothPath(PointPath& path, int pointsPerUnit = 2);
+        
+        /**
+         * Evalúa bajo demanda el spline de Catmull-Rom que pasa por los
+         * puntos del camino, sin modificarlo.
+         * 
+         * @param path camino de puntos
+         * @param segment iterador al punto de comienzo del tramo
+         * @param t parámetro dentro del tramo en [0, 1]
+         * 
+         * @return punto del spline en el tramo que empieza en segment
+         */
+        static Ogre::Vector3 getSplinePoint(const PointPath& path,
+                                            PointPath::const_iterator segment,
+                                            Ogre::Real t);
         
         /**
          * @param pos posición a clasificar en la malla
          * 
          * @return celda que contiene al punto dado. Se devuelve la más cercana
-         * si el punto no está en la malla.
+         * si el punto no está en la malla. Consulta el índice espacial y, si
+         * varias celdas se superponen (escaleras), elige la de altura más
+         * próxima a pos.y.
          */
         Cell* findCell(const Ogre::Vector3& pos);
         
+        /**
+         * @param pos posición a clasificar en la malla
+         * @param hint celda en la que probablemente esté el punto (por
+         * ejemplo, la del frame anterior). Puede ser 0.
+         * 
+         * @return celda que contiene al punto dado. Comprueba la celda
+         * sugerida y sus vecinas antes de recorrer toda la malla.
+         */
+        Cell* findCell(const Ogre::Vector3& pos, Cell* hint);
+        
+        /**
+         * @param center centro de la zona
+         * @param radius radio de la zona en el plano XZ
+         * @param cells celdas conectadas a la que contiene al centro que
+         * tocan el círculo, empezando por ella (salida)
+         */
+        void findCells(const Ogre::Vector3& center, Ogre::Real radius, CellPath& cells);
+        
+        /**
+         * @param pos posición a consultar (sólo importan x y z)
+         * @param hintCell celda en la que probablemente esté la posición.
+         * Puede ser 0.
+         * 
+         * @return altura del suelo de la malla en la posición dada. Evalúa
+         * el plano precalculado de la celda, por lo que puede llamarse para
+         * cada actor en cada frame.
+         */
+        Ogre::Real sampleHeight(const Ogre::Vector3& pos, Cell* hintCell = 0);
+        
+        /**
+         * Actualiza el campo de flujo hacia la posición dada. Sólo se
+         * recalcula (un Dijkstra desde la celda objetivo) si la posición
+         * cambia de celda.
+         * 
+         * @param targetPos posición objetivo, normalmente la del jugador
+         */
+        void updateFlowField(const Ogre::Vector3& targetPos);
+        
+        /**
+         * @return celda objetivo del campo de flujo, 0 si no se ha calculado
+         */
+        Cell* getFlowTargetCell();
+        
+        /**
+         * @param cell celda en la que se encuentra el personaje
+         * @param position posición del personaje
+         * @param target siguiente punto hacia el que dirigirse para acercarse
+         * al objetivo (salida). Se obtiene aplicando el embudo a las
+         * próximas celdas del campo.
+         * 
+         * @return false si la celda no tiene camino hacia el objetivo
+         */
+        bool getFlowTarget(Cell* cell, const Ogre::Vector3& position, Ogre::Vector3& target);
+        
         /**
          * @param start punto de comienzo
          * @param end punto final
          * @param startCell celda de comienzo
-         * @param endCell celda final
+         * @param endCell celda final (puede ser 0 si no se conoce)
          * 
          * @return true si hay línea de visión entre los dos puntos, false
-         * en caso contrario.
+         * en caso contrario. El segmento no puede salir de la malla ni cruzar
+         * celdas o portales bloqueados.
+         * 
+         * Los resultados se guardan en una pequeña caché que se invalida en
+         * cada llamada a newFrame y al cambiar las marcas dinámicas.
          */
         bool lineOfSightTest(const Ogre::Vector3& start,
                              const Ogre::Vector3& end,
@@ -160,32 +368,237 @@ class NavigationMesh {
                              Cell* endCell);
         
         /**
-         * @param path camino
-         * @param startIt iterador dentro del camino dado
+         * @param start punto de comienzo común
+         * @param startCell celda de comienzo
+         * @param ends puntos finales
+         * @param endCells celdas finales (mismo tamaño que ends o vacío si
+         * no se conocen)
+         * @param results resultados, uno por cada punto final
          * 
-         * @return iterador del camino apuntando a la celda más lejana
-         * con la que haya una línea de visión directa. No habría riesgo
-         * de obstáculos.
+         * Comprueba la línea de visión desde un mismo origen hacia varios
+         * objetivos compartiendo el trabajo común a todos ellos.
+         */
+        void lineOfSightTest(const Ogre::Vector3& start,
+                             Cell* startCell,
+                             const std::vector<Ogre::Vector3>& ends,
+                             const std::vector<Cell*>& endCells,
+                             std::vector<bool>& results);
+        
+        /**
+         * Invalida la caché de líneas de visión. Debe llamarse una vez por
+         * frame, antes de actualizar la IA.
+         */
+        void newFrame();
+        
+        /**
+         * @param cell celda a marcar
+         * @param cost multiplicador dinámico del coste de entrar en la celda
+         * (mayor o igual que 1). Ogre::Math::POS_INFINITY la bloquea y 1
+         * elimina la marca.
          */
-        CellPath::iterator getFurthestVisibleCell(CellPath& path, CellPath::iterator startIt);
+        void setDynamicCost(Cell* cell, Ogre::Real cost);
+        
+        /**
+         * @param cell celda a consultar
+         * @return multiplicador dinámico del coste de entrar en la celda
+         */
+        Ogre::Real getDynamicCost(const Cell* cell) const;
+        
+        /**
+         * @param cell celda a bloquear o desbloquear
+         * @param blocked true para impedir el paso por la celda
+         */
+        void setCellBlocked(Cell* cell, bool blocked);
+        
+        /**
+         * @param cellA celda a un lado del portal
+         * @param cellB celda vecina al otro lado
+         * @param blocked true para impedir el paso entre ambas celdas (por
+         * ejemplo una puerta cerrada)
+         */
+        void setPortalBlocked(Cell* cellA, Cell* cellB, bool blocked);
+        
+        /**
+         * @param cellA celda a un lado del portal
+         * @param cellB celda vecina al otro lado
+         * @return true si el paso entre ambas celdas está bloqueado
+         */
+        bool isPortalBlocked(const Cell* cellA, const Cell* cellB) const;
+        
+        /**
+         * @return revisión actual de las marcas dinámicas, aumenta con cada
+         * cambio
+         */
+        int getDynamicRevision() const;
+        
+        /**
+         * @param cellPath pasillo obtenido con findCorridor
+         * @param revision revisión de las marcas al pedir el pasillo
+         * 
+         * @return true si alguna celda del pasillo ha cambiado de marca
+         * desde esa revisión y conviene volver a buscar el camino
+         */
+        bool isCorridorAffected(const CellPath& cellPath, int revision) const;
         
     private:
+        friend class Cell;
+        
+        // Entrada de la caché de líneas de visión
+        struct LineOfSightEntry {
+            Ogre::Vector3 start;
+            Ogre::Vector3 end;
+            Cell* startCell;
+            int frame;
+            int revision;
+            bool visible;
+        };
+        
+        static const int LOS_CACHE_SIZE = 64;
+        
+        // Orden total de posiciones para compartir vértices iguales
+        struct VertexLess {
+            bool operator()(const Ogre::Vector3& a, const Ogre::Vector3& b) const {
+                if (a.x != b.x) return a.x < b.x;
+                if (a.y != b.y) return a.y < b.y;
+                return a.z < b.z;
+            }
+        };
+        
+        typedef std::map<Ogre::Vector3, int, VertexLess> VertexIds;
+        
         void loadCellsFromXML(const Ogre::String& fileName);
-        bool makeSpline(PointPath& path);
-        int simplifyPath(CellPath& cellPath);
     
+        // Vistas Cell (direcciones estables) y punteros a ellas
+        std::deque<Cell> _cellViews;
         Cells _cells;
         int _cellNumber;
+        Ogre::Real _minCost;
+        BuildStats _buildStats;
+        
+        // Datos de las celdas como arrays contiguos. Los de lados y vértices
+        // tienen tres entradas por celda: la i-ésima de la celda c está en
+        // c * 3 + i y el lado i une los vértices i e (i + 1) % 3
+        std::vector<Ogre::Vector3> _vertices;
+        VertexIds _vertexIds;
+        std::vector<int> _cellVertices;
+        std::vector<int> _cellLinks;
+        std::vector<int> _cellLinkSides;
+        std::vector<Ogre::Vector2> _edgeNormals;
+        std::vector<Ogre::Real> _edgeOffsets;
+        std::vector<Ogre::Vector3> _centers;
+        std::vector<Ogre::Real> _cellCosts;
+        
+        // Plano de cada celda como y = a·x + b·z + c
+        std::vector<Ogre::Real> _heightA;
+        std::vector<Ogre::Real> _heightB;
+        std::vector<Ogre::Real> _heightC;
+        
+        const Ogre::Vector3& getCellVertex(int cell, int index) const;
+        bool cellContains(int cell, const Ogre::Vector3& point) const;
+        Ogre::Real getCellHeight(int cell, const Ogre::Vector3& point) const;
+        int getLinkSide(int cell, int neighbour) const;
+        bool getPortal(int cell, int neighbour, Ogre::Vector3& pointA, Ogre::Vector3& pointB) const;
+        Ogre::Real getTraversalCost(int from, int to) const;
+        
+        // Índice espacial: rejilla uniforme en XZ. Las celdas que tocan la
+        // casilla i están en _gridCells[_gridStart[i], _gridStart[i + 1])
+        Ogre::Real _gridMinX;
+        Ogre::Real _gridMinZ;
+        Ogre::Real _gridSize;
+        int _gridWidth;
+        int _gridHeight;
+        std::vector<int> _gridStart;
+        std::vector<int> _gridCells;
+        
+        void buildSpatialIndex();
+        int getGridIndex(Ogre::Real x, Ogre::Real z) const;
         
         // Grafo y Floyd
         Ogre::Real* _graph;
         int* _paths;
         
+        // Búsqueda jerárquica
+        ClusterGraph* _clusterGraph;
+        
+        // Campo de flujo: siguiente celda hacia el objetivo
+        static const int FLOW_LOOKAHEAD = 4;
+        
+        Cell* _flowTargetCell;
+        Ogre::Vector3 _flowTargetPos;
+        std::vector<int> _flowNext;
+        std::vector<Ogre::Real> _flowCost;
+        
+        int _flowRevision;
+        
+        void buildFlowField();
+        
+        // Marcas dinámicas: coste por celda y portales bloqueados (tres por
+        // celda, uno por lado). Se modifican en el hilo principal con el
+        // cerrojo tomado y findCorridor lo toma al leerlas.
+        std::vector<Ogre::Real> _dynamicCost;
+        std::vector<bool> _portalBlocked;
+        std::vector<int> _cellRevision;
+        int _dynamicRevision;
+        int _markNumber;
+        mutable boost::mutex _dynamicMutex;
+        
+        // Estado de la búsqueda A* con marcas dinámicas
+        std::vector<Ogre::Real> _searchCost;
+        std::vector<int> _searchParent;
+        std::vector<int> _searchStamp;
+        std::vector<int> _searchTarget;
+        int _searchRun;
+        
+        bool findStaticCorridor(CellPath& cellPath,
+                                Cell* startCell,
+                                Cell* endCell,
+                                bool* partial);
+        bool searchDynamicCorridor(CellPath& cellPath, Cell* startCell, Cell* endCell);
+        void searchFromGoal(const std::vector<Cell*>& startCells, Cell* endCell);
+        bool isCorridorMarked(const CellPath& cellPath) const;
+        void touchCell(Cell* cell);
+        
         void initGraph();
         void floyd();
-        void precomputePaths();
         void recoverPath(int i, int j, CellPath& cellPath);
+        
+        // Línea de visión
+        LineOfSightEntry _losCache[LOS_CACHE_SIZE];
+        int _frame;
+        
+        bool walkLineOfSight(const Ogre::Vector3& start,
+                             const Ogre::Vector3& end,
+                             Cell* startCell,
+                             Cell* endCell,
+                             const Ogre::Vector3* startOffsets);
+        LineOfSightEntry& getLineOfSightEntry(const Ogre::Vector3& start,
+                                              const Ogre::Vector3& end,
+                                              Cell* startCell);
 };
 
+inline const Ogre::Vector3& NavigationMesh::getCellVertex(int cell, int index) const {
+    return _vertices[_cellVertices[cell * 3 + index]];
+}
+
+inline bool NavigationMesh::cellContains(int cell, const Ogre::Vector3& point) const {
+    // Las normales de los lados apuntan hacia el interior
+    const Ogre::Vector2* normals = &_edgeNormals[cell * 3];
+    const Ogre::Real* offsets = &_edgeOffsets[cell * 3];
+    
+    return normals[0].x * point.x + normals[0].y * point.z >= offsets[0] &&
+           normals[1].x * point.x + normals[1].y * point.z >= offsets[1] &&
+           normals[2].x * point.x + normals[2].y * point.z >= offsets[2];
+}
+
+inline Ogre::Real NavigationMesh::getCellHeight(int cell, const Ogre::Vector3& point) const {
+    return _heightA[cell] * point.x + _heightB[cell] * point.z + _heightC[cell];
+}
+
+inline int NavigationMesh::getLinkSide(int cell, int neighbour) const {
+    const int* links = &_cellLinks[cell * 3];
+    
+    return (links[0] == neighbour)? 0 : (links[1] == neighbour)? 1 : (links[2] == neighbour)? 2 : -1;
+}
+
 
 #endif  // SIONTOWER_TRUNK_SRC_INCLUDE_NAVIGATIONMESH_H_
@@ -0,0 +1,153 @@
+/*
+ * This file is part of SionTower.
+ *
+ * 
+ * David Saltares M&aacute;rquez (C) 2011
+ * <david.saltares@gmail.com>
+ *
+ * 
+ * SionTower examples are free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License ad
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) ant later version.
+ *
+ * SionTower examples are distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SionTower examples.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SIONTOWER_TRUNK_SRC_INCLUDE_NEIGHBOURGRID_H_
+#define SIONTOWER_TRUNK_SRC_INCLUDE_NEIGHBOURGRID_H_
+
+#include <vector>
+
+#include <OGRE/Ogre.h>
+
+#include "smallVector.h"
+
+
+//! Rejilla uniforme para consultar los agentes cercanos a un punto
+
+/**
+ * @date 19-10-2026
+ * 
+ * StateGame la reconstruye una vez por frame con la posición y velocidad de
+ * todos los agentes (jugador y enemigos) antes de actualizarlos. Los
+ * comportamientos de steering y VelocityObstacles le piden los k agentes más
+ * cercanos dentro de un radio sin copiar la lista de enemigos ni recorrerla
+ * entera: sólo se visitan las celdas que cubren el radio de búsqueda.
+ * 
+ * Los agentes se guardan ordenados por celda en formato CSR, de modo que
+ * reconstruirla cada frame no reserva memoria una vez que ha crecido.
+ * 
+ * \code
+ * grid->clear();
+ * grid->addAgent(enemy, position, velocity, 0.4f);
+ * grid->build();
+ * 
+ * NeighbourGrid::Neighbours neighbours;
+ * grid->findNeighbours(enemy, position, 5.0f, 8, neighbours);
+ * \endcode
+ */
+class NeighbourGrid {
+    public:
+        /** Estado de un agente en el momento de construir la rejilla */
+        struct Agent {
+            const void* owner;
+            Ogre::Vector3 position;
+            Ogre::Vector3 velocity;
+            Ogre::Real radius;
+            bool avoiding;
+        };
+        
+        /** Vecino encontrado: índice del agente y distancia al cuadrado */
+        struct Neighbour {
+            int agent;
+            Ogre::Real distanceSq;
+        };
+        
+        /** Vecinos ordenados de más cercano a más lejano */
+        typedef SmallVector<Neighbour, 16> Neighbours;
+        
+        /**
+         * Constructor
+         * 
+         * @param cellSize lado de las celdas, conviene que sea similar al
+         * radio de las consultas más habituales
+         */
+        NeighbourGrid(Ogre::Real cellSize = 5.0f);
+        
+        /**
+         * Elimina los agentes del frame anterior
+         */
+        void clear();
+        
+        /**
+         * @param owner identificador del agente
+         * @param position posición actual
+         * @param velocity velocidad actual
+         * @param radius radio del agente en el plano XZ
+         * @param avoiding si es false el agente no se aparta de los demás
+         */
+        void addAgent(const void* owner,
+                      const Ogre::Vector3& position,
+                      const Ogre::Vector3& velocity,
+                      Ogre::Real radius,
+                      bool avoiding = true);
+        
+        /**
+         * Ordena los agentes añadidos por celdas. Debe llamarse tras
+         * añadirlos y antes de las consultas.
+         */
+        void build();
+        
+        /**
+         * Busca los agentes más cercanos en el plano XZ
+         * 
+         * @param owner agente que consulta, no se incluye en el resultado
+         * @param position centro de la búsqueda
+         * @param radius distancia máxima de los vecinos
+         * @param maxNeighbours número máximo de vecinos
+         * @param neighbours vecinos encontrados, de más cercano a más lejano
+         * 
+         * @return número de vecinos encontrados
+         */
+        int findNeighbours(const void* owner,
+                           const Ogre::Vector3& position,
+                           Ogre::Real radius,
+                           int maxNeighbours,
+                           Neighbours& neighbours) const;
+        
+        /**
+         * @param index índice de un agente devuelto por findNeighbours
+         * @return estado del agente
+         */
+        const Agent& getAgent(int index) const;
+        
+        /**
+         * @return número de agentes registrados en el frame
+         */
+        int getAgentNumber() const;
+        
+    private:
+        Ogre::Real _cellSize;
+        std::vector<Agent> _agents;
+        
+        // Los agentes de la celda c son _gridAgents[_gridStart[c].._gridStart[c + 1])
+        Ogre::Real _originX;
+        Ogre::Real _originZ;
+        int _gridWidth;
+        int _gridHeight;
+        std::vector<int> _gridStart;
+        std::vector<int> _gridAgents;
+        std::vector<int> _agentCells;
+};
+
+inline const NeighbourGrid::Agent& NeighbourGrid::getAgent(int index) const {return _agents[index];}
+inline int NeighbourGrid::getAgentNumber() const {return _agents.size();}
+
+#endif  // SIONTOWER_TRUNK_SRC_INCLUDE_NEIGHBOURGRID_H_
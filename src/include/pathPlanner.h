@@ -0,0 +1,200 @@
+/*
+ * This file is part of SionTower.
+ *
+ * 
+ * David Saltares M&aacute;rquez (C) 2011
+ * <david.saltares@gmail.com>
+ *
+ * 
+ * SionTower examples are free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License ad
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) ant later version.
+ *
+ * SionTower examples are distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SionTower examples.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SIONTOWER_TRUNK_SRC_INCLUDE_PATHPLANNER_H_
+#define SIONTOWER_TRUNK_SRC_INCLUDE_PATHPLANNER_H_
+
+#include <vector>
+
+#include <OGRE/Ogre.h>
+#include <boost/function.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/thread.hpp>
+
+#include "navigationMesh.h"
+
+class Cell;
+
+//! Servicio de búsqueda de caminos en segundo plano
+
+/**
+ * @date 19-10-2026
+ * 
+ * Las peticiones de camino se encolan y un hilo trabajador las resuelve
+ * contra la malla de navegación, que no debe modificarse mientras exista el
+ * PathPlanner. Sólo el PathPlanner debe llamar a NavigationMesh::buildPath
+ * y findCorridor(s) mientras tanto.
+ * 
+ * El resultado se entrega mediante un callback que se invoca siempre desde
+ * el hilo principal, dentro de update. Mientras tanto el solicitante puede
+ * seguir usando su camino anterior.
+ * 
+ * - Cada solicitante (owner) tiene como mucho una petición viva: una nueva
+ * petición sustituye a la anterior y los resultados obsoletos se descartan.
+ * - Las peticiones pendientes con la misma celda de destino se agrupan. Una
+ * sola búsqueda desde el destino (NavigationMesh::findCorridors) obtiene el
+ * pasillo de celdas de cada una; las que además empiezan en la misma celda
+ * lo comparten. Una petición sola usa findCorridor.
+ * - La búsqueda dispone de un presupuesto de milisegundos por cuadro de
+ * render que se renueva en cada llamada a resetBudget. Lo comparten todos los
+ * pasos fijos (llamadas a update) de ese cuadro.
+ * 
+ * Si se crea sin hilo, update resuelve las peticiones dentro del mismo
+ * presupuesto de forma síncrona y determinista.
+ * 
+ * \code
+ * PathPlanner::Callback callback = boost::bind(&Enemy::pathFound, this, _1);
+ * pathPlanner->requestPath(this, position, goal, callback);
+ * \endcode
+ */
+class PathPlanner {
+    public:
+        /** Resultado de una petición */
+        struct Result {
+            bool found;
+            bool partial;
+            Ogre::Vector3 goal;
+            NavigationMesh::PointPath path;
+            NavigationMesh::CellPath corridor;
+        };
+        
+        /** Función a la que se notifica el resultado de una petición */
+        typedef boost::function<void(const Result&)> Callback;
+        
+        /**
+         * Constructor
+         * 
+         * @param navigationMesh malla de navegación sobre la que buscar
+         * @param threaded si es true las peticiones se resuelven en un hilo
+         * trabajador, si no dentro de update
+         * @param frameBudget milisegundos de búsqueda disponibles por cuadro
+         * de render
+         */
+        PathPlanner(NavigationMesh* navigationMesh,
+                    bool threaded = true,
+                    Ogre::Real frameBudget = 2.0f);
+        
+        /**
+         * Destructor, detiene el hilo trabajador y descarta las peticiones
+         * pendientes sin notificarlas.
+         */
+        ~PathPlanner();
+        
+        /**
+         * @param owner solicitante. Sustituye a su petición anterior
+         * @param startPos posición de comienzo
+         * @param endPos posición de destino
+         * @param callback función a la que se notifica el resultado
+         * @param startCell celda de inicio (se busca si es 0)
+         * @param endCell celda de destino (se busca si es 0)
+         * 
+         * @return identificador de la petición
+         */
+        int requestPath(const void* owner,
+                        const Ogre::Vector3& startPos,
+                        const Ogre::Vector3& endPos,
+                        const Callback& callback,
+                        Cell* startCell = 0,
+                        Cell* endCell = 0);
+        
+        /**
+         * Descarta la petición del solicitante, su callback no se invocará.
+         * Debe llamarse antes de destruir al solicitante.
+         * 
+         * @param owner solicitante
+         */
+        void cancel(const void* owner);
+        
+        /**
+         * Invoca los callbacks de las peticiones resueltas. Debe llamarse
+         * una vez por frame desde el hilo principal.
+         */
+        void update();
+        
+        /**
+         * Renueva el presupuesto de búsqueda. Debe llamarse una vez por
+         * cuadro de render desde el hilo principal.
+         */
+        void resetBudget();
+        
+        /**
+         * @param frameBudget milisegundos de búsqueda disponibles por cuadro
+         * de render
+         */
+        void setFrameBudget(Ogre::Real frameBudget);
+        
+        /**
+         * @return número de peticiones pendientes de resolver
+         */
+        int getPendingNumber();
+        
+    private:
+        struct Request {
+            int ticket;
+            const void* owner;
+            Ogre::Vector3 startPos;
+            Ogre::Vector3 endPos;
+            Cell* startCell;
+            Cell* endCell;
+            Callback callback;
+        };
+        
+        struct Response {
+            int ticket;
+            const void* owner;
+            Callback callback;
+            Result result;
+        };
+        
+        typedef boost::unordered_map<const void*, int> Tickets;
+        
+        NavigationMesh* _navigationMesh;
+        bool _threaded;
+        Ogre::Real _frameBudget;
+        int _nextTicket;
+        
+        // Sólo se acceden desde el hilo principal
+        Tickets _tickets;
+        std::vector<Response> _dispatching;
+        
+        // Compartidos con el hilo trabajador
+        std::vector<Request> _pending;
+        std::vector<Response> _completed;
+        Ogre::Real _budget;
+        bool _running;
+        boost::mutex _mutex;
+        boost::condition_variable _condition;
+        boost::thread* _thread;
+        
+        // Estado del hilo trabajador
+        std::vector<Request> _batch;
+        std::vector<Cell*> _startCells;
+        std::vector<NavigationMesh::CellPath> _corridors;
+        Ogre::Timer _timer;
+        
+        void run();
+        bool takeBatch();
+        void solveBatch(std::vector<Response>& responses);
+        void dispatch();
+};
+
+#endif  // SIONTOWER_TRUNK_SRC_INCLUDE_PATHPLANNER_H_
@@ -138,6 +138,8 @@ class Player: public Actor {
         SoundFXPtr _damagedSound;
         
         // Métodos de actualización
+        static const UpdateStateMethods UPDATE_METHODS;
+        
         void stateIdle(Ogre::Real deltaT);
         void stateRun(Ogre::Real deltaT);
         void stateAttack(Ogre::Real deltaT);
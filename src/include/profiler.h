@@ -0,0 +1,149 @@
+/*
+ * This file is part of SionTower.
+ *
+ * 
+ * David Saltares M&aacute;rquez (C) 2011
+ * <david.saltares@gmail.com>
+ *
+ * 
+ * SionTower examples are free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License ad
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) ant later version.
+ *
+ * SionTower examples are distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SionTower examples.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SIONTOWER_TRUNK_SRC_INCLUDE_PROFILER_H_
+#define SIONTOWER_TRUNK_SRC_INCLUDE_PROFILER_H_
+
+#include <string>
+
+
+//! Perfilador de zonas con exportación a Chrome (about:tracing) y Perfetto
+
+/**
+ * @date 19-10-2026
+ * 
+ * Cada zona marcada con PROFILE_ZONE mide, con precisión de nanosegundos,
+ * el tiempo desde su declaración hasta el final del bloque que la contiene.
+ * Las zonas pueden anidarse. Al cerrarse, cada zona se guarda en el búfer
+ * circular de su hilo, que conserva las ProfilerZone::CAPACITY últimas y
+ * sobrescribe las más antiguas.
+ * 
+ * Profiler::dump escribe las zonas de todos los hilos en formato JSON de
+ * Chrome tracing, que abren chrome://tracing y ui.perfetto.dev.
+ * 
+ * Las macros sólo hacen algo si se compila con SIONTOWER_PROFILER definido
+ * (make perfil=si). Si no, desaparecen y las marcas no cuestan nada.
+ * 
+ * \code
+ * void StateGame::update(Ogre::Real deltaT, bool active) {
+ *     PROFILE_ZONE("StateGame::update");
+ *     
+ *     {
+ *         PROFILE_ZONE("StateGame::update/player");
+ *         _player->update(deltaT);
+ *     }
+ *     ...
+ * }
+ * 
+ * PROFILE_DUMP("siontower-trace.json");
+ * \endcode
+ */
+class Profiler {
+    public:
+        /**
+         * Marca de tiempo en nanosegundos
+         */
+        typedef unsigned long long Time;
+        
+        /**
+         * @return marca de tiempo actual de un reloj monótono
+         */
+        static Time now();
+        
+        /**
+         * Abre una zona en el hilo actual
+         * 
+         * @param name nombre de la zona, debe existir hasta el volcado
+         * (normalmente una cadena literal)
+         * @return zona que estaba abierta, para restaurarla en leave
+         */
+        static const char* enter(const char* name);
+        
+        /**
+         * Cierra una zona y la guarda en el búfer del hilo actual
+         * 
+         * @param name nombre de la zona
+         * @param parent zona devuelta por enter
+         * @param start comienzo de la zona
+         * @param end final de la zona
+         */
+        static void leave(const char* name, const char* parent, Time start, Time end);
+        
+        /**
+         * @return zona abierta más interna del hilo actual, 0 si no hay
+         * ninguna. No reserva memoria, lo usa AllocationTracker.
+         */
+        static const char* getCurrentZone();
+        
+        /**
+         * @param name nombre con el que aparece el hilo actual en la traza
+         */
+        static void setThreadName(const std::string& name);
+        
+        /**
+         * Escribe las zonas guardadas de todos los hilos
+         * 
+         * @param fileName fichero JSON de destino
+         * @return true si pudo escribirse
+         */
+        static bool dump(const std::string& fileName);
+};
+
+
+//! Zona del perfilador, se mide durante la vida del objeto (ver Profiler)
+
+class ProfilerZone {
+    public:
+        /**
+         * Número de zonas que conserva cada hilo
+         */
+        static const int CAPACITY = 65536;
+        
+        /**
+         * @param name nombre de la zona (cadena literal)
+         */
+        ProfilerZone(const char* name): _name(name),
+                                        _parent(Profiler::enter(name)),
+                                        _start(Profiler::now()) {}
+        
+        ~ProfilerZone() {Profiler::leave(_name, _parent, _start, Profiler::now());}
+        
+    private:
+        const char* _name;
+        const char* _parent;
+        Profiler::Time _start;
+};
+
+
+#ifdef SIONTOWER_PROFILER
+    #define PROFILER_CONCAT_(a, b) a##b
+    #define PROFILER_CONCAT(a, b) PROFILER_CONCAT_(a, b)
+    #define PROFILE_ZONE(name) ProfilerZone PROFILER_CONCAT(profilerZone, __LINE__)(name)
+    #define PROFILE_THREAD(name) Profiler::setThreadName(name)
+    #define PROFILE_DUMP(fileName) Profiler::dump(fileName)
+#else
+    #define PROFILE_ZONE(name)
+    #define PROFILE_THREAD(name)
+    #define PROFILE_DUMP(fileName) ((void)0)
+#endif
+
+#endif  // SIONTOWER_TRUNK_SRC_INCLUDE_PROFILER_H_
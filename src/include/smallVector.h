@@ -0,0 +1,235 @@
+/*
+ * This file is part of SionTower.
+ *
+ * 
+ * David Saltares M&aacute;rquez (C) 2011
+ * <david.saltares@gmail.com>
+ *
+ * 
+ * SionTower examples are free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License ad
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) ant later version.
+ *
+ * SionTower examples are distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SionTower examples.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SIONTOWER_TRUNK_SRC_INCLUDE_SMALLVECTOR_H_
+#define SIONTOWER_TRUNK_SRC_INCLUDE_SMALLVECTOR_H_
+
+#include <cstddef>
+#include <algorithm>
+
+//! Vector contiguo con capacidad reservada dentro del propio objeto
+
+/**
+ * @date 19-10-2026
+ * 
+ * SmallVector guarda sus primeros N elementos dentro del propio objeto,
+ * sin reservar memoria dinámica. Sólo si se supera esa capacidad pasa a
+ * utilizar un bloque del montón, que conserva aunque se vacíe para que
+ * pueda reutilizarse. Se utiliza para los caminos de la malla de navegación,
+ * que se reconstruyen constantemente y casi siempre tienen pocos elementos.
+ * 
+ * Los iteradores son punteros, por lo que se invalidan al crecer el vector.
+ * T debe poder construirse por defecto y copiarse.
+ */
+template <typename T, int N>
+class SmallVector {
+    public:
+        typedef T value_type;
+        typedef T* iterator;
+        typedef const T* const_iterator;
+        
+        /**
+         * Constructor
+         * 
+         * Crea un vector vacío que utiliza la capacidad interna
+         */
+        SmallVector();
+        
+        /**
+         * Constructor de copia
+         */
+        SmallVector(const SmallVector& other);
+        
+        /**
+         * Destructor
+         */
+        ~SmallVector();
+        
+        /**
+         * Operador de asignación
+         */
+        SmallVector& operator=(const SmallVector& other);
+        
+        /**
+         * @return iterador al primer elemento
+         */
+        iterator begin();
+        const_iterator begin() const;
+        
+        /**
+         * @return iterador al elemento siguiente al último
+         */
+        iterator end();
+        const_iterator end() const;
+        
+        /**
+         * @return número de elementos
+         */
+        size_t size() const;
+        
+        /**
+         * @return número de elementos que caben sin reservar memoria
+         */
+        size_t capacity() const;
+        
+        /**
+         * @return true si el vector no contiene elementos
+         */
+        bool empty() const;
+        
+        /**
+         * @param index índice del elemento
+         * @return elemento en la posición index
+         */
+        T& operator[](size_t index);
+        const T& operator[](size_t index) const;
+        
+        /**
+         * @return primer elemento
+         */
+        T& front();
+        const T& front() const;
+        
+        /**
+         * @return último elemento
+         */
+        T& back();
+        const T& back() const;
+        
+        /**
+         * @param value elemento a añadir al final
+         */
+        void push_back(const T& value);
+        
+        /**
+         * Elimina el último elemento
+         */
+        void pop_back();
+        
+        /**
+         * Elimina todos los elementos conservando la capacidad
+         */
+        void clear();
+        
+        /**
+         * @param capacity capacidad mínima deseada
+         */
+        void reserve(size_t capacity);
+        
+        /**
+         * @param other vector con el que intercambiar el contenido
+         */
+        void swap(SmallVector& other);
+        
+    private:
+        T _inline[N];
+        T* _data;
+        size_t _size;
+        size_t _capacity;
+};
+
+
+template <typename T, int N>
+SmallVector<T, N>::SmallVector(): _data(_inline), _size(0), _capacity(N) {}
+
+template <typename T, int N>
+SmallVector<T, N>::SmallVector(const SmallVector& other): _data(_inline), _size(0), _capacity(N) {
+    *this = other;
+}
+
+template <typename T, int N>
+SmallVector<T, N>::~SmallVector() {
+    if (_data != _inline)
+        delete [] _data;
+}
+
+template <typename T, int N>
+SmallVector<T, N>& SmallVector<T, N>::operator=(const SmallVector& other) {
+    if (this != &other) {
+        reserve(other._size);
+        std::copy(other.begin(), other.end(), _data);
+        _size = other._size;
+    }
+    
+    return *this;
+}
+
+template <typename T, int N>
+void SmallVector<T, N>::reserve(size_t capacity) {
+    if (capacity <= _capacity)
+        return;
+    
+    // Pasamos los elementos a un bloque nuevo del montón
+    T* data = new T[capacity];
+    std::copy(begin(), end(), data);
+    
+    if (_data != _inline)
+        delete [] _data;
+    
+    _data = data;
+    _capacity = capacity;
+}
+
+template <typename T, int N>
+void SmallVector<T, N>::swap(SmallVector& other) {
+    // Si ambos usan el montón basta con intercambiar los bloques
+    if (_data != _inline && other._data != other._inline) {
+        std::swap(_data, other._data);
+        std::swap(_size, other._size);
+        std::swap(_capacity, other._capacity);
+        return;
+    }
+    
+    SmallVector aux(*this);
+    *this = other;
+    other = aux;
+}
+
+template <typename T, int N>
+inline void SmallVector<T, N>::push_back(const T& value) {
+    if (_size == _capacity) {
+        // value podría pertenecer al propio vector
+        T copy = value;
+        reserve(_capacity * 2);
+        _data[_size++] = copy;
+    }
+    else
+        _data[_size++] = value;
+}
+
+template <typename T, int N> inline typename SmallVector<T, N>::iterator SmallVector<T, N>::begin() {return _data;}
+template <typename T, int N> inline typename SmallVector<T, N>::const_iterator SmallVector<T, N>::begin() const {return _data;}
+template <typename T, int N> inline typename SmallVector<T, N>::iterator SmallVector<T, N>::end() {return _data + _size;}
+template <typename T, int N> inline typename SmallVector<T, N>::const_iterator SmallVector<T, N>::end() const {return _data + _size;}
+template <typename T, int N> inline size_t SmallVector<T, N>::size() const {return _size;}
+template <typename T, int N> inline size_t SmallVector<T, N>::capacity() const {return _capacity;}
+template <typename T, int N> inline bool SmallVector<T, N>::empty() const {return _size == 0;}
+template <typename T, int N> inline T& SmallVector<T, N>::operator[](size_t index) {return _data[index];}
+template <typename T, int N> inline const T& SmallVector<T, N>::operator[](size_t index) const {return _data[index];}
+template <typename T, int N> inline T& SmallVector<T, N>::front() {return _data[0];}
+template <typename T, int N> inline const T& SmallVector<T, N>::front() const {return _data[0];}
+template <typename T, int N> inline T& SmallVector<T, N>::back() {return _data[_size - 1];}
+template <typename T, int N> inline const T& SmallVector<T, N>::back() const {return _data[_size - 1];}
+template <typename T, int N> inline void SmallVector<T, N>::pop_back() {--_size;}
+template <typename T, int N> inline void SmallVector<T, N>::clear() {_size = 0;}
+
+#endif  // SIONTOWER_TRUNK_SRC_INCLUDE_SMALLVECTOR_H_
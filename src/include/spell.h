@@ -72,6 +72,8 @@ class Spell: public GameObject {
             int mana;
             Ogre::Real speed;
             Ogre::Real explosionTime;
+            Ogre::Real areaRadius;
+            Ogre::Real areaCost;
             Ogre::String particleMove;
             Ogre::String particleExplode;
             Ogre::String soundCast;
@@ -140,6 +142,18 @@ class Spell: public GameObject {
          */
         Ogre::Real getSpeed() const;
         
+        /**
+         * @return radio de la zona que los enemigos evitan mientras dura la
+         * explosión (0 si no la hay)
+         */
+        Ogre::Real getAreaRadius() const;
+        
+        /**
+         * @return multiplicador del coste de atravesar la zona de la
+         * explosión en la malla de navegación
+         */
+        Ogre::Real getAreaCost() const;
+        
         /**
          * @return dirección que lleva el hechizo
          */
@@ -163,7 +177,7 @@ class Spell: public GameObject {
         void explode();
         
         /**
-         * @param deltaT diferencia de tiempo en ms desde el último frame
+         * @param deltaT diferencia de tiempo en segundos desde el último frame
          * 
          * Actualiza el hechizo según su estado
          */
@@ -175,7 +189,7 @@ class Spell: public GameObject {
         Ogre::ParticleSystem* _particleMove;
         Ogre::ParticleSystem* _particleExplode;
         Ogre::Vector3 _direction;
-        Ogre::Timer* _explosionTimer;
+        Ogre::Real _explosionTime;
         SoundFXPtr _soundExplode;
         SoundFXPtr _soundCast;
         
@@ -79,9 +79,33 @@ class State {
          *  @param active true si el estado es el tope de la pila (est&aacute;
          *  activo).
          *
-         *  Actualiza el estado y sus elementos.
+         *  Actualiza el estado y sus elementos. StateManager la llama con un
+         *  paso de tiempo fijo, cero o varias veces por cuadro de render.
          */
         virtual void update(Ogre::Real deltaT, bool active) = 0;
+        
+        /**
+         *  @param active true si el estado es el tope de la pila (est&aacute;
+         *  activo).
+         *
+         *  Se llama una vez por cuadro de render antes de los pasos fijos de
+         *  update. Permite renovar lo que se reparte por cuadro y no por paso
+         *  (presupuestos de tiempo). Por defecto no hace nada.
+         */
+        virtual void newFrame(bool active) {}
+        
+        /**
+         *  @param deltaT tiempo real desde el &uacute;ltimo cuadro de render.
+         *  @param alpha fracci&oacute;n del paso fijo acumulada y a&uacute;n no simulada,
+         *  entre 0 y 1.
+         *  @param active true si el estado es el tope de la pila (est&aacute;
+         *  activo).
+         *
+         *  Se llama una vez por cuadro de render tras los pasos fijos de
+         *  update. Permite interpolar lo que se dibuja y actualizar lo que
+         *  depende del render (c&aacute;mara). Por defecto no hace nada.
+         */
+        virtual void interpolate(Ogre::Real deltaT, Ogre::Real alpha, bool active) {}
        
         /**
          *  Manejador del evento pulsar tecla
@@ -44,6 +44,12 @@
 class StateManager;
 class Level;
 class Enemy;
+class PathPlanner;
+class NeighbourGrid;
+class VelocityObstacles;
+class SteeringSystem;
+class AIScheduler;
+class Cell;
 
 
 //! Clase que modela la din&aacute;mica de juego
@@ -106,6 +112,24 @@ class StateGame: public State{
          */
         void update(Ogre::Real deltaT, bool active);
         
+        /**
+         *  @param active true si el estado de juego es el estado activo.
+         *
+         *  Renueva los presupuestos de la IA y de la b&uacute;squeda de caminos,
+         *  que comparten todos los pasos de un cuadro de render.
+         */
+        void newFrame(bool active);
+        
+        /**
+         *  @param deltaT tiempo real desde el &uacute;ltimo cuadro de render.
+         *  @param alpha fracci&oacute;n del paso fijo a&uacute;n no simulada.
+         *  @param active true si el estado de juego es el estado activo.
+         *
+         *  Interpola la posici&oacute;n dibujada del personaje, los enemigos y
+         *  los hechizos y actualiza la c&aacute;mara.
+         */
+        void interpolate(Ogre::Real deltaT, Ogre::Real alpha, bool active);
+        
         /**
          * @param type tipo de hechizo a añadir
          * @param position posición en la que aparecerá el hechizo
@@ -195,6 +219,13 @@ class StateGame: public State{
          */
         std::vector<Enemy*>& getEnemies();
         
+        /**
+         * @return rejilla con la posición y velocidad de los agentes al
+         * comienzo del frame, para consultar vecinos
+         */
+        const NeighbourGrid* getNeighbourGrid();
+
+        
         /**
          * @return hechizos
          */
@@ -353,17 +384,38 @@ class StateGame: public State{
         SongPtr _loseSong;
         Player* _player;
         Level* _level;
+        PathPlanner* _pathPlanner;
+        NeighbourGrid* _neighbourGrid;
+        VelocityObstacles* _velocityObstacles;
+        SteeringSystem* _steeringSystem;
+        AIScheduler* _aiScheduler;
         std::vector<Spell*> _spells;
         std::vector<Enemy*> _enemies;
         std::vector<EnemySpawn>::iterator _nextEnemy;
         
+        // Línea de visión del protagonista a cada enemigo
+        Cell* _playerCell;
+        std::vector<Ogre::Vector3> _enemyPositions;
+        std::vector<Cell*> _enemyCells;
+        std::vector<bool> _playerVisible;
+        
+        // Celdas de la malla encarecidas por las explosiones en curso
+        std::vector<Cell*> _spellAreaCells;
+        std::vector<Ogre::Real> _spellAreaCosts;
+        std::vector<Cell*> _newSpellAreaCells;
+        std::vector<Ogre::Real> _newSpellAreaCosts;
+        
         // Estadísticas de juego
         GameStats* _gameStats;
         Ogre::Real _gameTime;
         Ogre::Real _otherStateTime;
         
         void updateHUD();
+        void updateEnemies(Ogre::Real deltaT);
+        void sensePlayer();
+        void saveTransforms();
         void eraseEndedSpells();
+        void updateSpellAreas();
         void checkEnemySpawning();
         void eraseDeadEnemies();
         
@@ -376,6 +428,7 @@ class StateGame: public State{
 
 
 inline std::vector<Enemy*>& StateGame::getEnemies() {return _enemies;}
+inline const NeighbourGrid* StateGame::getNeighbourGrid() {return _neighbourGrid;}
 inline std::vector<Spell*>& StateGame::getSpells() {return _spells;}
 
 
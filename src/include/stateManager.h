@@ -29,6 +29,8 @@
 #include <OGRE/Ogre.h>
 #include <OIS/OIS.h>
 
+#include "inputRecorder.h"
+
 class State;
 class Game;
 
@@ -48,6 +50,10 @@ class Game;
  *
  *  Captura los eventos de teclado, rat&oacute;n y ventana. Se encarga de transmitir
  *  estos eventos al estado que se encuentre actualmente activo.
+ *
+ *  Con un InputRecorder en modo RECORD guarda esos eventos por paso fijo; en
+ *  modo REPLAY entrega los grabados en lugar de los de los dispositivos
+ *  reales y termina el juego al acabar la grabaci&oacute;n.
  *  
  */
 
@@ -62,13 +68,14 @@ class StateManager: public Ogre::FrameListener,
          *  @param game juego al que pertenece el StateManager
          *  @param inputManager gestor de la entrada para configurar los dispositivos
          *  (rat&oacute;n y teclado)
+         *  @param inputRecorder grabador de la entrada, no se libera
          *
          *  Configura el SceneManager.
          *  Crea la c&aacute;mara.
          *  Prepara los recursos (sin cargarlos).
          *  Inicia el men&uacute; de juego.
          */
-        StateManager(Game* game, OIS::InputManager* inputManager);
+        StateManager(Game* game, OIS::InputManager* inputManager, InputRecorder* inputRecorder);
 
         /**
          *  Destructor
@@ -147,6 +154,11 @@ class StateManager: public Ogre::FrameListener,
          */
         OIS::Keyboard* getKeyboard();
         
+        /**
+         *  @return grabador de la entrada del juego
+         */
+        InputRecorder* getInputRecorder();
+        
         /**
          *  @param arg evento de teclado
          *  @return true si todo ha ido bien
@@ -195,6 +207,10 @@ class StateManager: public Ogre::FrameListener,
          *  devuelve false, el bucle se detiene 
          *
          *  Evento que se dispara al iniciar un cuadro de renderizado.
+         *  Acumula el tiempo del cuadro y actualiza los estados en pasos
+         *  fijos de 1/60 s (cero o varios por cuadro). Despu&eacute;s llama a
+         *  State::interpolate con la fracci&oacute;n de paso sobrante. Un cuadro
+         *  largo (carga, compilaci&oacute;n de shaders) recupera como mucho 0,25 s.
          */
         bool frameStarted(const Ogre::FrameEvent& event);
 
@@ -254,6 +270,9 @@ class StateManager: public Ogre::FrameListener,
         OIS::Keyboard* _keyboard;
         OIS::Mouse* _mouse;
         
+        // Grabación y reproducción de la entrada
+        InputRecorder* _inputRecorder;
+        
         // Fichero de recursos
         Ogre::String _resourcesCfg;
 
@@ -287,11 +306,18 @@ class StateManager: public Ogre::FrameListener,
         // Controlamos la salida
         bool _exit;
         
+        // Paso fijo de simulaci&oacute;n: tiempo acumulado sin simular, duraci&oacute;n
+        // del paso y m&aacute;ximo que se recupera tras un cuadro largo
+        Ogre::Real _accumulator;
+        Ogre::Real _timeStep;
+        Ogre::Real _maxFrameTime;
+        
         // Realiza las operaciones pendientes
         void performOperations();
 };
 
-inline OIS::Mouse* StateManager::getMouse() {return _mouse;}
-inline OIS::Keyboard* StateManager::getKeyboard() {return _keyboard;}
+inline OIS::Mouse* StateManager::getMouse() {return _inputRecorder->getMouse(_mouse);}
+inline OIS::Keyboard* StateManager::getKeyboard() {return _inputRecorder->getKeyboard(_keyboard);}
+inline InputRecorder* StateManager::getInputRecorder() {return _inputRecorder;}
 
 #endif  // SIONTOWER_TRUNK_SRC_INCLUDE_STATEMANAGER_H_
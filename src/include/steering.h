@@ -87,13 +87,13 @@ struct Steering {
          * @param other otro steering para comparar
          * @return true si ambos tienen la misma aceleración (angular y lineal)
          */
-        bool operator == (const Steering& other);
+        bool operator == (const Steering& other) const;
         
         /**
          * @param other otro steering
          * @return nuevo steering cuyas aceleraciones son la suma de los dos
          */
-        Steering& operator + (const Steering& other);
+        Steering operator + (const Steering& other) const;
         
         /**
          * @param other otro steering
@@ -105,7 +105,7 @@ struct Steering {
          * @param f factor
          * @return nuevo steering cuyas aceleraciones son el producto de las anteriores por f
          */
-        Steering& operator * (Ogre::Real f);
+        Steering operator * (Ogre::Real f) const;
         
         /**
          * @param f factor
@@ -117,7 +117,7 @@ struct Steering {
          * @param f factor
          * @return nuevo steering cuyas aceleraciones son el cociente de las anteriores entre f
          */
-        Steering& operator / (Ogre::Real f);
+        Steering operator / (Ogre::Real f) const;
         
         /**
          * @param f factor
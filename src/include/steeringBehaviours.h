@@ -30,10 +30,9 @@
 #include "steering.h"
 #include "kinematic.h"
 #include "navigationMesh.h"
+#include "neighbourGrid.h"
 
 
-class Enemy;
-
 // Clase base
 
 //! Clase base abstracta que modela los Steering Behaviours de forma general
@@ -57,6 +56,13 @@ class Enemy;
  * 
  * characterKinematic.update(steering, deltaT);
  * \endcode
+ * 
+ * Los objetivos se consultan a través de punteros constantes y nunca se
+ * modifican. Los comportamientos compuestos calculan su objetivo intermedio
+ * y llaman a los métodos constantes de cálculo de sus clases base (seek,
+ * flee, arrive, align...) en lugar de cambiar su estado, por lo que obtener
+ * un steering no reserva memoria y comportamientos distintos pueden
+ * evaluarse en hilos distintos.
  */
 class SteeringBehaviour {
     public:
@@ -81,9 +87,19 @@ class SteeringBehaviour {
         virtual void getSteering(Steering& steering) = 0;
     
     protected:
-        inline const Ogre::Vector3 angleToVector(Ogre::Real angle) {
+        static inline const Ogre::Vector3 angleToVector(Ogre::Real angle) {
             return Ogre::Vector3(sin(angle), 0.0f, cos(angle));
         }
+        
+        /**
+         * @param position posición actual del objetivo
+         * @param velocity velocidad actual del objetivo
+         * @param maxPrediction máximo de segundos a predecir
+         * @return posición que tendrá el objetivo cuando el personaje lo alcance
+         */
+        Ogre::Vector3 predictPosition(const Ogre::Vector3& position,
+                                      const Ogre::Vector3& velocity,
+                                      Ogre::Real maxPrediction) const;
 };
 
 
@@ -103,7 +119,7 @@ class SteeringBehaviour {
  */
 class Seek: public SteeringBehaviour {
     public:
-        Kinematic* target;
+        const Kinematic* target;
         Ogre::Real maxAcceleration;
         
         /**
@@ -112,7 +128,7 @@ class Seek: public SteeringBehaviour {
          * @param character personaje
          * @param target objetivo
          */
-        Seek(Kinematic* character = 0, Kinematic* target = 0);
+        Seek(Kinematic* character = 0, const Kinematic* target = 0);
         
         /**
          * Modifica el steering según el comportamiento de Seek
@@ -120,6 +136,12 @@ class Seek: public SteeringBehaviour {
          * @param steering steering a modificar
          */
         virtual void getSteering(Steering& steering);
+        
+        /**
+         * @param targetPosition punto hacia el que dirigirse
+         * @param steering steering a modificar
+         */
+        void seek(const Ogre::Vector3& targetPosition, Steering& steering) const;
 };
 
 //! Comportamiento para huir de un objetivo a máxima velocidad
@@ -130,7 +152,7 @@ class Seek: public SteeringBehaviour {
  */
 class Flee: public SteeringBehaviour {
     public:
-        Kinematic* target;
+        const Kinematic* target;
         Ogre::Real maxAcceleration;
         
         /**
@@ -139,7 +161,7 @@ class Flee: public SteeringBehaviour {
          * @param character personaje
          * @param target objetivo
          */
-        Flee(Kinematic* character = 0, Kinematic* target = 0);
+        Flee(Kinematic* character = 0, const Kinematic* target = 0);
         
         /**
          * Modifica el steering según el comportamiento de Flee
@@ -147,6 +169,12 @@ class Flee: public SteeringBehaviour {
          * @param steering steering a modificar
          */
         virtual void getSteering(Steering& steering);
+        
+        /**
+         * @param targetPosition punto del que huir
+         * @param steering steering a modificar
+         */
+        void flee(const Ogre::Vector3& targetPosition, Steering& steering) const;
 };
 
 //! Comportamiento para alcanzar un objetivo decelerando al final
@@ -157,7 +185,7 @@ class Flee: public SteeringBehaviour {
  */
 class Arrive: public SteeringBehaviour {
     public:
-        Kinematic* target;
+        const Kinematic* target;
         Ogre::Real maxAcceleration;
         Ogre::Real targetRadius;
         Ogre::Real slowRadius;
@@ -169,7 +197,7 @@ class Arrive: public SteeringBehaviour {
          * @param character personaje
          * @param target objetivo
          */
-        Arrive(Kinematic* character = 0, Kinematic* target = 0);
+        Arrive(Kinematic* character = 0, const Kinematic* target = 0);
         
         /**
          * Modifica el steering según el comportamiento de Arrive
@@ -177,6 +205,12 @@ class Arrive: public SteeringBehaviour {
          * @param steering steering a modificar
          */
         virtual void getSteering(Steering& steering);
+        
+        /**
+         * @param targetPosition punto al que llegar
+         * @param steering steering a modificar
+         */
+        void arrive(const Ogre::Vector3& targetPosition, Steering& steering) const;
 };
 
 //! Comportamieno para tomar la misma orientación que el objetivo
@@ -187,7 +221,7 @@ class Arrive: public SteeringBehaviour {
  */
 class Align: public SteeringBehaviour {
     public:
-        Kinematic* target;
+        const Kinematic* target;
         Ogre::Real maxAngularAcceleration;
         Ogre::Real maxRotation;
         Ogre::Real targetRadius;
@@ -200,7 +234,7 @@ class Align: public SteeringBehaviour {
          * @param character personaje
          * @param target objetivo
          */
-        Align(Kinematic* character = 0, Kinematic* target = 0);
+        Align(Kinematic* character = 0, const Kinematic* target = 0);
         
         /**
          * Modifica el steering según el comportamiento de Align
@@ -209,8 +243,14 @@ class Align: public SteeringBehaviour {
          */
         virtual void getSteering(Steering& steering);
         
+        /**
+         * @param targetOrientation orientación que se quiere tomar
+         * @param steering steering a modificar
+         */
+        void align(Ogre::Real targetOrientation, Steering& steering) const;
+        
     protected:
-        Ogre::Real mapToRange(Ogre::Real angle);
+        static Ogre::Real mapToRange(Ogre::Real angle);
 };
 
 //! Comportamiento para alcanzar la misma velocidad que el objetivo
@@ -221,7 +261,7 @@ class Align: public SteeringBehaviour {
  */
 class VelocityMatch: public SteeringBehaviour {
     public:
-        Kinematic* target;
+        const Kinematic* target;
         Ogre::Real maxAcceleration;
         Ogre::Real timeToTarget;
         
@@ -231,7 +271,7 @@ class VelocityMatch: public SteeringBehaviour {
          * @param character personaje
          * @param target objetivo
          */
-        VelocityMatch(Kinematic* character = 0, Kinematic* target = 0);
+        VelocityMatch(Kinematic* character = 0, const Kinematic* target = 0);
         
         /**
          * Modifica el steering según el comportamiento de VelocityMatch
@@ -239,9 +279,12 @@ class VelocityMatch: public SteeringBehaviour {
          * @param steering steering a modificar
          */
         virtual void getSteering(Steering& steering);
-    
-    protected:
-        Ogre::Real mapToRange(Ogre::Real angle);
+        
+        /**
+         * @param targetVelocity velocidad que se quiere alcanzar
+         * @param steering steering a modificar
+         */
+        void matchVelocity(const Ogre::Vector3& targetVelocity, Steering& steering) const;
 };
 
 
@@ -256,7 +299,6 @@ class VelocityMatch: public SteeringBehaviour {
  */
 class Pursue: public Seek {
     public:
-        Kinematic* target; // Tenemos dos: pursue.target y seek.target
         Ogre::Real maxPrediction;
         
         /**
@@ -265,7 +307,7 @@ class Pursue: public Seek {
          * @param character personaje
          * @param target objetivo
          */
-        Pursue(Kinematic* character = 0, Kinematic* target = 0);
+        Pursue(Kinematic* character = 0, const Kinematic* target = 0);
         
         /**
          * Modifica el steering según el comportamiento de Pursue
@@ -283,7 +325,6 @@ class Pursue: public Seek {
  */
 class Evade: public Flee {
     public:
-        Kinematic* target; // Tenemos dos: evade.target y flee.target
         Ogre::Real maxPrediction;
         
         /**
@@ -292,7 +333,7 @@ class Evade: public Flee {
          * @param character personaje
          * @param target objetivo
          */
-        Evade(Kinematic* character = 0, Kinematic* target = 0);
+        Evade(Kinematic* character = 0, const Kinematic* target = 0);
         
         /**
          * Modifica el steering según el comportamiento de Evade
@@ -310,15 +351,13 @@ class Evade: public Flee {
  */
 class Face: public Align {
     public:
-        Kinematic* target; // Tenemos dos: face.target y align.target
-        
         /**
          * Constructor
          * 
          * @param character personaje
          * @param target objetivo
          */
-        Face(Kinematic* character = 0, Kinematic* target = 0);
+        Face(Kinematic* character = 0, const Kinematic* target = 0);
         
         /**
          * Modifica el steering según el comportamiento de Face
@@ -326,6 +365,12 @@ class Face: public Align {
          * @param steering steering a modificar
          */
         void getSteering(Steering& steering); 
+        
+        /**
+         * @param targetPosition punto hacia el que mirar
+         * @param steering steering a modificar
+         */
+        void face(const Ogre::Vector3& targetPosition, Steering& steering) const;
 };
 
 //! Comportamiento para vagar por el espacio de forma aleatoria
@@ -357,9 +402,10 @@ class Wander: public Face {
         void getSteering(Steering& steering);
         
     protected:
-        inline Ogre::Real randomBinomial() {
-            return (rand() - rand()) / (RAND_MAX * 1.0f);
-        }
+        // Generador propio: rand() comparte estado entre hilos
+        unsigned int _randomState;
+        
+        Ogre::Real randomBinomial();
 };
 
 //! Comportamiento para evitar colisiones entre enemigos
@@ -367,24 +413,31 @@ class Wander: public Face {
 /**
  * @author David Saltares Márquez
  * @date 12-06-2011
+ * 
+ * Sólo tiene en cuenta los maxNeighbours agentes de la NeighbourGrid del
+ * frame que estén a menos de neighbourDistance, por lo que puede construirse
+ * una vez y reutilizarse en todos los frames.
  */
 class CollisionAvoidance: public Flee {
     public:
         Ogre::Real maxAcceleration;
-        std::vector<Enemy*> targets;
-        Enemy* myself;
+        const NeighbourGrid* grid;
+        const void* myself;
         Ogre::Real radius;
+        Ogre::Real neighbourDistance;
+        int maxNeighbours;
         
         /**
          * Constructor
          * 
          * @param character personaje
-         * @param targets lista de enemigos a evitar
-         * @param enemy el propio enemigo, no se tiene en cuenta para evitar (o se evitaría a sí mismo)
+         * @param grid rejilla con los agentes a evitar
+         * @param myself identificador del personaje en la rejilla, no se
+         * tiene en cuenta para evitar (o se evitaría a sí mismo)
          */
         CollisionAvoidance(Kinematic* character,
-                           const std::vector<Enemy*>& targets,
-                           Enemy* myself);
+                           const NeighbourGrid* grid,
+                           const void* myself);
         
         /**
          * Modifica el steering según el comportamiento de CollisionAvoidance
@@ -392,6 +445,9 @@ class CollisionAvoidance: public Flee {
          * @param steering steering a modificar
          */
         void getSteering(Steering& steering); 
+        
+    private:
+        NeighbourGrid::Neighbours _neighbours;
 };
 
 //! Comportamiento para seguir un camino PointPath
@@ -399,12 +455,26 @@ class CollisionAvoidance: public Flee {
 /**
  * @author David Saltares Márquez
  * @date 13-06-2011
+ * 
+ * FollowPath recuerda el segmento del camino en el que se encuentra el
+ * personaje. En cada llamada proyecta su posición sólo sobre los segmentos
+ * cercanos al actual (nunca hacia atrás) y toma como objetivo el punto que
+ * se encuentra pathOffset unidades más adelante a lo largo del camino.
+ * No realiza reservas de memoria.
  */
 class FollowPath: public Arrive {
     public:
         NavigationMesh::PointPath* path;
+        
+        /** Distancia a recorrer sobre el camino para situar el objetivo */
         Ogre::Real pathOffset;
         
+        /** Número de segmentos a partir del actual sobre los que se proyecta */
+        int searchSegments;
+        
+        /** Índice del segmento del camino en el que se encuentra el personaje */
+        int currentSegment;
+        
         /**
          * Constructor
          * 
@@ -413,6 +483,14 @@ class FollowPath: public Arrive {
          */
         FollowPath(Kinematic* character, NavigationMesh::PointPath* path);
         
+        /**
+         * Cambia el camino a seguir y reinicia el progreso. Debe llamarse
+         * cada vez que se reconstruya el camino.
+         * 
+         * @param path nuevo camino que debe seguir el personaje
+         */
+        void setPath(NavigationMesh::PointPath* path);
+        
         /**
          * Modifica el steering según el comportamiento de FollowPath
          * 
@@ -420,9 +498,28 @@ class FollowPath: public Arrive {
          */
         void getSteering(Steering& steering);
         
-    protected:
-        Ogre::Vector3 findClosestPathPoint(const Ogre::Vector3& point);
+        /**
+         * @return punto del camino al que debe dirigirse el personaje.
+         * Avanza currentSegment según la posición del personaje.
+         */
         Ogre::Vector3 findTargetInPath();
+        
+    protected:
+        /**
+         * @param point punto a proyectar
+         * @return distancia desde el inicio del segmento currentSegment hasta
+         * la proyección del punto
+         * 
+         * Proyecta el punto sobre los segmentos cercanos al actual y avanza
+         * currentSegment hasta el segmento más cercano.
+         */
+        Ogre::Real projectOnPath(const Ogre::Vector3& point);
+        
+        /**
+         * @param distance distancia desde el inicio del segmento currentSegment
+         * @return punto del camino situado a esa distancia
+         */
+        Ogre::Vector3 getPathPoint(Ogre::Real distance);
 };
 
 
@@ -0,0 +1,256 @@
+/*
+ * This file is part of SionTower.
+ *
+ * 
+ * David Saltares M&aacute;rquez (C) 2011
+ * <david.saltares@gmail.com>
+ *
+ * 
+ * SionTower examples are free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License ad
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) ant later version.
+ *
+ * SionTower examples are distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SionTower examples.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SIONTOWER_TRUNK_SRC_INCLUDE_STEERINGSYSTEM_H_
+#define SIONTOWER_TRUNK_SRC_INCLUDE_STEERINGSYSTEM_H_
+
+#include <vector>
+
+#include <OGRE/Ogre.h>
+
+#include "kinematic.h"
+#include "steeringBehaviours.h"
+
+class VelocityObstacles;
+
+
+//! Actualización conjunta del steering de todos los agentes
+
+/**
+ * @date 19-10-2026
+ * 
+ * Cada agente registra su Kinematic y durante su actualización de IA pide un
+ * comportamiento para el frame (seek, arrive o followPath) con su objetivo.
+ * Una vez que todos lo han pedido, update resuelve a la vez a todos los
+ * agentes:
+ * 
+ * -# Copia posición, velocidad y velocidad máxima de cada Kinematic a
+ * vectores separados por componente (SoA).
+ * -# Calcula la aceleración de Seek y Arrive en un único bucle sin llamadas
+ * virtuales ni temporales, apto para vectorizar.
+ * -# Integra posiciones y velocidades con la misma regla que
+ * Kinematic::update en otro bucle vectorizable.
+ * -# Corrige la velocidad deseada con VelocityObstacles, si lo hay.
+ * -# Escribe el resultado en cada Kinematic una única vez.
+ * 
+ * Los agentes sin petición en el frame no se mueven. Las peticiones se
+ * descartan tras cada update, salvo que el agente pida repetirla con repeat.
+ * 
+ * Además de su petición, un agente puede añadir en el frame otros
+ * comportamientos (SteeringBehaviour) con más prioridad, como huir de un
+ * peligro. Tras el paso 2 se combinan por grupos de prioridad, empezando
+ * por el 0:
+ * 
+ * - Dentro de un grupo las salidas se mezclan según su peso. Cada una se
+ * limita antes a su presupuesto de aceleración.
+ * - Cada grupo sólo dispone de la aceleración que dejan libre los
+ * anteriores, y la petición del agente es el último grupo.
+ * - En cuanto la suma alcanza la aceleración máxima de la petición ya no se
+ * evalúan más grupos y la petición se descarta.
+ * 
+ * Los agentes sin comportamientos añadidos sólo siguen su petición, sin
+ * coste adicional.
+ * 
+ * \code
+ * int agent = steeringSystem->addAgent(&kinematic, enemy, 0.4f);
+ * steeringSystem->followPath(agent, followPath);
+ * steeringSystem->addBehaviour(agent, &flee, 0);
+ * steeringSystem->update(deltaT);
+ * \endcode
+ */
+class SteeringSystem {
+    public:
+        /**
+         * Constructor
+         * 
+         * @param velocityObstacles evitación local aplicada a la velocidad
+         * resultante (0 para no evitar colisiones)
+         */
+        SteeringSystem(VelocityObstacles* velocityObstacles = 0);
+        
+        /**
+         * @param kinematic cinemática del agente, debe existir mientras el
+         * agente esté registrado
+         * @param owner identificador del agente en la NeighbourGrid
+         * @param radius radio del agente para la evitación local
+         * 
+         * @return identificador del agente, estable hasta que se elimine
+         */
+        int addAgent(Kinematic* kinematic, const void* owner, Ogre::Real radius);
+        
+        /**
+         * Elimina al agente. Su identificador podrá reutilizarse.
+         * 
+         * @param agent identificador devuelto por addAgent
+         */
+        void removeAgent(int agent);
+        
+        /**
+         * Pide que el agente se dirija hacia el objetivo a máxima aceleración
+         * (como Seek)
+         * 
+         * @param agent identificador del agente
+         * @param target posición objetivo
+         * @param maxAcceleration aceleración máxima
+         */
+        void seek(int agent, const Ogre::Vector3& target, Ogre::Real maxAcceleration);
+        
+        /**
+         * Pide que el agente llegue al objetivo frenando (como Arrive)
+         * 
+         * @param agent identificador del agente
+         * @param target posición objetivo
+         * @param maxAcceleration aceleración máxima
+         * @param targetRadius distancia a la que se considera que ha llegado
+         * @param slowRadius distancia a la que empieza a frenar
+         * @param timeToTarget tiempo para alcanzar la velocidad objetivo
+         */
+        void arrive(int agent,
+                    const Ogre::Vector3& target,
+                    Ogre::Real maxAcceleration,
+                    Ogre::Real targetRadius,
+                    Ogre::Real slowRadius,
+                    Ogre::Real timeToTarget = 0.1f);
+        
+        /**
+         * Pide que el agente siga el camino de followPath con sus
+         * parámetros de Arrive. El progreso sobre el camino se guarda en
+         * followPath.
+         * 
+         * @param agent identificador del agente
+         * @param followPath comportamiento con el camino y el progreso
+         */
+        void followPath(int agent, FollowPath& followPath);
+        
+        /**
+         * Añade en este frame un comportamiento por encima de la petición
+         * del agente. Sólo se tiene en cuenta si el agente hace una petición
+         * en el mismo frame, de la que toma la aceleración máxima.
+         * 
+         * @param agent identificador del agente
+         * @param behaviour comportamiento, debe existir hasta el update
+         * (o el siguiente si se repite)
+         * @param priority grupo de prioridad, 0 es el más prioritario
+         * @param weight peso dentro de su grupo
+         * @param budget aceleración máxima que puede aportar
+         */
+        void addBehaviour(int agent,
+                          SteeringBehaviour* behaviour,
+                          int priority = 0,
+                          Ogre::Real weight = 1.0f,
+                          Ogre::Real budget = Ogre::Math::POS_INFINITY);
+        
+        /**
+         * Repite en este frame la petición del frame anterior, si la hubo,
+         * y sus comportamientos añadidos. Permite que un agente que no
+         * actualiza su IA siga moviéndose.
+         * 
+         * @param agent identificador del agente
+         */
+        void repeat(int agent);
+        
+        /**
+         * Resuelve las peticiones del frame y actualiza las cinemáticas
+         * 
+         * @param deltaT segundos desde el último frame
+         */
+        void update(Ogre::Real deltaT);
+        
+        /**
+         * @return número de agentes registrados
+         */
+        int getAgentNumber() const;
+        
+    private:
+        VelocityObstacles* _velocityObstacles;
+        
+        // Identificador estable -> posición en los vectores y viceversa
+        std::vector<int> _indices;
+        std::vector<int> _handles;
+        std::vector<int> _freeHandles;
+        
+        // Datos de cada agente
+        std::vector<Kinematic*> _kinematics;
+        std::vector<const void*> _owners;
+        std::vector<Ogre::Real> _radius;
+        
+        // Estado cinemático (SoA), copiado en cada update
+        std::vector<Ogre::Real> _positionX;
+        std::vector<Ogre::Real> _positionY;
+        std::vector<Ogre::Real> _positionZ;
+        std::vector<Ogre::Real> _velocityX;
+        std::vector<Ogre::Real> _velocityY;
+        std::vector<Ogre::Real> _velocityZ;
+        std::vector<Ogre::Real> _orientation;
+        std::vector<Ogre::Real> _maxSpeed;
+        
+        // Petición del frame: active = 0 sin petición, seek = 1 para Seek
+        std::vector<Ogre::Real> _active;
+        std::vector<Ogre::Real> _previous;
+        std::vector<Ogre::Real> _seek;
+        std::vector<Ogre::Real> _targetX;
+        std::vector<Ogre::Real> _targetY;
+        std::vector<Ogre::Real> _targetZ;
+        std::vector<Ogre::Real> _maxAcceleration;
+        std::vector<Ogre::Real> _targetRadius;
+        std::vector<Ogre::Real> _slowRadius;
+        std::vector<Ogre::Real> _timeToTarget;
+        
+        // Resultado: aceleración y velocidad deseada
+        std::vector<Ogre::Real> _linearX;
+        std::vector<Ogre::Real> _linearY;
+        std::vector<Ogre::Real> _linearZ;
+        std::vector<Ogre::Real> _desiredX;
+        std::vector<Ogre::Real> _desiredY;
+        std::vector<Ogre::Real> _desiredZ;
+        
+        // Comportamientos añadidos del frame y del anterior
+        struct Behaviour {
+            int agent;
+            int priority;
+            SteeringBehaviour* behaviour;
+            Ogre::Real weight;
+            Ogre::Real budget;
+            
+            bool operator < (const Behaviour& other) const {
+                return agent < other.agent || (agent == other.agent && priority < other.priority);
+            }
+        };
+        
+        std::vector<Behaviour> _behaviours;
+        std::vector<Behaviour> _previousBehaviours;
+        
+        int request(int agent,
+                    const Ogre::Vector3& target,
+                    Ogre::Real maxAcceleration);
+        
+        void gather();
+        void computeLinear();
+        void arbitrate();
+        void integrate(Ogre::Real deltaT);
+        void avoid(Ogre::Real deltaT);
+        void scatter();
+};
+
+inline int SteeringSystem::getAgentNumber() const {return _handles.size();}
+
+#endif  // SIONTOWER_TRUNK_SRC_INCLUDE_STEERINGSYSTEM_H_
@@ -0,0 +1,131 @@
+/*
+ * This file is part of SionTower.
+ *
+ * 
+ * David Saltares M&aacute;rquez (C) 2011
+ * <david.saltares@gmail.com>
+ *
+ * 
+ * SionTower examples are free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License ad
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) ant later version.
+ *
+ * SionTower examples are distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SionTower examples.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SIONTOWER_TRUNK_SRC_INCLUDE_VELOCITYOBSTACLES_H_
+#define SIONTOWER_TRUNK_SRC_INCLUDE_VELOCITYOBSTACLES_H_
+
+#include <vector>
+
+#include <OGRE/Ogre.h>
+
+#include "neighbourGrid.h"
+
+
+//! Evitación local entre agentes mediante obstáculos de velocidad (ORCA)
+
+/**
+ * @date 19-10-2026
+ * 
+ * Trabaja sobre la NeighbourGrid que StateGame construye al comienzo de cada
+ * frame con la posición y velocidad actuales de todos los agentes. Cada
+ * agente pide su nueva velocidad: se toman sus vecinos más cercanos de la
+ * rejilla, cada uno define un semiplano de velocidades permitidas (Optimal
+ * Reciprocal Collision Avoidance) y se elige mediante programación lineal la
+ * velocidad permitida más próxima a la preferida.
+ * 
+ * Entre dos agentes que se apartan cada uno asume la mitad del esfuerzo de
+ * evitarse. Los que no se apartan (NeighbourGrid::Agent::avoiding a false,
+ * como el jugador) obligan al resto a asumir todo el esfuerzo.
+ * 
+ * El coste de cada consulta depende sólo de la densidad local de agentes y no
+ * se reserva memoria una vez que los vectores internos han crecido.
+ * 
+ * \code
+ * VelocityObstacles velocityObstacles(grid);
+ * velocityObstacles.computeVelocity(enemy, position, velocity, 0.5f,
+ *                                   preferred, maxSpeed, deltaT, velocity);
+ * \endcode
+ */
+class VelocityObstacles {
+    public:
+        /**
+         * Constructor
+         * 
+         * @param grid rejilla con los agentes del frame
+         * @param neighbourDistance distancia máxima a la que se tienen en
+         * cuenta otros agentes
+         * @param maxNeighbours número máximo de vecinos considerados
+         * @param timeHorizon segundos hacia el futuro en los que se garantiza
+         * que no hay colisión
+         */
+        VelocityObstacles(const NeighbourGrid* grid,
+                          Ogre::Real neighbourDistance = 5.0f,
+                          int maxNeighbours = 8,
+                          Ogre::Real timeHorizon = 1.0f);
+        
+        /**
+         * Calcula la velocidad libre de colisiones más cercana a la preferida
+         * 
+         * @param owner identificador del agente, no se evita a sí mismo
+         * @param position posición del agente
+         * @param velocity velocidad actual del agente
+         * @param radius radio del agente
+         * @param preferred velocidad que desea el agente
+         * @param maxSpeed velocidad máxima del agente
+         * @param deltaT segundos del frame, para deshacer solapamientos
+         * @param result velocidad calculada (puede ser la misma que velocity)
+         */
+        void computeVelocity(const void* owner,
+                             const Ogre::Vector3& position,
+                             const Ogre::Vector3& velocity,
+                             Ogre::Real radius,
+                             const Ogre::Vector3& preferred,
+                             Ogre::Real maxSpeed,
+                             Ogre::Real deltaT,
+                             Ogre::Vector3& result);
+        
+    private:
+        // Semiplano de velocidades permitidas: a la izquierda de la recta
+        struct Line {
+            Ogre::Vector2 point;
+            Ogre::Vector2 direction;
+        };
+        
+        const NeighbourGrid* _grid;
+        Ogre::Real _neighbourDistance;
+        int _maxNeighbours;
+        Ogre::Real _timeHorizon;
+        
+        // Memoria de trabajo de computeVelocity
+        NeighbourGrid::Neighbours _neighbours;
+        std::vector<Line> _lines;
+        std::vector<Line> _projectedLines;
+        
+        static bool linearProgram1(const std::vector<Line>& lines,
+                                   int lineNo,
+                                   Ogre::Real radius,
+                                   const Ogre::Vector2& optVelocity,
+                                   bool directionOpt,
+                                   Ogre::Vector2& result);
+        
+        static int linearProgram2(const std::vector<Line>& lines,
+                                  Ogre::Real radius,
+                                  const Ogre::Vector2& optVelocity,
+                                  bool directionOpt,
+                                  Ogre::Vector2& result);
+        
+        void linearProgram3(int beginLine,
+                            Ogre::Real radius,
+                            Ogre::Vector2& result);
+};
+
+#endif  // SIONTOWER_TRUNK_SRC_INCLUDE_VELOCITYOBSTACLES_H_
@@ -30,6 +30,8 @@
 using std::cout;
 using std::endl;
 
+const Actor::UpdateStateMethods Actor::NO_UPDATE_METHODS = {0};
+
 Actor::Actor(Ogre::SceneManager* sceneManager,
              StateGame* stateGame): GameMesh(sceneManager), _stateGame(stateGame) {
     // Inicializamos energías
@@ -41,6 +43,7 @@ Actor::Actor(Ogre::SceneManager* sceneManager,
     _currentAnimation = 0;
     _currentState = IDLE;
     _previousState = IDLE;
+    _updateMethods = NO_UPDATE_METHODS;
 }
 
 Actor::Actor(Ogre::SceneManager* sceneManager,
@@ -59,6 +62,7 @@ Actor::Actor(Ogre::SceneManager* sceneManager,
     _currentAnimation = 0;
     _currentState = IDLE;
     _previousState = IDLE;
+    _updateMethods = NO_UPDATE_METHODS;
 }
 
 Actor::Actor(Ogre::SceneManager* sceneManager,
@@ -73,6 +77,7 @@ Actor::Actor(Ogre::SceneManager* sceneManager,
     _currentAnimation = 0;
     _currentState = IDLE;
     _previousState = IDLE;
+    _updateMethods = NO_UPDATE_METHODS;
 }
 
 Actor::~Actor() {}
@@ -82,11 +87,8 @@ void Actor::update(Ogre::Real deltaT) {
     if (_currentAnimation)
         _currentAnimation->addTime(deltaT);
         
-    // Buscamos la función de actualización de su estado
-    UpdateStateMethods::iterator i = _updateMethods.find(_currentState);
-    
-    if (i != _updateMethods.end())
-        i->second(deltaT);
+    // Función de actualización de su estado
+    updateState(deltaT);
 }
         
 int Actor::getEnergy() const {
@@ -0,0 +1,148 @@
+/*
+ * This file is part of SionTower.
+ *
+ * 
+ * David Saltares M&aacute;rquez (C) 2011
+ * <david.saltares@gmail.com>
+ *
+ * 
+ * SionTower examples are free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License ad
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) ant later version.
+ *
+ * SionTower examples are distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SionTower examples.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+
+#include "aiScheduler.h"
+
+AIScheduler::AIScheduler(Ogre::Real fullDistance,
+                         Ogre::Real nearDistance,
+                         Ogre::Real farDistance,
+                         int farPeriod,
+                         Ogre::Real budget): fullDistance(fullDistance),
+                                             nearDistance(nearDistance),
+                                             farDistance(farDistance),
+                                             farPeriod(farPeriod),
+                                             budget(budget),
+                                             _focus(Ogre::Vector3::ZERO),
+                                             _camera(0),
+                                             _frame(0),
+                                             _updated(0),
+                                             _usedTime(0.0f),
+                                             _stepStartTime(0.0f),
+                                             _deferredNumber(0),
+                                             _first(0),
+                                             _visited(0),
+                                             _firstDeferred(-1) {}
+
+int AIScheduler::addAgent() {
+    int agent;
+    
+    if (_freeAgents.empty()) {
+        agent = _accumulated.size();
+        _accumulated.push_back(0.0f);
+        _deferred.push_back(false);
+    }
+    else {
+        agent = _freeAgents.back();
+        _freeAgents.pop_back();
+        _accumulated[agent] = 0.0f;
+        _deferred[agent] = false;
+    }
+    
+    return agent;
+}
+
+void AIScheduler::removeAgent(int agent) {
+    _freeAgents.push_back(agent);
+}
+
+void AIScheduler::resetBudget() {
+    _usedTime = 0.0f;
+}
+
+int AIScheduler::newFrame(const Ogre::Vector3& focus, const Ogre::Camera* camera, int agentNumber) {
+    // Empezamos por el primer agente aplazado en el frame anterior
+    if (_firstDeferred != -1)
+        _first += _firstDeferred;
+    
+    _first = agentNumber > 0? _first % agentNumber : 0;
+    
+    _focus = focus;
+    _camera = camera;
+    ++_frame;
+    _updated = 0;
+    _deferredNumber = 0;
+    _visited = 0;
+    _firstDeferred = -1;
+    _stepStartTime = _usedTime;
+    _timer.reset();
+    
+    return _first;
+}
+
+void AIScheduler::endFrame() {
+    _usedTime = _stepStartTime + _timer.getMicroseconds() * 0.001f;
+}
+
+bool AIScheduler::schedule(int agent,
+                           const Ogre::Vector3& position,
+                           Ogre::Real radius,
+                           bool fullRate,
+                           Ogre::Real deltaT,
+                           Ogre::Real& elapsed) {
+    int visited = _visited++;
+    _accumulated[agent] += deltaT;
+    
+    // Dentro de fullDistance el agente puede entrar en el alcance de ataque
+    // en cualquier frame, así que tampoco se aplaza por presupuesto
+    fullRate = fullRate || position.squaredDistance(_focus) <= fullDistance * fullDistance;
+    
+    // El identificador reparte a los agentes del mismo periodo entre frames.
+    // Los aplazados esperan sólo hasta que haya presupuesto.
+    int period = fullRate? 1 : getPeriod(position, radius);
+    
+    if (!_deferred[agent] && (_frame + agent) % period != 0)
+        return false;
+    
+    if (!fullRate && _stepStartTime + _timer.getMicroseconds() * 0.001f >= budget) {
+        _deferred[agent] = true;
+        ++_deferredNumber;
+        
+        if (_firstDeferred == -1)
+            _firstDeferred = visited;
+        
+        return false;
+    }
+    
+    elapsed = _accumulated[agent];
+    _accumulated[agent] = 0.0f;
+    _deferred[agent] = false;
+    ++_updated;
+    
+    return true;
+}
+
+int AIScheduler::getPeriod(const Ogre::Vector3& position, Ogre::Real radius) const {
+    Ogre::Real distanceSq = position.squaredDistance(_focus);
+    bool visible = !_camera || _camera->isVisible(Ogre::Sphere(position, radius));
+    int period;
+    
+    if (distanceSq <= nearDistance * nearDistance)
+        period = 1;
+    else if (distanceSq <= farDistance * farDistance)
+        period = std::max(farPeriod / 2, 1);
+    else
+        period = farPeriod;
+    
+    return visible? period : period * 2;
+}
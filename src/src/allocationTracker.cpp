@@ -0,0 +1,526 @@
+/*
+ * This file is part of SionTower.
+ *
+ * 
+ * David Saltares M&aacute;rquez (C) 2011
+ * <david.saltares@gmail.com>
+ *
+ * 
+ * SionTower examples are free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License ad
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) ant later version.
+ *
+ * SionTower examples are distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SionTower examples.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/**
+ *  @file allocationTracker.cpp
+ *  @date 19-10-2026
+ */
+
+#include <new>
+#include <vector>
+#include <algorithm>
+#include <fstream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef __GLIBC__
+    #include <execinfo.h>
+    #include <cxxabi.h>
+#endif
+
+#include "allocationTracker.h"
+#include "profiler.h"
+
+namespace {
+    // Llamadas que se guardan de cada punto de reserva
+    const int STACK_DEPTH = 12;
+    
+    // Llamadas a saltar: track y operator new
+    const int STACK_SKIP = 2;
+    
+    const int SITE_CAPACITY = 4096;
+    const int ZONE_CAPACITY = 128;
+    const int FRAME_ZONES = 6;
+    const int WORST_FRAMES = 10;
+    const int TOP_SITES = 25;
+    
+    const char* const NO_ZONE = "(sin zona)";
+    
+    // Reservas de una zona
+    struct Count {
+        const char* zone;
+        unsigned long allocations;
+        unsigned long long bytes;
+    };
+    
+    // Reservas de un punto de llamada
+    struct Site {
+        void* stack[STACK_DEPTH];
+        int depth;
+        unsigned long allocations;
+        unsigned long long bytes;
+    };
+    
+    // Reservas de un frame y sus zonas principales
+    struct Frame {
+        unsigned long index;
+        unsigned long allocations;
+        unsigned long long bytes;
+        Count zones[FRAME_ZONES];
+        int zoneNumber;
+    };
+    
+    // Todo el estado está en arrays estáticos: el gancho no puede reservar
+    // memoria ni depender del orden de inicialización
+    volatile int spinLock = 0;
+    volatile bool tracking = false;
+    bool started = false;
+    
+    Frame current;
+    Frame last;
+    Frame worst[WORST_FRAMES];
+    int worstNumber = 0;
+    
+    Count frameZones[ZONE_CAPACITY];
+    int frameZoneNumber = 0;
+    Count totalZones[ZONE_CAPACITY];
+    int totalZoneNumber = 0;
+    
+    Site sites[SITE_CAPACITY];
+    
+    unsigned long frameNumber = 0;
+    unsigned long long totalAllocations = 0;
+    unsigned long long totalBytes = 0;
+    
+    // Cerrojo activo: las secciones críticas son muy cortas
+    struct SpinLock {
+        SpinLock() {while (__sync_lock_test_and_set(&spinLock, 1));}
+        ~SpinLock() {__sync_lock_release(&spinLock);}
+    };
+    
+    bool moreAllocations(const Count& a, const Count& b) {
+        return a.allocations > b.allocations;
+    }
+    
+#ifdef SIONTOWER_ALLOCATIONS
+    void addCount(Count* counts, int& number, const char* zone, size_t size) {
+        int i = 0;
+        
+        for (; i < number && counts[i].zone != zone; ++i);
+        
+        if (i == number) {
+            // Tabla llena: la reserva sólo cuenta en el total
+            if (number == ZONE_CAPACITY)
+                return;
+            
+            counts[i].zone = zone;
+            counts[i].allocations = 0;
+            counts[i].bytes = 0;
+            ++number;
+        }
+        
+        ++counts[i].allocations;
+        counts[i].bytes += size;
+    }
+    
+    void addSite(void** stack, int depth, size_t size) {
+        unsigned long hash = depth;
+        
+        for (int i = 0; i < depth; ++i)
+            hash = hash * 31 + reinterpret_cast<unsigned long>(stack[i]);
+        
+        // Direccionamiento abierto; con la tabla llena se descarta el punto
+        for (int probe = 0; probe < SITE_CAPACITY; ++probe) {
+            Site& site = sites[(hash + probe) % SITE_CAPACITY];
+            
+            if (site.allocations == 0) {
+                std::copy(stack, stack + depth, site.stack);
+                site.depth = depth;
+            }
+            else if (site.depth != depth || !std::equal(stack, stack + depth, site.stack)) {
+                continue;
+            }
+            
+            ++site.allocations;
+            site.bytes += size;
+            return;
+        }
+    }
+    
+    void __attribute__((noinline)) track(size_t size) {
+        if (!tracking)
+            return;
+        
+        const char* zone = Profiler::getCurrentZone();
+        void* stack[STACK_SKIP + STACK_DEPTH];
+        int depth = 0;
+        
+#ifdef __GLIBC__
+        depth = std::max(backtrace(stack, STACK_SKIP + STACK_DEPTH) - STACK_SKIP, 0);
+#endif
+        
+        SpinLock lock;
+        
+        if (!tracking)
+            return;
+        
+        ++current.allocations;
+        current.bytes += size;
+        addCount(frameZones, frameZoneNumber, zone? zone : NO_ZONE, size);
+        addCount(totalZones, totalZoneNumber, zone? zone : NO_ZONE, size);
+        addSite(stack + STACK_SKIP, depth, size);
+    }
+    
+#endif
+    
+    void closeFrame() {
+        // Zonas principales del frame
+        int zones = std::min(frameZoneNumber, FRAME_ZONES);
+        std::partial_sort(frameZones, frameZones + zones, frameZones + frameZoneNumber, moreAllocations);
+        std::copy(frameZones, frameZones + zones, current.zones);
+        current.zoneNumber = zones;
+        
+        ++frameNumber;
+        totalAllocations += current.allocations;
+        totalBytes += current.bytes;
+        last = current;
+        
+        // Peores frames, de más a menos reservas
+        if (worstNumber < WORST_FRAMES || current.allocations > worst[worstNumber - 1].allocations) {
+            int i = std::min(worstNumber, WORST_FRAMES - 1);
+            
+            for (; i > 0 && worst[i - 1].allocations < current.allocations; --i)
+                worst[i] = worst[i - 1];
+            
+            worst[i] = current;
+            worstNumber = std::min(worstNumber + 1, WORST_FRAMES);
+        }
+        
+        // Siguiente frame
+        unsigned long index = current.index + 1;
+        current = Frame();
+        current.index = index;
+        frameZoneNumber = 0;
+    }
+    
+    // Nombre legible de una llamada de backtrace_symbols:
+    // "./siontower(_ZN5Spell6updateEf+0x3c) [0x4a2f1c]"
+    std::string demangle(const char* symbol) {
+        std::string text = symbol;
+        std::string::size_type begin = text.find('(');
+        std::string::size_type end = text.find('+', begin);
+        
+        if (begin == std::string::npos || end == std::string::npos || end == begin + 1)
+            return text;
+        
+        std::string mangled = text.substr(begin + 1, end - begin - 1);
+        
+#ifdef __GLIBC__
+        int status = 0;
+        char* name = abi::__cxa_demangle(mangled.c_str(), 0, 0, &status);
+        
+        if (name) {
+            mangled = name;
+            free(name);
+        }
+#endif
+        
+        return mangled;
+    }
+    
+    // Nombre cualificado sin tipo de retorno ni parámetros:
+    // "void std::vector<int>::push_back(int const&)" -> "std::vector<int>::push_back"
+    std::string qualifiedName(const std::string& name) {
+        std::string::size_type begin = 0;
+        std::string::size_type i = 0;
+        int depth = 0;
+        
+        for (; i < name.size() && (depth > 0 || name[i] != '('); ++i) {
+            if (name[i] == '<')
+                ++depth;
+            else if (name[i] == '>')
+                --depth;
+            else if (name[i] == ' ' && depth == 0)
+                begin = i + 1;
+        }
+        
+        return name.substr(begin, i - begin);
+    }
+    
+    // Llamadas que no interesan como punto de reserva
+    bool isLibrary(const std::string& name) {
+        static const char* const prefixes[] = {"std::", "__gnu_cxx::", "boost::", "Ogre::", "MyGUI::"};
+        
+        if (name.compare(0, 12, "operator new") == 0)
+            return true;
+        
+        std::string qualified = qualifiedName(name);
+        
+        for (size_t i = 0; i < sizeof(prefixes) / sizeof(prefixes[0]); ++i)
+            if (qualified.compare(0, strlen(prefixes[i]), prefixes[i]) == 0)
+                return true;
+        
+        return false;
+    }
+    
+    // Sin símbolo: función estática o biblioteca sin información
+    bool isUnnamed(const std::string& name) {
+        return name.empty() || name[0] == '.' || name[0] == '/' || name[0] == '[';
+    }
+    
+    // Primera llamada con nombre fuera de las bibliotecas (o, si no hay, la
+    // primera sin nombre) y, si es distinta, la que reserva
+    std::string describe(const Site& site) {
+        if (site.depth == 0)
+            return "?";
+        
+        std::string allocator;
+        std::string caller;
+        std::string unnamed;
+        
+#ifdef __GLIBC__
+        char** symbols = backtrace_symbols(const_cast<void**>(site.stack), site.depth);
+        
+        if (symbols) {
+            allocator = demangle(symbols[0]);
+            
+            for (int i = 0; i < site.depth && caller.empty(); ++i) {
+                std::string name = demangle(symbols[i]);
+                
+                if (isUnnamed(name)) {
+                    if (unnamed.empty())
+                        unnamed = name;
+                }
+                else if (!isLibrary(name)) {
+                    caller = name;
+                }
+            }
+            
+            free(symbols);
+        }
+#endif
+        
+        if (caller.empty())
+            caller = unnamed.empty()? allocator : unnamed;
+        
+        return caller == allocator? caller : caller + "  <-  " + qualifiedName(allocator);
+    }
+    
+    // Punto de llamada ya descrito; se agrupan las pilas con la misma descripción
+    struct SiteCount {
+        std::string function;
+        unsigned long allocations;
+        unsigned long long bytes;
+    };
+    
+    bool moreSiteCountAllocations(const SiteCount& a, const SiteCount& b) {
+        return a.allocations > b.allocations;
+    }
+    
+}
+
+bool AllocationTracker::isEnabled() {
+#ifdef SIONTOWER_ALLOCATIONS
+    return true;
+#else
+    return false;
+#endif
+}
+
+void AllocationTracker::newFrame() {
+    if (!isEnabled())
+        return;
+    
+    if (!started) {
+#ifdef __GLIBC__
+        // La primera llamada a backtrace carga libgcc y reserva memoria
+        void* stack[1];
+        backtrace(stack, 1);
+#endif
+        started = true;
+        tracking = true;
+        return;
+    }
+    
+    SpinLock lock;
+    closeFrame();
+}
+
+unsigned long AllocationTracker::getFrameAllocations() {
+    return last.allocations;
+}
+
+unsigned long long AllocationTracker::getFrameBytes() {
+    return last.bytes;
+}
+
+void AllocationTracker::report(std::ostream& out) {
+    if (!isEnabled()) {
+        out << "AllocationTracker: compila con make memoria=si para contar las reservas" << std::endl;
+        return;
+    }
+    
+    // El informe reserva memoria: dejamos de contar mientras se escribe
+    bool wasTracking = tracking;
+    tracking = false;
+    SpinLock lock;
+    
+    char line[256];
+    
+    sprintf(line, "Reservas de memoria: %lu frames, %llu reservas (%.2f por frame), %llu bytes\n",
+            frameNumber,
+            totalAllocations,
+            frameNumber? static_cast<double>(totalAllocations) / frameNumber : 0.0,
+            totalBytes);
+    out << line;
+    out << "Sin contar las reservas de OGRE (Ogre::AllocatedObject), que no pasan por operator new\n";
+    
+    out << "\nPeores frames:\n";
+    
+    for (int i = 0; i < worstNumber; ++i) {
+        sprintf(line, "  frame %8lu: %8lu reservas %12llu bytes\n",
+                worst[i].index, worst[i].allocations, worst[i].bytes);
+        out << line;
+        
+        for (int j = 0; j < worst[i].zoneNumber; ++j) {
+            sprintf(line, "  %24lu %21llu  %s\n",
+                    worst[i].zones[j].allocations, worst[i].zones[j].bytes, worst[i].zones[j].zone);
+            out << line;
+        }
+    }
+    
+    out << "\nPor zona:\n";
+    sprintf(line, "  %12s %14s  %s\n", "reservas", "bytes", "zona");
+    out << line;
+    
+    std::vector<Count> zones(totalZones, totalZones + totalZoneNumber);
+    std::sort(zones.begin(), zones.end(), moreAllocations);
+    
+    for (std::vector<Count>::iterator i = zones.begin(); i != zones.end(); ++i) {
+        sprintf(line, "  %12lu %14llu  %s\n", i->allocations, i->bytes, i->zone);
+        out << line;
+    }
+    
+    // Puntos de llamada, agrupados por función
+    std::vector<SiteCount> functions;
+    
+    for (int i = 0; i < SITE_CAPACITY; ++i) {
+        if (!sites[i].allocations)
+            continue;
+        
+        std::string function = describe(sites[i]);
+        std::vector<SiteCount>::iterator j = functions.begin();
+        
+        for (; j != functions.end() && j->function != function; ++j);
+        
+        if (j == functions.end()) {
+            functions.push_back(SiteCount());
+            j = functions.end() - 1;
+            j->function = function;
+            j->allocations = 0;
+            j->bytes = 0;
+        }
+        
+        j->allocations += sites[i].allocations;
+        j->bytes += sites[i].bytes;
+    }
+    
+    std::sort(functions.begin(), functions.end(), moreSiteCountAllocations);
+    
+    sprintf(line, "\nPuntos de llamada (%d de %d):\n",
+            std::min((int)functions.size(), TOP_SITES), (int)functions.size());
+    out << line;
+    sprintf(line, "  %12s %14s  %s\n", "reservas", "bytes", "función");
+    out << line;
+    
+    for (int i = 0; i < std::min((int)functions.size(), TOP_SITES); ++i) {
+        sprintf(line, "  %12lu %14llu  ", functions[i].allocations, functions[i].bytes);
+        out << line << functions[i].function << "\n";
+    }
+    
+    out.flush();
+    tracking = wasTracking;
+}
+
+bool AllocationTracker::report(const std::string& fileName) {
+    std::ofstream file(fileName.c_str());
+    
+    if (!file)
+        return false;
+    
+    report(file);
+    
+    return file.good();
+}
+
+
+#ifdef SIONTOWER_ALLOCATIONS
+
+// Operadores globales con recuento. Los operator delete con tamaño de C++14
+// de la biblioteca llaman a operator delete(void*), así que basta con éstos
+#if __cplusplus >= 201103L
+    #define ALLOCATION_THROW
+    #define ALLOCATION_NOTHROW noexcept
+#else
+    #define ALLOCATION_THROW throw(std::bad_alloc)
+    #define ALLOCATION_NOTHROW throw()
+#endif
+
+void* operator new(std::size_t size) ALLOCATION_THROW {
+    track(size);
+    void* pointer = malloc(size? size : 1);
+    
+    if (!pointer)
+        throw std::bad_alloc();
+    
+    return pointer;
+}
+
+void* operator new[](std::size_t size) ALLOCATION_THROW {
+    track(size);
+    void* pointer = malloc(size? size : 1);
+    
+    if (!pointer)
+        throw std::bad_alloc();
+    
+    return pointer;
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) ALLOCATION_NOTHROW {
+    track(size);
+    return malloc(size? size : 1);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) ALLOCATION_NOTHROW {
+    track(size);
+    return malloc(size? size : 1);
+}
+
+void operator delete(void* pointer) ALLOCATION_NOTHROW {
+    free(pointer);
+}
+
+void operator delete[](void* pointer) ALLOCATION_NOTHROW {
+    free(pointer);
+}
+
+void operator delete(void* pointer, const std::nothrow_t&) ALLOCATION_NOTHROW {
+    free(pointer);
+}
+
+void operator delete[](void* pointer, const std::nothrow_t&) ALLOCATION_NOTHROW {
+    free(pointer);
+}
+
+#endif
@@ -29,9 +29,7 @@ using std::cout;
 using std::endl;
 
 CameraController::CameraController(Ogre::Camera* camera,
-                                   OIS::Mouse* mouse,
                                    Player* player): _camera(camera),
-                                                    _mouse(mouse),
                                                     _player(player) {
     
     // Inicializamos parámetros
@@ -44,16 +42,30 @@ CameraController::CameraController(Ogre::Camera* camera,
     _radius = 10.0f;
     _pitch = -0.5f;
     _yaw = 0.0f;
+    
+    _previousCenter = _center;
+    _previousRadius = _radius;
+    _previousPitch = _pitch;
+    _previousYaw = _yaw;
+    
+    _zoom = 0;
+    _pitchInput = 0;
+    _yawInput = 0;
 
     
     // Establecemos posición inicial de la cámara
-    updateCameraFromParameters();
+    updateCameraFromParameters(_center, _radius, _pitch, _yaw);
 } 
 
 void CameraController::update(Ogre::Real deltaT) {
+    // Punto de partida de la interpolación de este paso
+    _previousCenter = _center;
+    _previousRadius = _radius;
+    _previousPitch = _pitch;
+    _previousYaw = _yaw;
     
     // Controlamos zoom
-    _radius += _mouse->getMouseState().Z.rel * deltaT * -0.2;
+    _radius += _zoom * deltaT * -0.2;
     
     if (_radius < 6.0f)
         _radius = 6.0f;
@@ -61,22 +73,25 @@ void CameraController::update(Ogre::Real deltaT) {
         _radius = 20.0f;
     
     // Controlamos pitch y yaw
-    if (_mouse->getMouseState().buttonDown(OIS::MB_Right)) {
-        _pitch += _mouse->getMouseState().Y.rel * deltaT * 0.1;
-        
-        if (_pitch < -0.9f)
-            _pitch = -0.9f;
-        else if (_pitch > -0.03f)
-            _pitch = -0.03f;
-        
-        _yaw += _mouse->getMouseState().X.rel * deltaT * 0.1;
-    }
+    _pitch += _pitchInput * deltaT * 0.1;
+    
+    if (_pitch < -0.9f)
+        _pitch = -0.9f;
+    else if (_pitch > -0.03f)
+        _pitch = -0.03f;
+    
+    _yaw += _yawInput * deltaT * 0.1;
     
-    // Controlamos travelling
-    Ogre::Vector3 direction = _player->getPosition() + Ogre::Vector3::UNIT_Y * _height - _targetCenter;
+    _zoom = 0;
+    _pitchInput = 0;
+    _yawInput = 0;
+    
+    // Controlamos travelling, siguiendo la posición simulada
+    const Ogre::Vector3& position = _player->getPosition();
+    Ogre::Vector3 direction = position + Ogre::Vector3::UNIT_Y * _height - _targetCenter;
     if (direction.squaredLength() > _travellingRadius * _travellingRadius) {
         _travelling = true;
-        _targetCenter = _player->getPosition() + Ogre::Vector3::UNIT_Y * _height;
+        _targetCenter = position + Ogre::Vector3::UNIT_Y * _height;
     }
     
     if (_travelling == true) {
@@ -94,20 +109,39 @@ void CameraController::update(Ogre::Real deltaT) {
     }
     
     
-    updateCameraFromParameters();
+    updateCameraFromParameters(_center, _radius, _pitch, _yaw);
+}
+
+void CameraController::interpolate(Ogre::Real alpha) {
+    updateCameraFromParameters(_previousCenter + (_center - _previousCenter) * alpha,
+                               _previousRadius + (_radius - _previousRadius) * alpha,
+                               _previousPitch + (_pitch - _previousPitch) * alpha,
+                               _previousYaw + (_yaw - _previousYaw) * alpha);
+}
+
+void CameraController::mouseMoved(const OIS::MouseEvent& arg) {
+    _zoom += arg.state.Z.rel;
+    
+    if (arg.state.buttonDown(OIS::MB_Right)) {
+        _pitchInput += arg.state.Y.rel;
+        _yawInput += arg.state.X.rel;
+    }
 }
 
-void CameraController::updateCameraFromParameters() {
+void CameraController::updateCameraFromParameters(const Ogre::Vector3& center,
+                                                  Ogre::Real radius,
+                                                  Ogre::Real pitch,
+                                                  Ogre::Real yaw) {
     // Conseguimos la rotación hacia la dirección deseada
     Ogre::Vector3 v = Ogre::Vector3::UNIT_Z;
-    Ogre::Quaternion pitchRot(Ogre::Radian(_pitch), Ogre::Vector3::UNIT_X);
+    Ogre::Quaternion pitchRot(Ogre::Radian(pitch), Ogre::Vector3::UNIT_X);
     v = pitchRot * v;
-    Ogre::Quaternion yawRot(Ogre::Radian(_yaw), Ogre::Vector3::UNIT_Y);
+    Ogre::Quaternion yawRot(Ogre::Radian(yaw), Ogre::Vector3::UNIT_Y);
     v = yawRot * v;
     
-    // Aplicamos v a center con longitud _radius
-    Ogre::Vector3 cameraPos = _center + v * _radius;    
+    // Aplicamos v a center con longitud radius
+    Ogre::Vector3 cameraPos = center + v * radius;    
     
     _camera->setPosition(cameraPos);
-    _camera->lookAt(_center);
+    _camera->lookAt(center);
 }
@@ -0,0 +1,351 @@
+/*
+ * This file is part of SionTower.
+ *
+ * 
+ * David Saltares M&aacute;rquez (C) 2011
+ * <david.saltares@gmail.com>
+ *
+ * 
+ * SionTower examples are free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License ad
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) ant later version.
+ *
+ * SionTower examples are distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SionTower examples.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <queue>
+#include <algorithm>
+#include <functional>
+
+#include "clusterGraph.h"
+#include "cell.h"
+
+// Elemento de la lista abierta: coste estimado y nodo
+typedef std::pair<Ogre::Real, int> OpenNode;
+typedef std::priority_queue<OpenNode, std::vector<OpenNode>, std::greater<OpenNode> > OpenList;
+
+ClusterGraph::ClusterGraph(NavigationMesh* navigationMesh, int clusterSize): _navigationMesh(navigationMesh),
+                                                                            _clusterNumber(0),
+                                                                            _searchStamp(0) {
+    _cellNumber = _navigationMesh->getCellNumber();
+    
+    _cellCost.resize(_cellNumber);
+    _cellParent.resize(_cellNumber);
+    _cellStamp.resize(_cellNumber, 0);
+    _cellClosed.resize(_cellNumber, 0);
+    
+    buildClusters(clusterSize);
+    buildEntrances();
+}
+
+ClusterGraph::Result ClusterGraph::findPath(Cell* startCell, Cell* endCell, NavigationMesh::CellPath& cellPath) {
+    int startId = startCell->getId();
+    int endId = endCell->getId();
+    int startCluster = _cellCluster[startId];
+    int endCluster = _cellCluster[endId];
+    
+    cellPath.clear();
+    
+    // 1. Mismo cluster: búsqueda directa sobre sus celdas
+    if (startCluster == endCluster && searchCells(startId, endId, startCluster)) {
+        recoverCells(startId, endId, cellPath);
+        return COMPLETE_PATH;
+    }
+    
+    // 2. Coste desde cada entrada del cluster de destino hasta la celda final
+    int stamp = ++_searchStamp;
+    
+    searchCells(endId, -1, endCluster);
+    
+    const std::vector<int>& endEntrances = _clusterEntrances[endCluster];
+    for (std::vector<int>::const_iterator i = endEntrances.begin(); i != endEntrances.end(); ++i) {
+        int cell = _entrances[*i].cell;
+        _entranceGoalCost[*i] = (_cellStamp[cell] == _searchStamp)? _cellCost[cell] : Ogre::Math::POS_INFINITY;
+        _entranceCost[*i] = Ogre::Math::POS_INFINITY;
+        _entranceStamp[*i] = stamp;
+    }
+    
+    // 3. Coste desde la celda de inicio hasta cada entrada de su cluster. Se
+    // conservan los padres para refinar después el primer tramo
+    searchCells(startId, -1, startCluster);
+    int startSearch = _searchStamp;
+    
+    OpenList open;
+    const Ogre::Vector3& goal = endCell->getCenter();
+    
+    const std::vector<int>& startEntrances = _clusterEntrances[startCluster];
+    for (std::vector<int>::const_iterator i = startEntrances.begin(); i != startEntrances.end(); ++i) {
+        int cell = _entrances[*i].cell;
+        
+        if (_cellStamp[cell] != startSearch)
+            continue;
+        
+        if (_entranceStamp[*i] != stamp)
+            _entranceGoalCost[*i] = Ogre::Math::POS_INFINITY;
+        
+        _entranceStamp[*i] = stamp;
+        _entranceCost[*i] = _cellCost[cell];
+        _entranceParent[*i] = -1;
+        open.push(OpenNode(_cellCost[cell] + getHeuristic(goal, cell), *i));
+    }
+    
+    // 4. A* sobre el grafo abstracto
+    Ogre::Real bestCost = Ogre::Math::POS_INFINITY;
+    int bestEntrance = -1;
+    
+    while (!open.empty()) {
+        OpenNode node = open.top();
+        open.pop();
+        
+        // La heurística es admisible: ya no se puede mejorar
+        if (node.first >= bestCost)
+            break;
+        
+        int current = node.second;
+        
+        if (_entranceClosed[current] == stamp)
+            continue;
+        
+        _entranceClosed[current] = stamp;
+        
+        // Posible final a través del cluster de destino
+        Ogre::Real total = _entranceCost[current] + _entranceGoalCost[current];
+        if (total < bestCost) {
+            bestCost = total;
+            bestEntrance = current;
+        }
+        
+        const std::vector<Edge>& edges = _entrances[current].edges;
+        for (std::vector<Edge>::const_iterator i = edges.begin(); i != edges.end(); ++i) {
+            Ogre::Real cost = _entranceCost[current] + i->cost;
+            
+            if (_entranceStamp[i->to] != stamp) {
+                _entranceStamp[i->to] = stamp;
+                _entranceGoalCost[i->to] = Ogre::Math::POS_INFINITY;
+            }
+            else if (_entranceClosed[i->to] == stamp || cost >= _entranceCost[i->to]) {
+                continue;
+            }
+            
+            _entranceCost[i->to] = cost;
+            _entranceParent[i->to] = current;
+            
+            Ogre::Real heuristic = getHeuristic(goal, _entrances[i->to].cell);
+            open.push(OpenNode(cost + heuristic, i->to));
+        }
+    }
+    
+    if (bestEntrance == -1)
+        return NO_PATH;
+    
+    // 5. Recorremos la cadena de entradas desde el origen hasta salir del
+    // cluster de inicio
+    std::vector<int> chain;
+    for (int i = bestEntrance; i != -1; i = _entranceParent[i])
+        chain.push_back(i);
+    
+    int exitEntrance = chain.back();
+    int nextEntrance = -1;
+    
+    for (int i = chain.size() - 2; i >= 0; --i) {
+        if (_entrances[chain[i]].cluster != startCluster) {
+            nextEntrance = chain[i];
+            break;
+        }
+        
+        exitEntrance = chain[i];
+    }
+    
+    // 6. Refinamos sólo el primer tramo: la búsqueda desde startId ya contiene
+    // el camino óptimo hasta la entrada de salida
+    recoverCells(startId, _entrances[exitEntrance].cell, cellPath);
+    
+    if (nextEntrance != -1)
+        cellPath.push_back(_navigationMesh->getCell(_entrances[nextEntrance].cell));
+    
+    return PARTIAL_PATH;
+}
+
+int ClusterGraph::getCluster(const Cell* cell) const {
+    return _cellCluster[cell->getId()];
+}
+
+void ClusterGraph::buildClusters(int clusterSize) {
+    _cellCluster.assign(_cellNumber, -1);
+    
+    std::vector<int> queue;
+    queue.reserve(clusterSize);
+    
+    // Crecemos regiones en anchura hasta alcanzar el tamaño máximo
+    for (int seed = 0; seed < _cellNumber; ++seed) {
+        if (_cellCluster[seed] != -1)
+            continue;
+        
+        int cluster = _clusterNumber++;
+        int size = 1;
+        
+        queue.clear();
+        queue.push_back(seed);
+        _cellCluster[seed] = cluster;
+        
+        for (unsigned int head = 0; head < queue.size() && size < clusterSize; ++head) {
+            Cell* cell = _navigationMesh->getCell(queue[head]);
+            
+            for (int side = 0; side < 3 && size < clusterSize; ++side) {
+                Cell* link = cell->getLink((Cell::CellSide)side);
+                
+                if (link && _cellCluster[link->getId()] == -1) {
+                    _cellCluster[link->getId()] = cluster;
+                    queue.push_back(link->getId());
+                    ++size;
+                }
+            }
+        }
+    }
+}
+
+void ClusterGraph::buildEntrances() {
+    _cellEntrance.assign(_cellNumber, -1);
+    _clusterEntrances.resize(_clusterNumber);
+    
+    // Las celdas con algún vecino en otro cluster son entradas
+    for (int i = 0; i < _cellNumber; ++i) {
+        Cell* cell = _navigationMesh->getCell(i);
+        
+        for (int side = 0; side < 3; ++side) {
+            Cell* link = cell->getLink((Cell::CellSide)side);
+            
+            if (link && _cellCluster[link->getId()] != _cellCluster[i]) {
+                Entrance entrance;
+                entrance.cell = i;
+                entrance.cluster = _cellCluster[i];
+                
+                _cellEntrance[i] = _entrances.size();
+                _clusterEntrances[entrance.cluster].push_back(_entrances.size());
+                _entrances.push_back(entrance);
+                break;
+            }
+        }
+    }
+    
+    int entranceNumber = _entrances.size();
+    
+    _entranceCost.resize(entranceNumber);
+    _entranceGoalCost.resize(entranceNumber);
+    _entranceParent.resize(entranceNumber);
+    _entranceStamp.resize(entranceNumber, 0);
+    _entranceClosed.resize(entranceNumber, 0);
+    
+    for (int i = 0; i < entranceNumber; ++i) {
+        Entrance& entrance = _entrances[i];
+        Cell* cell = _navigationMesh->getCell(entrance.cell);
+        
+        // Aristas entre clusters: entradas vecinas
+        for (int side = 0; side < 3; ++side) {
+            Cell* link = cell->getLink((Cell::CellSide)side);
+            
+            if (link && _cellCluster[link->getId()] != entrance.cluster) {
+                Edge edge;
+                edge.to = _cellEntrance[link->getId()];
+                edge.cost = getCost(entrance.cell, link->getId());
+                entrance.edges.push_back(edge);
+            }
+        }
+        
+        // Aristas dentro del cluster: coste precalculado entre entradas
+        searchCells(entrance.cell, -1, entrance.cluster);
+        
+        const std::vector<int>& others = _clusterEntrances[entrance.cluster];
+        for (std::vector<int>::const_iterator j = others.begin(); j != others.end(); ++j) {
+            int other = _entrances[*j].cell;
+            
+            if (*j != i && _cellStamp[other] == _searchStamp) {
+                Edge edge;
+                edge.to = *j;
+                edge.cost = _cellCost[other];
+                entrance.edges.push_back(edge);
+            }
+        }
+    }
+}
+
+Ogre::Real ClusterGraph::getCost(int cellA, int cellB) {
+    return _navigationMesh->getTraversalCost(_navigationMesh->getCell(cellA), _navigationMesh->getCell(cellB));
+}
+
+Ogre::Real ClusterGraph::getHeuristic(const Ogre::Vector3& goal, int cell) {
+    // Escalada por el menor coste de celda para no sobrestimar
+    return goal.distance(_navigationMesh->getCell(cell)->getCenter()) * _navigationMesh->getMinCost();
+}
+
+bool ClusterGraph::searchCells(int source, int target, int cluster) {
+    // Dijkstra si no hay objetivo, A* si lo hay. Sólo se visitan las celdas
+    // del cluster indicado
+    int stamp = ++_searchStamp;
+    OpenList open;
+    
+    const Ogre::Vector3* goal = (target != -1)? &_navigationMesh->getCell(target)->getCenter() : 0;
+    
+    _cellStamp[source] = stamp;
+    _cellCost[source] = 0.0f;
+    _cellParent[source] = -1;
+    open.push(OpenNode(0.0f, source));
+    
+    while (!open.empty()) {
+        int current = open.top().second;
+        open.pop();
+        
+        if (_cellClosed[current] == stamp)
+            continue;
+        
+        _cellClosed[current] = stamp;
+        
+        if (current == target)
+            return true;
+        
+        Cell* cell = _navigationMesh->getCell(current);
+        
+        for (int side = 0; side < 3; ++side) {
+            Cell* link = cell->getLink((Cell::CellSide)side);
+            
+            if (!link)
+                continue;
+            
+            int next = link->getId();
+            
+            if (_cellCluster[next] != cluster || _cellClosed[next] == stamp)
+                continue;
+            
+            Ogre::Real cost = _cellCost[current] + getCost(current, next);
+            
+            if (_cellStamp[next] == stamp && cost >= _cellCost[next])
+                continue;
+            
+            _cellStamp[next] = stamp;
+            _cellCost[next] = cost;
+            _cellParent[next] = current;
+            
+            Ogre::Real estimate = goal? cost + getHeuristic(*goal, next) : cost;
+            open.push(OpenNode(estimate, next));
+        }
+    }
+    
+    return target == -1;
+}
+
+void ClusterGraph::recoverCells(int source, int target, NavigationMesh::CellPath& cellPath) {
+    // Recorremos los padres desde el final y damos la vuelta al pasillo
+    int first = cellPath.size();
+    
+    for (int i = target; i != -1; i = _cellParent[i])
+        cellPath.push_back(_navigationMesh->getCell(i));
+    
+    std::reverse(cellPath.begin() + first, cellPath.end());
+}
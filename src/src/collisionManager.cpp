@@ -32,6 +32,7 @@
 #include <iostream>
 
 #include "collisionManager.h"
+#include "profiler.h"
 
 using std::cout;
 using std::endl;
@@ -197,6 +198,8 @@ void CollisionManager::removeAllCollisionCallbacks(CallbackType type) {
 }
 
 void CollisionManager::checkCollisions() {
+    PROFILE_ZONE("CollisionManager::checkCollisions");
+    
     // Cruzamos los Bodies y comprobamos:
     // - Existe un collisionCallback para su tipo
     // - Están a una distancia razonable (sphere test)
@@ -31,19 +31,42 @@
 #include "steeringBehaviours.h"
 #include "player.h"
 #include "soundFXManager.h"
+#include "aiScheduler.h"
 
 
 using std::cout;
 using std::endl;
 
+// Funciones de actualización indexadas por Actor::State
+const Actor::UpdateStateMethods Enemy::UPDATE_METHODS = {
+    static_cast<UpdateStateMethod>(&Enemy::stateIdle),      // IDLE
+    static_cast<UpdateStateMethod>(&Enemy::stateRun),       // RUN
+    static_cast<UpdateStateMethod>(&Enemy::stateDamaged),   // DAMAGED
+    static_cast<UpdateStateMethod>(&Enemy::stateAttack),    // ATTACK
+    0,                                                      // WIN
+    static_cast<UpdateStateMethod>(&Enemy::stateDie),       // DIE
+    0                                                       // ERASE
+};
+
 Enemy::Enemy(Ogre::SceneManager* sceneManager,
              StateGame* stateGame,
              Type type,
-             const Ogre::Vector3& position): Actor(sceneManager, stateGame), _type(type) {
-    
-    // Creamos el timer de ataque
-    _attackTimer = new Ogre::Timer();
-    _attackTimer->reset();
+             const Ogre::Vector3& position): Actor(sceneManager, stateGame),
+                                             _type(type),
+                                             _ai(&_kinematic) {
+    
+    // Nivel de detalle de la IA
+    _aiScheduler = 0;
+    _aiAgent = -1;
+    
+    // Velocidad, energías y retraso de ataque, compartidos con
+    // bench_simulation
+    const EnemyAI::TypeData& data = EnemyAI::getTypeData(type);
+    _kinematic.setMaxSpeed(data.maxSpeed);
+    _maxEnergy = data.energy;
+    _energy = _maxEnergy;
+    _power = data.power;
+    _ai.setAttackDelay(data.attackDelay);
     
     // Según tipo, cargar de una forma u otra
     if (type == GOBLIN)
@@ -67,11 +90,7 @@ Enemy::Enemy(Ogre::SceneManager* sceneManager,
     _currentState = IDLE;
     
     // Gestores de estados
-    _updateMethods[DAMAGED] = boost::bind(&Enemy::stateDamaged, this, _1);
-    _updateMethods[DIE] = boost::bind(&Enemy::stateDie, this, _1);
-    _updateMethods[IDLE] = boost::bind(&Enemy::stateIdle, this, _1);
-    _updateMethods[ATTACK] = boost::bind(&Enemy::stateAttack, this, _1);
-    _updateMethods[RUN] = boost::bind(&Enemy::stateRun, this, _1);
+    _updateMethods = UPDATE_METHODS;
     
     // Tipo de body
     _body->setType(GameObject::ENEMY);
@@ -91,17 +110,15 @@ Enemy::Enemy(Ogre::SceneManager* sceneManager,
 }
 
 Enemy::~Enemy() {
-    // Destruimos el timer de ataque
-    delete _attackTimer;
+    // EnemyAI descarta su petición de camino y su agente de SteeringSystem
+    if (_aiScheduler)
+        _aiScheduler->removeAgent(_aiAgent);
     
     // Destruimos el billboardset
     _lifeNode->detachObject(_bbSetLife);
     _sceneManager->destroyBillboardSet(_bbSetLife);
     _lifeNode->getParent()->removeChild(_lifeNode);
     _sceneManager->destroySceneNode(_lifeNode);
-    
-    // Eliminamos los updatemethods
-    _updateMethods.clear();
 }
 
 GameObject::Type Enemy::getType() const {
@@ -112,25 +129,58 @@ Enemy::Type Enemy::getEnemyType() const {
     return _type;
 }
 
+Ogre::Real Enemy::getAvoidanceRadius(Type type) {
+    return EnemyAI::getTypeData(type).radius;
+}
+
 void Enemy::update(Ogre::Real deltaT) {
+    // La animación avanza en todos los frames, sólo se aplaza la decisión
     if (_currentAnimation)
         _currentAnimation->addTime(deltaT);
+    
+    // El ataque y el daño se actualizan siempre a frecuencia completa.
+    // AIScheduler tampoco aplaza a los que están cerca del protagonista, que
+    // pueden entrar en el alcance de ataque en cualquier frame.
+    Ogre::Real elapsed = deltaT;
+    
+    if (_aiScheduler) {
+        bool fullRate = _currentState == ATTACK || _currentState == DAMAGED;
         
-    // Buscamos la función de actualización de su estado
-    UpdateStateMethods::iterator i = _updateMethods.find(_currentState);
+        if (!_aiScheduler->schedule(_aiAgent,
+                                    _kinematic.getPosition(),
+                                    _entity->getBoundingRadius(),
+                                    fullRate,
+                                    deltaT,
+                                    elapsed)) {
+            // Sin pensar, sigue con el último movimiento pedido
+            _ai.repeat();
+            
+            return;
+        }
+    }
     
-    if (i != _updateMethods.end())
-        i->second(deltaT);
+    think(elapsed);
+}
+
+void Enemy::think(Ogre::Real deltaT) {
+    // Con el tiempo de la simulación y no el del reloj, para que la partida
+    // se reproduzca igual con InputRecorder. Con AIScheduler deltaT incluye
+    // los frames sin pensar.
+    _ai.addTime(deltaT);
+        
+    // Función de actualización de su estado
+    updateState(deltaT);
         
     // Si hubo cambio de estado, tras esta actualización, el estado anterior
     // es el estado actual.
     _previousState = _currentState; // CUIDADO CON CAMBIAR DENTRO DE ESTADOS
 
     updateLifeBar();
-    
-    Ogre::Vector3 position = _kinematic.getPosition();
-    position.y = -0.03;
-    _kinematic.setPosition(position);
+}
+
+void Enemy::synchronizeMovement() {
+    // Seguimos la altura de la malla de navegación (rampas y escaleras)
+    _ai.followMesh();
     _kinematic.setOrientationFromVelocity();
     
     //synchronizeBody();    
@@ -138,17 +188,6 @@ void Enemy::update(Ogre::Real deltaT) {
 }
 
 void Enemy::loadGoblinEnemy() {
-    // Velocidad
-    _kinematic.setMaxSpeed(5.0f);
-    
-    // Energías
-    _maxEnergy = 5;
-    _energy = _maxEnergy;
-    _power = 10;
-    
-    // Retraso de ataque
-    _attackDelay = 3000.0f;
-    
     // Body
     _shapes.push_back(new OrientedBox("goblinShape", Ogre::Vector3(0, 0, 0),
                                       Ogre::Vector3(0.35 , 1, 0.3),
@@ -176,17 +215,6 @@ void Enemy::loadGoblinEnemy() {
 }
 
 void Enemy::loadDemonEnemy() {
-    // Velocidad
-    _kinematic.setMaxSpeed(4.5f);
-    
-    // Energías
-    _maxEnergy = 7;
-    _energy = _maxEnergy;
-    _power = 15;
-    
-    // Retraso de ataque
-    _attackDelay = 3000.0f;
-    
     // Body
     _shapes.push_back(new OrientedBox("demonioShape", Ogre::Vector3(0, 0, 0),
                                       Ogre::Vector3(0.45 , 1.5, 0.4),
@@ -214,17 +242,6 @@ void Enemy::loadDemonEnemy() {
 }
 
 void Enemy::loadGolemEnemy() {
-    // Velocidad
-    _kinematic.setMaxSpeed(2.0f);
-    
-    // Energías
-    _maxEnergy = 10;
-    _energy = _maxEnergy;
-    _power = 20;
-    
-    // Retraso de ataque
-    _attackDelay = 5000.0f;
-    
     // Body
     _shapes.push_back(new OrientedBox("golemShape", Ogre::Vector3(0, 0, 0),
                                       Ogre::Vector3(0.9 , 2, 0.8),
@@ -277,17 +294,16 @@ void Enemy::stateAttack(Ogre::Real deltaT) {
     Ogre::Real time = _currentAnimation->getTimePosition();
     Ogre::Real length = _currentAnimation->getLength();
     
-    // Si estamos al 30% de la animación y el timer ha pasado
-    if (time / length > 0.3f && _attackTimer->getMilliseconds() > _attackDelay) {
+    // Si estamos al 30% de la animación y ha pasado el retraso de ataque
+    if (time / length > 0.3f && _ai.isAttackReady()) {
         
-        // Reiniciamos timer, ya no puede atacar hasta dentro de un tiempo
-        _attackTimer->reset();
+        // Reiniciamos el tiempo, ya no puede atacar hasta dentro de un rato
+        _ai.resetAttack();
         
         Player* player = _stateGame->getPlayer();
-        Ogre::Vector3 distance = _kinematic.getPosition() - player->getPosition();
         
         // Si el personaje está a tiro y no está sufriendo daño, hacemos daño
-        if (distance.squaredLength() <= 4/*attackRange * _attackRange*/ &&
+        if (_ai.isInRange(player->getPosition()) &&
             player->getState() != DAMAGED && 
             player->getState() != DIE && 
             player->getState() != ERASE) {
@@ -301,81 +317,62 @@ void Enemy::stateAttack(Ogre::Real deltaT) {
 void Enemy::stateIdle(Ogre::Real deltaT) {
     Player* player = _stateGame->getPlayer();
     
-    // Hacemos algo
-    // Si el personaje está cerca, atacamos
-    Ogre::Vector3 distance = _node->getPosition() - player->getKinematic().getPosition();
-    
-    
-   if (distance.length() <= 2) {
-        if (_attackTimer->getMilliseconds() >= _attackDelay) {
-            // Atacamos
-            _kinematic.lookAt(_stateGame->getPlayer()->getPosition());
+    // Si el personaje está cerca atacamos y si no vamos hacia él
+    switch (_ai.think(player->getPosition(), false)) {
+        case EnemyAI::ATTACK:
             setState(ATTACK, false);
             // Reproducimos sonido
             _attackSound->play();
-        }
-    }
-    else {
-        // Comenzamos un camino hasta el personaje
-        setState(RUN);
-        goToLocation(_stateGame->getPlayer()->getPosition(),
-                     _navigationMesh->findCell(_stateGame->getPlayer()->getPosition()));
+            break;
+        case EnemyAI::CHASE:
+            setState(RUN);
+            break;
+        default:
+            break;
     }
 }
 
 void Enemy::stateRun(Ogre::Real deltaT) {     
     Player* player = _stateGame->getPlayer();
     
-    Steering steering;
-    
-    CollisionAvoidance avoidance(&_kinematic, _stateGame->getEnemies(), this);
-    avoidance.getSteering(steering);
-    
-    if (steering.getLinear() == Ogre::Vector3::ZERO) {
-    
-        Ogre::Vector3 distance = player->getPosition() - _path.back();
-        
-        if (distance.length() > 2) {
-            goToLocation(_stateGame->getPlayer()->getPosition(),
-                         _navigationMesh->findCell(_stateGame->getPlayer()->getPosition()));
-                         
-            return;
-        }
-                    
-        distance = player->getPosition() - _kinematic.getPosition();
-
-        if (distance.length() < 2.0f && _attackTimer->getMilliseconds() >= _attackDelay) {
-            _kinematic.setVelocity(Ogre::Vector3::ZERO);
-            _kinematic.lookAt(_stateGame->getPlayer()->getPosition());
+    switch (_ai.think(player->getPosition(), true)) {
+        case EnemyAI::ATTACK:
             setState(ATTACK, false);
             // Reproducimos sonido
             _attackSound->play();
-            return;
-        }
-
-        FollowPath followPath(&_kinematic, &_path);
-        followPath.getSteering(steering);
+            break;
+        case EnemyAI::LOST:
+            setState(IDLE);
+            break;
+        default:
+            break;
     }
-    
-    _kinematic.update(steering, deltaT);
 }
 
 void Enemy::setNavigationMesh(NavigationMesh* navigationMesh) {
-    _navigationMesh = navigationMesh;
-    Ogre::Vector3 position = _node->getPosition();
-    position.y = 0;
-    _currentCell = _navigationMesh->findCell(position);
+    _ai.setNavigationMesh(navigationMesh);
 }
 
-void Enemy::goToLocation(const Ogre::Vector3& goal, Cell* goalCell) {
-    _currentCell = _navigationMesh->findCell(_node->getPosition());
+void Enemy::setPathPlanner(PathPlanner* pathPlanner) {
+    _ai.setPathPlanner(pathPlanner);
+}
+
+void Enemy::setFlowField(bool flowField) {
+    _ai.setFlowField(flowField);
+}
+
+void Enemy::setSteeringSystem(SteeringSystem* steeringSystem) {
+    _ai.setSteeringSystem(steeringSystem, this, getAvoidanceRadius(_type));
+}
+
+void Enemy::setAIScheduler(AIScheduler* aiScheduler) {
+    if (_aiScheduler)
+        _aiScheduler->removeAgent(_aiAgent);
     
-    _pathActive = _navigationMesh->buildPath(_path, _node->getPosition(), goal, _currentCell, goalCell);
-  	
-    if(_pathActive)
-		_pathIt = _path.begin();
-    else
-        setState(IDLE);
+    _aiScheduler = aiScheduler;
+    
+    if (_aiScheduler)
+        _aiAgent = _aiScheduler->addAgent();
 }
 
 void Enemy::updateLifeBar() {
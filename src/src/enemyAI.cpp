@@ -0,0 +1,263 @@
+/*
+ * This file is part of SionTower.
+ *
+ * 
+ * David Saltares M&aacute;rquez (C) 2011
+ * <david.saltares@gmail.com>
+ *
+ * 
+ * SionTower examples are free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License ad
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) ant later version.
+ *
+ * SionTower examples are distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SionTower examples.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <boost/bind.hpp>
+
+#include "enemyAI.h"
+#include "cell.h"
+#include "steeringSystem.h"
+
+const Ogre::Real EnemyAI::ATTACK_RANGE = 2.0f;
+
+// En el orden de Enemy::Type. El radio es el del círculo que envuelve la
+// caja de colisión y la araña, sin modelo propio, usa los datos del gólem.
+static const EnemyAI::TypeData TYPE_DATA[] = {
+    {5.0f, 0.4f, 3.0f, 5, 10},      // GOBLIN
+    {4.5f, 0.5f, 3.0f, 7, 15},      // DEMON
+    {2.0f, 1.0f, 5.0f, 10, 20},     // GOLEM
+    {2.0f, 1.0f, 5.0f, 10, 20},     // SPIDER
+    {0.0f, 0.4f, 0.0f, 0, 0}        // PLAYER
+};
+
+const EnemyAI::TypeData& EnemyAI::getTypeData(int type) {
+    return TYPE_DATA[type];
+}
+
+EnemyAI::EnemyAI(Kinematic* kinematic): _kinematic(kinematic),
+                                        _attackTime(0.0f),
+                                        _attackDelay(0.0f),
+                                        _navigationMesh(0),
+                                        _pathPlanner(0),
+                                        _followPath(kinematic, &_path),
+                                        _currentCell(0),
+                                        _pathActive(false),
+                                        _pathPartial(false),
+                                        _pathPending(false),
+                                        _pathLost(false),
+                                        _pathGoal(kinematic->getPosition()),
+                                        _pathRevision(0),
+                                        _playerVisible(false),
+                                        _flowField(false),
+                                        _steeringSystem(0),
+                                        _steeringAgent(-1),
+                                        _threatRadius(0.0f),
+                                        _flee(kinematic, &_threat) {
+    // Huyendo puede alcanzar la aceleración del campo de flujo
+    _flee.maxAcceleration = 7.0f;
+}
+
+EnemyAI::~EnemyAI() {
+    // Descartamos la petición de camino en curso
+    if (_pathPlanner)
+        _pathPlanner->cancel(this);
+    
+    if (_steeringSystem)
+        _steeringSystem->removeAgent(_steeringAgent);
+}
+
+void EnemyAI::setNavigationMesh(NavigationMesh* navigationMesh) {
+    _navigationMesh = navigationMesh;
+    Ogre::Vector3 position = _kinematic->getPosition();
+    position.y = 0;
+    _currentCell = _navigationMesh->findCell(position);
+}
+
+void EnemyAI::setSteeringSystem(SteeringSystem* steeringSystem, const void* owner, Ogre::Real radius) {
+    if (_steeringSystem)
+        _steeringSystem->removeAgent(_steeringAgent);
+    
+    _steeringSystem = steeringSystem;
+    
+    if (_steeringSystem)
+        _steeringAgent = _steeringSystem->addAgent(_kinematic, owner, radius);
+}
+
+bool EnemyAI::isInRange(const Ogre::Vector3& target) const {
+    return _kinematic->getPosition().squaredDistance(target) <= ATTACK_RANGE * ATTACK_RANGE;
+}
+
+EnemyAI::Decision EnemyAI::think(const Ogre::Vector3& target, bool chasing) {
+    if (chasing)
+        return chase(target);
+    
+    // Parado junto al objetivo esperamos a poder atacar
+    if (isInRange(target)) {
+        if (!isAttackReady())
+            return WAIT;
+        
+        _kinematic->lookAt(target);
+        
+        return ATTACK;
+    }
+    
+    // Comenzamos un camino hasta el objetivo
+    _pathLost = false;
+    
+    if (!_flowField)
+        goToLocation(target);
+    
+    return CHASE;
+}
+
+EnemyAI::Decision EnemyAI::chase(const Ogre::Vector3& target) {
+    // PathPlanner no encontró camino
+    if (_pathLost) {
+        _pathLost = false;
+        _kinematic->setVelocity(Ogre::Vector3::ZERO);
+        
+        return LOST;
+    }
+    
+    // Con línea de visión hacia el objetivo vamos derechos hacia él, sin
+    // pedir ni refinar caminos. Al perderla, el objetivo del último camino
+    // se ha quedado atrás y se pide uno nuevo. Mientras llega el nuevo
+    // camino seguimos el anterior.
+    bool direct = !_flowField && _playerVisible;
+    
+    if (!_flowField && !direct) {
+        if (target.distance(_pathGoal) > ATTACK_RANGE) {
+            goToLocation(target);
+        }
+        // Con búsqueda jerárquica el camino puede ser parcial: al llegar a
+        // su final refinamos el siguiente tramo
+        else if (_pathPartial && !_pathPending &&
+                 _kinematic->getPosition().distance(_path.back()) < 1.0f) {
+            goToLocation(_pathGoal);
+        }
+        // Si se ha bloqueado o penalizado alguna celda del pasillo
+        // buscamos otro camino
+        else if (_pathActive && !_pathPending &&
+                 _navigationMesh->isCorridorAffected(_corridor, _pathRevision)) {
+            goToLocation(_pathGoal);
+        }
+    }
+    
+    if (isInRange(target) && isAttackReady()) {
+        _kinematic->setVelocity(Ogre::Vector3::ZERO);
+        _kinematic->lookAt(target);
+        
+        return ATTACK;
+    }
+    
+    // SteeringSystem mueve a todos los enemigos a la vez tras su IA
+    if (_flowField) {
+        if (!followFlowField()) {
+            _kinematic->setVelocity(Ogre::Vector3::ZERO);
+            
+            return LOST;
+        }
+    }
+    else if (direct) {
+        _steeringSystem->arrive(_steeringAgent,
+                                target,
+                                _followPath.maxAcceleration,
+                                _followPath.targetRadius,
+                                _followPath.slowRadius,
+                                _followPath.timeToTarget);
+    }
+    else if (_pathActive) {
+        _steeringSystem->followPath(_steeringAgent, _followPath);
+    }
+    
+    avoidThreat();
+    
+    return CHASE;
+}
+
+void EnemyAI::repeat() {
+    if (_steeringSystem)
+        _steeringSystem->repeat(_steeringAgent);
+}
+
+void EnemyAI::followMesh() {
+    Ogre::Vector3 position = _kinematic->getPosition();
+    
+    if (_navigationMesh) {
+        _currentCell = _navigationMesh->findCell(position, _currentCell);
+        position.y = _navigationMesh->sampleHeight(position, _currentCell) - 0.03f;
+    }
+    else {
+        position.y = -0.03f;
+    }
+    
+    _kinematic->setPosition(position);
+}
+
+bool EnemyAI::followFlowField() {
+    // La celda actual se actualiza de forma incremental
+    _currentCell = _navigationMesh->findCell(_kinematic->getPosition(), _currentCell);
+    
+    Ogre::Vector3 target;
+    
+    if (!_navigationMesh->getFlowTarget(_currentCell, _kinematic->getPosition(), target))
+        return false;
+    
+    // Siempre a máxima velocidad hacia el siguiente punto
+    _steeringSystem->arrive(_steeringAgent, target, 7.0f, 0.0f, 0.0f);
+    
+    return true;
+}
+
+void EnemyAI::avoidThreat() {
+    if (_threatRadius <= 0.0f)
+        return;
+    
+    // Huimos en el plano, la altura la ajusta followMesh
+    Ogre::Vector3 center = _threat.getPosition();
+    center.y = _kinematic->getPosition().y;
+    
+    if (_kinematic->getPosition().squaredDistance(center) >= _threatRadius * _threatRadius)
+        return;
+    
+    _threat.setPosition(center);
+    
+    // La huida va antes que la persecución y, a máxima aceleración, la
+    // sustituye hasta salir de la zona
+    _steeringSystem->addBehaviour(_steeringAgent, &_flee, 0);
+}
+
+void EnemyAI::goToLocation(const Ogre::Vector3& goal) {
+    _currentCell = _navigationMesh->findCell(_kinematic->getPosition(), _currentCell);
+    _pathGoal = goal;
+    _pathPending = true;
+    _pathRevision = _navigationMesh->getDynamicRevision();
+    
+    // Seguimos el camino anterior hasta recibir el nuevo
+    _pathPlanner->requestPath(this,
+                              _kinematic->getPosition(),
+                              goal,
+                              boost::bind(&EnemyAI::pathFound, this, _1),
+                              _currentCell);
+}
+
+void EnemyAI::pathFound(const PathPlanner::Result& result) {
+    _pathPending = false;
+    _pathActive = result.found;
+    _pathLost = !result.found;
+    
+    if (_pathActive) {
+        _path = result.path;
+        _corridor = result.corridor;
+        _pathPartial = result.partial;
+        _followPath.setPath(&_path);
+    }
+}
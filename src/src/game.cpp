@@ -42,6 +42,8 @@
 #include "levelManager.h"
 #include "profileManager.h"
 #include "spell.h"
+#include "profiler.h"
+#include "allocationTracker.h"
 
 Ogre::SceneManager* Game::_sceneManager = 0;
 Ogre::RenderWindow* Game::_window = 0;
@@ -49,9 +51,12 @@ Ogre::Viewport* Game::_viewport = 0;
 Ogre::Log* Game::_log = 0;
 Ogre::Camera* Game::_camera = 0;
 
-Game::Game() {
-    // Semilla aleatoria
-    srand(time(NULL));
+Game::Game(InputRecorder::Mode inputMode, const Ogre::String& inputFile) {
+    PROFILE_THREAD("main");
+    
+    // Semilla aleatoria, la de la grabación si se reproduce una
+    _inputRecorder = new InputRecorder(inputMode, inputFile);
+    srand(_inputRecorder->getSeed());
     
     // Iniciamos Ogre
     if(!initialiseOgre()) {
@@ -89,7 +94,7 @@ Game::Game() {
     _levelManager = new LevelManager();
 
     // Creamos el gestor de estados
-    _stateManager = new StateManager(this, _inputManager);
+    _stateManager = new StateManager(this, _inputManager, _inputRecorder);
     
     // Creamos el gestor de perfiles
     _profileManager = new ProfileManager();
@@ -100,12 +105,25 @@ Game::Game() {
 
 Game::~Game() {
     _log->logMessage("Game::~Game()");
+    
+#ifdef SIONTOWER_PROFILER
+    // Volcamos las últimas zonas medidas
+    if (Profiler::dump("siontower-trace.json"))
+        _log->logMessage("Game::~Game() -> Traza del perfilador en siontower-trace.json");
+#endif
+
+    // Informe de reservas de memoria (make memoria=si)
+    if (AllocationTracker::isEnabled() && AllocationTracker::report("siontower-allocations.txt"))
+        _log->logMessage("Game::~Game() -> Informe de reservas en siontower-allocations.txt");
 
     // Destruimos el gestor de perfiles
     delete _profileManager;
 
     // Destruimos el gestor de estados
     delete _stateManager;
+    
+    // Cerramos la grabación de la entrada
+    delete _inputRecorder;
 
     // Destruimos el gestor de niveles
     delete _levelManager;
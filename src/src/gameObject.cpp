@@ -40,13 +40,20 @@ using std::cout;
 using std::endl;
 
 
-GameObject::GameObject(Ogre::SceneManager* sceneManager): _sceneManager(sceneManager), _body(0) {
+GameObject::GameObject(Ogre::SceneManager* sceneManager): _sceneManager(sceneManager),
+                                                          _body(0),
+                                                          _savedTransform(false),
+                                                          _interpolated(false) {
     // Creamos el SceneNode
     _node = _sceneManager->getRootSceneNode()->createChildSceneNode();
 }
 
 GameObject::GameObject(Ogre::SceneManager* sceneManager,
-                       Ogre::SceneNode* sceneNode): _sceneManager(sceneManager), _node(sceneNode), _body(0){
+                       Ogre::SceneNode* sceneNode): _sceneManager(sceneManager),
+                                                    _node(sceneNode),
+                                                    _body(0),
+                                                    _savedTransform(false),
+                                                    _interpolated(false) {
 }
 
 GameObject::~GameObject() {
@@ -163,3 +170,38 @@ void GameObject::synchronizeSceneNode() {
         _node->setScale(_body->getScale());
     }
 }
+
+void GameObject::saveTransform() {
+    if (!_node)
+        return;
+    
+    // La simulación siempre parte de la posición simulada, no de la dibujada
+    restoreTransform();
+    
+    _previousPosition = _node->getPosition();
+    _previousOrientation = _node->getOrientation();
+    _savedTransform = true;
+}
+
+void GameObject::interpolateTransform(Ogre::Real alpha) {
+    // Los objetos creados durante el último paso aún no tienen anterior
+    if (!_node || !_savedTransform)
+        return;
+    
+    if (!_interpolated) {
+        _position = _node->getPosition();
+        _orientation = _node->getOrientation();
+        _interpolated = true;
+    }
+    
+    _node->setPosition(_previousPosition + (_position - _previousPosition) * alpha);
+    _node->setOrientation(Ogre::Quaternion::Slerp(alpha, _previousOrientation, _orientation, true));
+}
+
+void GameObject::restoreTransform() {
+    if (_interpolated) {
+        _node->setPosition(_position);
+        _node->setOrientation(_orientation);
+        _interpolated = false;
+    }
+}
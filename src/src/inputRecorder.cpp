@@ -0,0 +1,389 @@
+/*
+ * This file is part of SionTower.
+ *
+ * 
+ * David Saltares M&aacute;rquez (C) 2011
+ * <david.saltares@gmail.com>
+ *
+ * 
+ * SionTower examples are free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License ad
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) ant later version.
+ *
+ * SionTower examples are distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SionTower examples.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/**
+ *  @file inputRecorder.cpp
+ *  @date 19-10-2026
+ */
+
+#include <iostream>
+#include <iterator>
+#include <algorithm>
+#include <cstdlib>
+#include <ctime>
+
+#include "inputRecorder.h"
+
+// Cabecera del fichero
+static const char MAGIC[] = {'S', 'T', 'I', 'R'};
+static const unsigned int VERSION = 1;
+
+
+//! Teclado cuyo estado sale de los eventos reproducidos
+
+class ReplayKeyboard: public OIS::Keyboard {
+    public:
+        ReplayKeyboard(): OIS::Keyboard("InputRecorder", true, 0, 0) {
+            std::fill(_keys, _keys + 256, 0);
+        }
+        
+        bool isKeyDown(OIS::KeyCode key) const {return _keys[key] != 0;}
+        
+        const std::string& getAsString(OIS::KeyCode key) {
+            _name = Ogre::StringConverter::toString(static_cast<int>(key));
+            return _name;
+        }
+        
+        void copyKeyStates(char keys[256]) const {std::copy(_keys, _keys + 256, keys);}
+        
+        void setBuffered(bool buffered) {}
+        void capture() {}
+        OIS::Interface* queryInterface(OIS::Interface::IType type) {return 0;}
+        void _initialize() {}
+        
+        void setKey(OIS::KeyCode key, bool down) {_keys[key] = down;}
+        
+    private:
+        char _keys[256];
+        std::string _name;
+};
+
+
+//! Ratón cuyo estado sale de los eventos reproducidos
+
+class ReplayMouse: public OIS::Mouse {
+    public:
+        ReplayMouse(): OIS::Mouse("InputRecorder", true, 0, 0) {}
+        
+        void setBuffered(bool buffered) {}
+        void capture() {}
+        OIS::Interface* queryInterface(OIS::Interface::IType type) {return 0;}
+        void _initialize() {}
+        
+        void setState(const OIS::MouseState& state) {mState = state;}
+        
+        // Como OIS al capturar, el movimiento relativo es el del cuadro
+        void clearRelative() {
+            mState.X.rel = 0;
+            mState.Y.rel = 0;
+            mState.Z.rel = 0;
+        }
+};
+
+
+InputRecorder::InputRecorder(Mode mode, const Ogre::String& fileName): _mode(mode),
+                                                                       _seed(time(NULL)),
+                                                                       _batchPending(false),
+                                                                       _batch(0),
+                                                                       _keyboard(0),
+                                                                       _mouse(0),
+                                                                       _tick(0),
+                                                                       _frameNumber(0),
+                                                                       _totalFrameTime(0.0f),
+                                                                       _maxFrameTime(0.0f) {
+    if (_mode == RECORD) {
+        _output.open(fileName.c_str(), std::ios::out | std::ios::binary);
+        
+        if (!_output) {
+            std::cerr << "InputRecorder::InputRecorder(): no se pudo crear " << fileName << std::endl;
+            exit(1);
+        }
+        
+        _output.write(MAGIC, sizeof(MAGIC));
+        writeInt(VERSION, 4);
+        writeInt(_seed, 4);
+    }
+    else if (_mode == REPLAY) {
+        load(fileName);
+        _keyboard = new ReplayKeyboard();
+        _mouse = new ReplayMouse();
+    }
+}
+
+InputRecorder::~InputRecorder() {
+    if (_output.is_open())
+        _output.close();
+    
+    delete _keyboard;
+    delete _mouse;
+}
+
+OIS::Keyboard* InputRecorder::getKeyboard(OIS::Keyboard* keyboard) {
+    return _keyboard? _keyboard : keyboard;
+}
+
+OIS::Mouse* InputRecorder::getMouse(OIS::Mouse* mouse) {
+    return _mouse? _mouse : mouse;
+}
+
+void InputRecorder::newFrame(Ogre::Real frameTime) {
+    ++_frameNumber;
+    _totalFrameTime += frameTime * 1000.0f;
+    _maxFrameTime = std::max(_maxFrameTime, frameTime * 1000.0f);
+    
+    _batchPending = true;
+    
+    if (_mouse)
+        _mouse->clearRelative();
+}
+
+Ogre::Real InputRecorder::getMeanFrameTime() const {
+    return _frameNumber? _totalFrameTime / _frameNumber : 0.0f;
+}
+
+bool InputRecorder::keyPressed(const OIS::KeyEvent& arg) {
+    if (!record(KEY_PRESSED, arg))
+        return false;
+    
+    if (_mode == RECORD) {
+        writeInt(arg.key, 2);
+        writeInt(arg.text, 4);
+    }
+    
+    return true;
+}
+
+bool InputRecorder::keyReleased(const OIS::KeyEvent& arg) {
+    if (!record(KEY_RELEASED, arg))
+        return false;
+    
+    if (_mode == RECORD) {
+        writeInt(arg.key, 2);
+        writeInt(arg.text, 4);
+    }
+    
+    return true;
+}
+
+bool InputRecorder::mouseMoved(const OIS::MouseEvent& arg) {
+    if (!record(MOUSE_MOVED, arg))
+        return false;
+    
+    if (_mode == RECORD)
+        writeMouseState(arg.state);
+    
+    return true;
+}
+
+bool InputRecorder::mousePressed(const OIS::MouseEvent& arg, OIS::MouseButtonID id) {
+    if (!record(MOUSE_PRESSED, arg))
+        return false;
+    
+    if (_mode == RECORD) {
+        writeByte(id);
+        writeMouseState(arg.state);
+    }
+    
+    return true;
+}
+
+bool InputRecorder::mouseReleased(const OIS::MouseEvent& arg, OIS::MouseButtonID id) {
+    if (!record(MOUSE_RELEASED, arg))
+        return false;
+    
+    if (_mode == RECORD) {
+        writeByte(id);
+        writeMouseState(arg.state);
+    }
+    
+    return true;
+}
+
+bool InputRecorder::replayBatch(OIS::KeyListener* keyListener, OIS::MouseListener* mouseListener) {
+    if (_mode != REPLAY || hasEnded() || _batch >= (int)_ticks[_tick].size())
+        return false;
+    
+    const Batch& batch = _ticks[_tick][_batch++];
+    
+    for (Batch::const_iterator i = batch.begin(); i != batch.end(); ++i) {
+        switch (i->type) {
+            case KEY_PRESSED:
+                _keyboard->setKey(i->key, true);
+                keyListener->keyPressed(OIS::KeyEvent(_keyboard, i->key, i->text));
+                break;
+            case KEY_RELEASED:
+                _keyboard->setKey(i->key, false);
+                keyListener->keyReleased(OIS::KeyEvent(_keyboard, i->key, i->text));
+                break;
+            case MOUSE_MOVED:
+                _mouse->setState(i->state);
+                mouseListener->mouseMoved(OIS::MouseEvent(_mouse, i->state));
+                break;
+            case MOUSE_PRESSED:
+                _mouse->setState(i->state);
+                mouseListener->mousePressed(OIS::MouseEvent(_mouse, i->state), i->button);
+                break;
+            case MOUSE_RELEASED:
+                _mouse->setState(i->state);
+                mouseListener->mouseReleased(OIS::MouseEvent(_mouse, i->state), i->button);
+                break;
+            default:
+                break;
+        }
+    }
+    
+    return true;
+}
+
+void InputRecorder::endTick() {
+    if (_mode == NONE || hasEnded())
+        return;
+    
+    if (_mode == RECORD)
+        writeByte(TICK);
+    
+    ++_tick;
+    _batch = 0;
+}
+
+bool InputRecorder::hasEnded() const {
+    return _mode == REPLAY && _tick >= (int)_ticks.size();
+}
+
+void InputRecorder::load(const Ogre::String& fileName) {
+    std::ifstream input(fileName.c_str(), std::ios::in | std::ios::binary);
+    
+    if (!input) {
+        std::cerr << "InputRecorder::load(): no se pudo abrir " << fileName << std::endl;
+        exit(1);
+    }
+    
+    std::vector<unsigned char> data((std::istreambuf_iterator<char>(input)),
+                                    std::istreambuf_iterator<char>());
+    
+    // Comprobamos la cabecera
+    size_t pos = sizeof(MAGIC);
+    bool valid = data.size() >= pos && std::equal(MAGIC, MAGIC + pos, data.begin());
+    
+    if (valid && readInt(data, pos, valid, 4) != VERSION)
+        valid = false;
+    
+    _seed = readInt(data, pos, valid, 4);
+    _ticks.push_back(Tick());
+    
+    while (valid && pos < data.size()) {
+        Event event;
+        event.type = static_cast<Record>(data[pos++]);
+        
+        switch (event.type) {
+            case TICK:
+                _ticks.push_back(Tick());
+                continue;
+            case BATCH:
+                _ticks.back().push_back(Batch());
+                continue;
+            case KEY_PRESSED:
+            case KEY_RELEASED:
+                event.key = static_cast<OIS::KeyCode>(readInt(data, pos, valid, 2));
+                event.text = readInt(data, pos, valid, 4);
+                break;
+            case MOUSE_PRESSED:
+            case MOUSE_RELEASED:
+                event.button = static_cast<OIS::MouseButtonID>(readInt(data, pos, valid, 1));
+                // Sin break: también llevan el estado del ratón
+            case MOUSE_MOVED:
+                event.state.X.abs = static_cast<int>(readInt(data, pos, valid, 4));
+                event.state.Y.abs = static_cast<int>(readInt(data, pos, valid, 4));
+                event.state.Z.abs = static_cast<int>(readInt(data, pos, valid, 4));
+                event.state.X.rel = static_cast<int>(readInt(data, pos, valid, 4));
+                event.state.Y.rel = static_cast<int>(readInt(data, pos, valid, 4));
+                event.state.Z.rel = static_cast<int>(readInt(data, pos, valid, 4));
+                event.state.buttons = static_cast<int>(readInt(data, pos, valid, 4));
+                event.state.width = static_cast<int>(readInt(data, pos, valid, 4));
+                event.state.height = static_cast<int>(readInt(data, pos, valid, 4));
+                break;
+            default:
+                valid = false;
+                break;
+        }
+        
+        // Todo evento pertenece a un lote
+        if (valid && !_ticks.back().empty())
+            _ticks.back().back().push_back(event);
+        else
+            valid = false;
+    }
+    
+    if (!valid) {
+        std::cerr << "InputRecorder::load(): " << fileName << " no es una grabación válida" << std::endl;
+        exit(1);
+    }
+    
+    // El último paso, sin cerrar, no llegó a simularse
+    _ticks.pop_back();
+}
+
+bool InputRecorder::record(Record type, const OIS::EventArg& arg) {
+    // Al reproducir sólo se aceptan los eventos propios
+    if (_mode == REPLAY)
+        return arg.device == _keyboard || arg.device == _mouse;
+    
+    if (_mode == RECORD) {
+        if (_batchPending) {
+            writeByte(BATCH);
+            _batchPending = false;
+        }
+        
+        writeByte(type);
+    }
+    
+    return true;
+}
+
+unsigned int InputRecorder::readInt(const std::vector<unsigned char>& data,
+                                    size_t& pos,
+                                    bool& valid,
+                                    int bytes) {
+    unsigned int value = 0;
+    
+    if (pos + bytes > data.size()) {
+        valid = false;
+        return 0;
+    }
+    
+    for (int i = 0; i < bytes; ++i)
+        value |= static_cast<unsigned int>(data[pos++]) << (8 * i);
+    
+    return value;
+}
+
+void InputRecorder::writeByte(unsigned char value) {
+    _output.put(value);
+}
+
+void InputRecorder::writeInt(unsigned int value, int bytes) {
+    for (int i = 0; i < bytes; ++i)
+        writeByte((value >> (8 * i)) & 0xFF);
+}
+
+void InputRecorder::writeMouseState(const OIS::MouseState& state) {
+    writeInt(state.X.abs, 4);
+    writeInt(state.Y.abs, 4);
+    writeInt(state.Z.abs, 4);
+    writeInt(state.X.rel, 4);
+    writeInt(state.Y.rel, 4);
+    writeInt(state.Z.rel, 4);
+    writeInt(state.buttons, 4);
+    writeInt(state.width, 4);
+    writeInt(state.height, 4);
+}
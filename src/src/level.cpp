@@ -40,12 +40,13 @@
 #include "songManager.h"
 #include "stateManager.h"
 #include "collisionManager.h"
+#include "profiler.h"
 
 using std::cout;
 using std::endl;
 using std::cerr;
 
-Level::Level(const Ogre::String& id): _id(id), _name(""), _description(""), _loaded(false), _navigationMesh(0) {
+Level::Level(const Ogre::String& id): _id(id), _name(""), _description(""), _loaded(false), _navigationMesh(0), _navigationClusterSize(0), _flowField(false), _maxEnemies(5) {
     cout << "Level::Level()" << endl;
     loadBasicInfo();
 }
@@ -87,9 +88,22 @@ void Level::loadBasicInfo() {
     node = basicInfo.child("song");
     _musicName = node.attribute("name").value();
     _musicGroup = node.attribute("group").value();
+    
+    // Búsqueda jerárquica en la malla de navegación (opcional)
+    node = basicInfo.child("navigation");
+    _navigationClusterSize = node.attribute("clusterSize").as_int();
+    _flowField = node.attribute("flowField").as_bool();
+    
+    // Máximo de enemigos simultáneos (opcional)
+    pugi::xml_attribute maxEnemies = basicInfo.child("enemies").attribute("max");
+    
+    if (maxEnemies)
+        _maxEnemies = maxEnemies.as_int();
 }
 
 void Level::load() {
+    PROFILE_ZONE("Level::load");
+    
     if (!_loaded) {
         _loaded = true;
         
@@ -296,7 +310,7 @@ void Level::loadEntity(const pugi::xml_node& node,
     // Objeto de nombre "navMesh"
     else if (nameParts.size() == 1 && nameParts[0] == "navMesh") {
         // Creamos el navigation mesh
-        _navigationMesh = new NavigationMesh("media/" + entityMesh + ".xml");
+        _navigationMesh = new NavigationMesh("media/" + entityMesh + ".xml", _navigationClusterSize);
     }
     // Objeto con forma particle.nombreParticulas.id
     else if (nameParts.size() == 3 && nameParts[0] == "particle") {
@@ -501,6 +515,14 @@ NavigationMesh* Level::getNavigationMesh() {
     return _navigationMesh;
 }
 
+bool Level::isFlowFieldEnabled() const {
+    return _flowField;
+}
+
+int Level::getMaxEnemies() const {
+    return _maxEnemies;
+}
+
 
 std::vector<EnemySpawn>& Level::getEnemySpawns() {
     return _enemySpawns;
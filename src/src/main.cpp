@@ -45,7 +45,24 @@ int main(int argc, char **argv) {
     bindtextdomain("siontower", "lang" );
     textdomain("siontower");
     
-    Game* sionTower = new Game();
+    // Grabación (--record fichero) o reproducción (--replay fichero) de la entrada
+    InputRecorder::Mode inputMode = InputRecorder::NONE;
+    Ogre::String inputFile;
+    
+    for (int i = 1; i < argc; ++i) {
+        Ogre::String arg = argv[i];
+        
+        if ((arg == "--record" || arg == "--replay") && i + 1 < argc) {
+            inputMode = (arg == "--record")? InputRecorder::RECORD : InputRecorder::REPLAY;
+            inputFile = argv[++i];
+        }
+        else {
+            cerr << "Uso: " << argv[0] << " [--record fichero | --replay fichero]" << endl;
+            return 1;
+        }
+    }
+    
+    Game* sionTower = new Game(inputMode, inputFile);
     
     sionTower->start();
     
@@ -24,33 +24,75 @@
 #include <vector>
 #include <algorithm>
 #include <ctime>
+#include <queue>
+#include <functional>
 
 #include "pugixml.hpp"
 
 #include "navigationMesh.h"
+#include "clusterGraph.h"
+#include "profiler.h"
 
 
 using std::cout;
 using std::cerr;
 using std::endl;
 
-NavigationMesh::NavigationMesh(const Ogre::String& fileName): _cellNumber(0) {
+NavigationMesh::NavigationMesh(const Ogre::String& fileName, int clusterSize): _cellNumber(0),
+                                                                                _minCost(1.0f),
+                                                                                _gridMinX(0.0f),
+                                                                                _gridMinZ(0.0f),
+                                                                                _gridSize(1.0f),
+                                                                                _gridWidth(0),
+                                                                                _gridHeight(0),
+                                                                                _graph(0),
+                                                                                _paths(0),
+                                                                                _clusterGraph(0),
+                                                                                _flowTargetCell(0),
+                                                                                _flowRevision(0),
+                                                                                _dynamicRevision(0),
+                                                                                _markNumber(0),
+                                                                                _searchRun(0),
+                                                                                _frame(0) {
+    // La caché de líneas de visión empieza vacía
+    for (int i = 0; i < LOS_CACHE_SIZE; ++i)
+        _losCache[i].frame = -1;
+    
+    _buildStats.parse = 0.0f;
+    _buildStats.link = 0.0f;
+    _buildStats.graph = 0.0f;
+    _buildStats.floyd = 0.0f;
+    _buildStats.clusters = 0.0f;
+    
     // Si hemos suministrado un nombre para el fichero
     if (fileName != "") {
+        Ogre::Timer timer;
+        
         // Cargamos las celdas del fichero XML
         loadCellsFromXML(fileName);
+        _buildStats.parse = timer.getMicroseconds() * 0.001f;
+        timer.reset();
         
         // Enlazamos las celdas
         linkCells();
-	
-	// Construimos grafo
-	initGraph();
-	
-	// Distancias mínimas
-	floyd();
-	
-	// Precomputamos caminos simplificados
-	precomputePaths();
+        _buildStats.link = timer.getMicroseconds() * 0.001f;
+        timer.reset();
+        
+        // Grafo abstracto para la búsqueda jerárquica
+        if (clusterSize > 0) {
+            _clusterGraph = new ClusterGraph(this, clusterSize);
+            _buildStats.clusters = timer.getMicroseconds() * 0.001f;
+        }
+        else {
+            // Construimos grafo
+            initGraph();
+            _buildStats.graph = timer.getMicroseconds() * 0.001f;
+            timer.reset();
+            
+            // Distancias mínimas
+            floyd();
+            _buildStats.floyd = timer.getMicroseconds() * 0.001f;
+        }
     }
 }
 
@@ -61,11 +103,13 @@ NavigationMesh::~NavigationMesh() {
     // Liberamos la memoria del grafo
     delete [] _graph;
     delete [] _paths;
+    delete _clusterGraph;
 }
         
 void NavigationMesh::loadCellsFromXML(const Ogre::String& fileName) {
     pugi::xml_document doc;
     std::vector<int> a, b, c;
+    std::vector<Ogre::Real> cost;
     std::vector<Ogre::Vector3> vertex;
     
     // Abrimos el fichero XML
@@ -90,6 +134,10 @@ void NavigationMesh::loadCellsFromXML(const Ogre::String& fileName) {
         a.push_back(v1);
         b.push_back(v2);
         c.push_back(v3);
+        
+        // Multiplicador de coste opcional de la celda
+        pugi::xml_attribute costAttribute = faceNode.attribute("cost");
+        cost.push_back(costAttribute? costAttribute.as_float() : 1.0f);
     }
     
     pugi::xml_node geometryNode = subMeshNode.child("geometry");
@@ -108,18 +156,37 @@ void NavigationMesh::loadCellsFromXML(const Ogre::String& fileName) {
     int faceCount = a.size();
     
     // Recorremos las caras añadiendo celdas
-    for (int i = 0; i < faceCount; ++i)
+    for (int i = 0; i < faceCount; ++i) {
         addCell(i, vertex[a[i]], vertex[b[i]], vertex[c[i]]);
+        
+        if (cost[i] <= 0.0f) {
+            cerr << "NavigationMesh::loadCellsFromXML(): coste no positivo en la cara " << i << " de " << fileName << endl;
+            exit(1);
+        }
+        
+        _cellCosts.back() = cost[i];
+        _minCost = (i == 0)? cost[i] : std::min(_minCost, cost[i]);
+    }
 }
 
 void NavigationMesh::clear() {
-    // Recorremos y destruimos las celdas
-    for (Cells::iterator i = _cells.begin(); i != _cells.end(); ++i)
-        delete (*i);
-    
-    // Vaciamos el vector
+    // Destruimos las vistas y los datos de las celdas
+    _cellViews.clear();
     _cells.clear();
     
+    _vertices.clear();
+    _vertexIds.clear();
+    _cellVertices.clear();
+    _cellLinks.clear();
+    _cellLinkSides.clear();
+    _edgeNormals.clear();
+    _edgeOffsets.clear();
+    _centers.clear();
+    _cellCosts.clear();
+    _heightA.clear();
+    _heightB.clear();
+    _heightC.clear();
+    
     _cellNumber = 0;
 }
         
@@ -127,38 +194,187 @@ void NavigationMesh::addCell(int id,
 			     const Ogre::Vector3& pointA,
                              const Ogre::Vector3& pointB,
                              const Ogre::Vector3& pointC) {
-    // Creamos la celda nueva
-    Cell* cell = new Cell(id, pointA, pointB, pointC);
+    // Los datos se indexan por identificador
+    if (id != _cellNumber) {
+        cerr << "NavigationMesh::addCell(): se esperaba la celda " << _cellNumber << " y no la " << id << endl;
+        exit(1);
+    }
+    
+    const Ogre::Vector3 points[3] = {pointA, pointB, pointC};
+    
+    // Los vértices con la misma posición se comparten
+    for (int i = 0; i < 3; ++i) {
+        std::pair<VertexIds::iterator, bool> inserted = _vertexIds.insert(std::make_pair(points[i], (int)_vertices.size()));
+        
+        if (inserted.second)
+            _vertices.push_back(points[i]);
+        
+        _cellVertices.push_back(inserted.first->second);
+        _cellLinks.push_back(-1);
+        _cellLinkSides.push_back(-1);
+    }
+    
+    // Centro
+    _centers.push_back((pointA + pointB + pointC) / 3.0f);
+    _cellCosts.push_back(1.0f);
     
-    // Añadimos la celda al conjunto de celdas
-    _cells.push_back(cell);
+    // Normales de los lados en XZ apuntando hacia dentro, con un pequeño
+    // margen para que no queden huecos entre celdas vecinas
+    for (int i = 0; i < 3; ++i) {
+        const Ogre::Vector3& a = points[i];
+        const Ogre::Vector3& b = points[(i + 1) % 3];
+        const Ogre::Vector3& c = points[(i + 2) % 3];
+        
+        Ogre::Vector2 normal(a.z - b.z, b.x - a.x);
+        normal.normalise();
+        
+        if (normal.x * (c.x - a.x) + normal.y * (c.z - a.z) < 0.0f)
+            normal = -normal;
+        
+        _edgeNormals.push_back(normal);
+        _edgeOffsets.push_back(normal.x * a.x + normal.y * a.z - 1e-5f);
+    }
+    
+    // Coeficientes del plano. Las celdas verticales toman la altura de
+    // su centro
+    Ogre::Vector3 normal = (pointB - pointA).crossProduct(pointC - pointA);
+    
+    if (Ogre::Math::Abs(normal.y) > 1e-6f) {
+        _heightA.push_back(-normal.x / normal.y);
+        _heightB.push_back(-normal.z / normal.y);
+        _heightC.push_back(pointA.y - _heightA.back() * pointA.x - _heightB.back() * pointA.z);
+    }
+    else {
+        _heightA.push_back(0.0f);
+        _heightB.push_back(0.0f);
+        _heightC.push_back(_centers.back().y);
+    }
+    
+    // Creamos la vista de la celda
+    _cellViews.push_back(Cell(this, id));
+    _cells.push_back(&_cellViews.back());
     
     // Aumentamos el número de celdas
     ++_cellNumber;
 }
                      
 void NavigationMesh::linkCells() {
-    Cell* cellA;
-    Cell* cellB;
-    
-    // Cruzamos las celdas y unimos aristas comunes
-    for (Cells::iterator i = _cells.begin(); i != _cells.end(); ++i) {
-        for (Cells::iterator j = _cells.begin(); j != _cells.end(); ++j) {
-            // Evitamos tomar la misma celda
-            if (i != j) {
-                cellA = *i;
-                cellB = *j;
-                
-                if (!cellA->getLink(Cell::SIDE_AB) && cellB->requestLink(cellA->getVertex(0), cellA->getVertex(1), cellA))
-                    cellA->setLink(Cell::SIDE_AB, cellB);
-                else if (!cellA->getLink(Cell::SIDE_BC) && cellB->requestLink(cellA->getVertex(1), cellA->getVertex(2), cellA))
-                    cellA->setLink(Cell::SIDE_BC, cellB);
-                else if (!cellA->getLink(Cell::SIDE_CA) && cellB->requestLink(cellA->getVertex(2), cellA->getVertex(0), cellA))
-                    cellA->setLink(Cell::SIDE_CA, cellB);
+    typedef std::map<std::pair<int, int>, int> Edges;
+    Edges edges;
+    
+    // Dos celdas son vecinas si comparten los vértices de un lado
+    for (int cell = 0; cell < _cellNumber; ++cell) {
+        for (int side = 0; side < 3; ++side) {
+            int a = _cellVertices[cell * 3 + side];
+            int b = _cellVertices[cell * 3 + (side + 1) % 3];
+            std::pair<Edges::iterator, bool> inserted = edges.insert(std::make_pair(std::make_pair(std::min(a, b), std::max(a, b)),
+                                                                                    cell * 3 + side));
+            
+            if (inserted.second)
+                continue;
+            
+            // El lado ya estaba: enlazamos ambas celdas si aún está libre
+            int other = inserted.first->second;
+            
+            if (_cellLinks[other] == -1 && other / 3 != cell) {
+                _cellLinks[other] = cell;
+                _cellLinkSides[other] = side;
+                _cellLinks[cell * 3 + side] = other / 3;
+                _cellLinkSides[cell * 3 + side] = other % 3;
+            }
+        }
+    }
+    
+    // Sin marcas dinámicas
+    _dynamicCost.assign(_cellNumber, 1.0f);
+    _portalBlocked.assign(_cellNumber * 3, false);
+    _cellRevision.assign(_cellNumber, 0);
+    _markNumber = 0;
+    
+    _searchCost.resize(_cellNumber);
+    _searchParent.resize(_cellNumber);
+    _searchStamp.assign(_cellNumber, 0);
+    _searchTarget.assign(_cellNumber, 0);
+    
+    // Índice espacial para las consultas de posición
+    buildSpatialIndex();
+}
+
+void NavigationMesh::buildSpatialIndex() {
+    Ogre::Real minX = Ogre::Math::POS_INFINITY, maxX = Ogre::Math::NEG_INFINITY;
+    Ogre::Real minZ = Ogre::Math::POS_INFINITY, maxZ = Ogre::Math::NEG_INFINITY;
+    
+    for (int i = 0; i < _cellNumber; ++i) {
+        const Ogre::Vector3& a = getCellVertex(i, Cell::VERT_A);
+        const Ogre::Vector3& b = getCellVertex(i, Cell::VERT_B);
+        const Ogre::Vector3& c = getCellVertex(i, Cell::VERT_C);
+        
+        minX = std::min(minX, std::min(a.x, std::min(b.x, c.x)));
+        maxX = std::max(maxX, std::max(a.x, std::max(b.x, c.x)));
+        minZ = std::min(minZ, std::min(a.z, std::min(b.z, c.z)));
+        maxZ = std::max(maxZ, std::max(a.z, std::max(b.z, c.z)));
+    }
+    
+    _gridStart.clear();
+    _gridCells.clear();
+    _gridWidth = 0;
+    _gridHeight = 0;
+    
+    if (_cellNumber == 0)
+        return;
+    
+    // Aproximadamente una casilla por celda
+    _gridMinX = minX;
+    _gridMinZ = minZ;
+    _gridSize = std::max(std::max(maxX - minX, maxZ - minZ) / Ogre::Math::Sqrt(_cellNumber), 0.01f);
+    _gridWidth = (int)((maxX - minX) / _gridSize) + 1;
+    _gridHeight = (int)((maxZ - minZ) / _gridSize) + 1;
+    
+    // Dos pasadas: contar y repartir las celdas según su caja en XZ
+    std::vector<int> count(_gridWidth * _gridHeight + 1, 0);
+    
+    for (int pass = 0; pass < 2; ++pass) {
+        for (int i = 0; i < _cellNumber; ++i) {
+            const Ogre::Vector3& a = getCellVertex(i, Cell::VERT_A);
+            const Ogre::Vector3& b = getCellVertex(i, Cell::VERT_B);
+            const Ogre::Vector3& c = getCellVertex(i, Cell::VERT_C);
+            
+            int x0 = (int)((std::min(a.x, std::min(b.x, c.x)) - _gridMinX) / _gridSize);
+            int x1 = (int)((std::max(a.x, std::max(b.x, c.x)) - _gridMinX) / _gridSize);
+            int z0 = (int)((std::min(a.z, std::min(b.z, c.z)) - _gridMinZ) / _gridSize);
+            int z1 = (int)((std::max(a.z, std::max(b.z, c.z)) - _gridMinZ) / _gridSize);
+            
+            for (int z = z0; z <= z1; ++z) {
+                for (int x = x0; x <= x1; ++x) {
+                    int index = z * _gridWidth + x;
+                    
+                    if (pass == 0)
+                        ++count[index + 1];
+                    else
+                        _gridCells[count[index]++] = i;
+                }
             }
         }
+        
+        if (pass == 0) {
+            for (size_t i = 1; i < count.size(); ++i)
+                count[i] += count[i - 1];
+            
+            _gridStart = count;
+            _gridCells.resize(count.back());
+        }
     }
 }
+
+int NavigationMesh::getGridIndex(Ogre::Real x, Ogre::Real z) const {
+    int gridX = (int)Ogre::Math::Floor((x - _gridMinX) / _gridSize);
+    int gridZ = (int)Ogre::Math::Floor((z - _gridMinZ) / _gridSize);
+    
+    if (gridX < 0 || gridX >= _gridWidth || gridZ < 0 || gridZ >= _gridHeight)
+        return -1;
+    
+    return gridZ * _gridWidth + gridX;
+}
         
 Cell* NavigationMesh::getCell(int index) {
     if (index < 0 || index >= _cellNumber) {
@@ -173,11 +389,206 @@ int NavigationMesh::getCellNumber() {
     return _cellNumber;
 }
 
-Ogre::Vector3 CatmullRollSpline(const Ogre::Vector3& p0,
-				const Ogre::Vector3& p1,
-				const Ogre::Vector3& p2,
-				const Ogre::Vector3& p3,
-				Ogre::Real t ) {
+Ogre::Real NavigationMesh::getTraversalCost(const Cell* from, const Cell* to) const {
+    return getTraversalCost(from->getId(), to->getId());
+}
+
+Ogre::Real NavigationMesh::getTraversalCost(int from, int to) const {
+    Ogre::Vector3 pointA, pointB;
+    
+    if (!getPortal(from, to, pointA, pointB))
+        return Ogre::Math::POS_INFINITY;
+    
+    // Cada mitad del recorrido se pondera con el coste de su celda
+    Ogre::Vector3 middle = (pointA + pointB) * 0.5f;
+    
+    return _centers[from].distance(middle) * _cellCosts[from] +
+           middle.distance(_centers[to]) * _cellCosts[to];
+}
+
+bool NavigationMesh::getPortal(int cell, int neighbour, Ogre::Vector3& pointA, Ogre::Vector3& pointB) const {
+    int side = getLinkSide(cell, neighbour);
+    
+    // No son vecinas
+    if (side == -1)
+        return false;
+    
+    pointA = getCellVertex(cell, side);
+    pointB = getCellVertex(cell, (side + 1) % 3);
+    
+    return true;
+}
+
+Ogre::Real NavigationMesh::getMinCost() const {
+    return _minCost;
+}
+
+void NavigationMesh::setDynamicCost(Cell* cell, Ogre::Real cost) {
+    boost::mutex::scoped_lock lock(_dynamicMutex);
+    
+    // Las heurísticas suponen que las marcas nunca abaratan una celda
+    cost = std::max(cost, 1.0f);
+    
+    Ogre::Real& current = _dynamicCost[cell->getId()];
+    
+    if (current == cost)
+        return;
+    
+    if (current == 1.0f)
+        ++_markNumber;
+    else if (cost == 1.0f)
+        --_markNumber;
+    
+    current = cost;
+    
+    ++_dynamicRevision;
+    touchCell(cell);
+}
+
+Ogre::Real NavigationMesh::getDynamicCost(const Cell* cell) const {
+    return _dynamicCost[cell->getId()];
+}
+
+void NavigationMesh::setCellBlocked(Cell* cell, bool blocked) {
+    setDynamicCost(cell, blocked? Ogre::Math::POS_INFINITY : 1.0f);
+}
+
+void NavigationMesh::setPortalBlocked(Cell* cellA, Cell* cellB, bool blocked) {
+    boost::mutex::scoped_lock lock(_dynamicMutex);
+    
+    int sideA = getLinkSide(cellA->getId(), cellB->getId());
+    int sideB = getLinkSide(cellB->getId(), cellA->getId());
+    
+    // Marcamos el lado común en las dos celdas
+    if (sideA == -1 || sideB == -1 || _portalBlocked[cellA->getId() * 3 + sideA] == blocked)
+        return;
+    
+    _portalBlocked[cellA->getId() * 3 + sideA] = blocked;
+    _portalBlocked[cellB->getId() * 3 + sideB] = blocked;
+    
+    _markNumber += blocked? 1 : -1;
+    
+    ++_dynamicRevision;
+    touchCell(cellA);
+    touchCell(cellB);
+}
+
+bool NavigationMesh::isPortalBlocked(const Cell* cellA, const Cell* cellB) const {
+    int side = getLinkSide(cellA->getId(), cellB->getId());
+    
+    return side != -1 && _portalBlocked[cellA->getId() * 3 + side];
+}
+
+int NavigationMesh::getDynamicRevision() const {
+    return _dynamicRevision;
+}
+
+bool NavigationMesh::isCorridorAffected(const CellPath& cellPath, int revision) const {
+    // Caso habitual: nada ha cambiado desde la búsqueda
+    if (revision == _dynamicRevision)
+        return false;
+    
+    for (CellPath::const_iterator i = cellPath.begin(); i != cellPath.end(); ++i)
+        if (_cellRevision[(*i)->getId()] > revision)
+            return true;
+    
+    return false;
+}
+
+void NavigationMesh::touchCell(Cell* cell) {
+    _cellRevision[cell->getId()] = _dynamicRevision;
+}
+
+bool NavigationMesh::isCorridorMarked(const CellPath& cellPath) const {
+    // La celda de inicio no cuenta: el personaje ya está dentro
+    for (CellPath::const_iterator i = cellPath.begin() + 1; i < cellPath.end(); ++i) {
+        if (_dynamicCost[(*i)->getId()] != 1.0f || isPortalBlocked(*(i - 1), *i))
+            return true;
+    }
+    
+    return false;
+}
+
+bool NavigationMesh::searchDynamicCorridor(CellPath& cellPath, Cell* startCell, Cell* endCell) {
+    typedef std::pair<Ogre::Real, int> OpenNode;
+    std::priority_queue<OpenNode, std::vector<OpenNode>, std::greater<OpenNode> > open;
+    
+    int startId = startCell->getId();
+    int endId = endCell->getId();
+    int stamp = ++_searchRun;
+    
+    _searchStamp[startId] = stamp;
+    _searchCost[startId] = 0.0f;
+    _searchParent[startId] = -1;
+    open.push(OpenNode(0.0f, startId));
+    
+    // A* con los costes dinámicos. Las distancias estáticas (Floyd) son una
+    // cota inferior exacta sin marcas; con clusters usamos la euclídea
+    while (!open.empty()) {
+        OpenNode node = open.top();
+        open.pop();
+        
+        int current = node.second;
+        
+        if (current == endId)
+            break;
+        
+        for (int i = 0; i < 3; ++i) {
+            int next = _cellLinks[current * 3 + i];
+            
+            if (next == -1 || _portalBlocked[current * 3 + i])
+                continue;
+            
+            Ogre::Real penalty = _dynamicCost[next];
+            
+            if (penalty == Ogre::Math::POS_INFINITY)
+                continue;
+            
+            Ogre::Real cost = _searchCost[current] + getTraversalCost(current, next) * penalty;
+            
+            if (_searchStamp[next] == stamp && cost >= _searchCost[next])
+                continue;
+            
+            Ogre::Real heuristic = _graph? _graph[next * _cellNumber + endId] :
+                                           _centers[endId].distance(_centers[next]) * _minCost;
+            
+            if (heuristic == Ogre::Math::POS_INFINITY)
+                continue;
+            
+            _searchStamp[next] = stamp;
+            _searchCost[next] = cost;
+            _searchParent[next] = current;
+            open.push(OpenNode(cost + heuristic, next));
+        }
+    }
+    
+    if (_searchStamp[endId] != stamp)
+        return false;
+    
+    // Reconstruimos el pasillo desde el final
+    cellPath.clear();
+    
+    for (int i = endId; i != -1; i = _searchParent[i])
+        cellPath.push_back(_cells[i]);
+    
+    std::reverse(cellPath.begin(), cellPath.end());
+    
+    return true;
+}
+
+const NavigationMesh::BuildStats& NavigationMesh::getBuildStats() const {
+    return _buildStats;
+}
+
+ClusterGraph* NavigationMesh::getClusterGraph() {
+    return _clusterGraph;
+}
+
+static Ogre::Vector3 CatmullRollSpline(const Ogre::Vector3& p0,
+				       const Ogre::Vector3& p1,
+				       const Ogre::Vector3& p2,
+				       const Ogre::Vector3& p3,
+				       Ogre::Real t ) {
 	/* Un Spline de Catmull-Roll es un Spline Cúbico por interpolación de Hermite en el cual se calculan las tangentes mediante:
 	 *
 	 * mk = (p1 - p0) / (t0 - t1)
@@ -201,132 +612,214 @@ Ogre::Vector3 CatmullRollSpline(const Ogre::Vector3& p0,
 	            + (2 * p0 - 5 * p1 + 4 * p2 - 1 * p3) * t2 
 		    + (-1 * p0 + 3 * p1 - 3 * p2 + 1 * p3) * t3);
 
-	//cout << "Generando: " << v << " a partir de: " << p1 << " con t: " << t << endl;
-
 	return v;
 }
 
-// Devuelve el n de celdas borradas.
-int NavigationMesh::simplifyPath(CellPath& cellPath) {
-	// Cribar todas las celdas a las que haya visión directa, evitando pasar por centros innecesarios.
-	// Lo ideal seria encontrar una linea recta en terreno seguro entre la posicion inicial y final.
-	// De manera que intentaremos unir la celda más cercana con la celda más lejana posible.
-	// En caso de poder unir alguna de estas celdas mediante una línea recta, borraremos las intermedias.
-
-	// Terminará cuando alcancemos la última celda.
-	CellPath::iterator beginIt = cellPath.begin(),
-		endIt;
-	size_t sz = cellPath.size();
-	
-	//cout << "Eliminando celdas" << endl;
-
-	while( (endIt = getFurthestVisibleCell(cellPath, beginIt)) != cellPath.end() ) {
-		
-		//cout << "Comprueba siguiente celda" << endl;
-		
-		// Eliminar las celdas de enmedio, que no sirven.
-		++beginIt;
-
-		sz = cellPath.size(); // DEBUG
-
-		if( beginIt != cellPath.end() )
-			beginIt = cellPath.erase(beginIt, endIt);
+// Doble del área con signo del triángulo abc proyectado en el plano XZ
+static inline Ogre::Real triArea2(const Ogre::Vector3& a,
+                                  const Ogre::Vector3& b,
+                                  const Ogre::Vector3& c) {
+    Ogre::Real abx = b.x - a.x;
+    Ogre::Real abz = b.z - a.z;
+    Ogre::Real acx = c.x - a.x;
+    Ogre::Real acz = c.z - a.z;
+    
+    return acx * abz - abx * acz;
+}
 
-		// DEBUG info
-		//if( cellPath.size() < sz ) 
-		//	cout << "Borradas " << sz - cellPath.size() << " celdas." << endl;
-	}
+// Compara dos puntos en el plano XZ
+static inline bool equalXZ(const Ogre::Vector3& a, const Ogre::Vector3& b) {
+    Ogre::Real dx = a.x - b.x;
+    Ogre::Real dz = a.z - b.z;
+    
+    return dx * dx + dz * dz < 0.000001f;
+}
 
-	return sz - cellPath.size();
+Ogre::Vector3 NavigationMesh::getSplinePoint(const PointPath& path,
+                                             PointPath::const_iterator segment,
+                                             Ogre::Real t) {
+    // Puntos del tramo p1 - p2
+    PointPath::const_iterator it = segment;
+    Ogre::Vector3 p1 = *it;
+    
+    ++it;
+    if (it == path.end())
+        return p1;
+    
+    Ogre::Vector3 p2 = *it;
+    
+    // Punto de control posterior, si no existe lo prolongamos en la
+    // dirección del último tramo
+    Ogre::Vector3 p3;
+    ++it;
+    
+    if (it != path.end())
+        p3 = *it;
+    else
+        p3 = p2 + (p2 - p1).normalisedCopy() * 0.5;
+    
+    // Punto de control anterior, igual que el posterior
+    Ogre::Vector3 p0;
+    
+    if (segment != path.begin()) {
+        it = segment;
+        --it;
+        p0 = *it;
+    }
+    else
+        p0 = p1 - (p2 - p1).normalisedCopy() * 0.5;
+    
+    return CatmullRollSpline(p0, p1, p2, p3, t);
 }
 
 // Toma una ruta de puntos y genera puntos extra entre ellos creando un spline.
 //
 // Devuelve verdadero si se pudo hacer el spline.
-bool NavigationMesh::makeSpline(PointPath& path) {
-
-	/* Crear spline añadiendo puntos nuevos entre cada nodo.
-	 * Emplearemos un Spline de Hermite cúbico
-	 * Generamos n-2 puntos entre cada nodo.
-	 * Necesitaremos al menos 4 puntos (2 reales).
-	 * Generaremos puntos entre p1 y p2 empleando p0 y p3 como control.
-	 * El primer y último segmento no tendrán puntos intermedios.
-	 */ 
-	if( path.size() < 2 )
-		return false;
-
-	// Añadimos al path dos puntos de control falsos. Uno al principio y otro al final.
-	// Esto lo hacemos para poder interpolar el primer y último segmento, aunque sea recto.
-	// Estos puntos de control estarán en la misma línea que los segmentos inicial y final.
-	PointPath::iterator p0, p1, p2, p3;
-
-	// Punto extra inicial
-	// Lo calculamos retrocediendo 0.5 en la dirección del segmento.
-	p0 = p1 = path.begin();
-	++p1;
-	Ogre::Vector3 pextra = *p0 - ((*p1 - *p0).normalise() * 0.5);
-	path.push_front(pextra);
-
-	// Punto extra final
-	p0 = p1 = path.end();
-	--p1;
-	--p0;
-	--p0;
-	pextra = *p1 + ((*p1 - *p0).normalise() * 0.5);
-	path.push_back(pextra);
-
-	// Puntos de la ruta por 'metro'
-	int dotsPerUnit = 2;
-
-	// Establecer p0, p1, p2 y p3
-	p0 = path.begin();
-
-	p1 = p0; 
-	++p1;
-
-	p2 = p1; 
-	++p2;
-
-	p3 = p2; 
-	++p3;
-
-
-	while( p3 != path.end() ){
-
-		// El n de puntos a calcular debe ser proporcional a la distancia que se recorre.
-		// Calculamos la distancia entre p1 y p2 para saber cuantos puntos debemos calcular.
-		// El mantener el n de puntos constante entre distancias diferentes da problemas de velocidad.
-		int n = (*p1 - *p2).length() * dotsPerUnit;
-		Ogre::Real step = 1.0/n;
-		Ogre::Real s = step;
-
-		// Añadimos a la ruta n-2 puntos.
-		for(int i = 1; i < n; ++i) {
-			path.insert(p2, CatmullRollSpline(*p0, *p1, *p2, *p3, s));
-			s += step;
-		}
-
-		p0 = p1;
-		p1 = p2;
-		++p2;
-		++p3;
-
-		//cout << endl;
-	}
-
-	// Eliminar los puntos extra en los extremos, que se han usado para el
-	// cálculo pero que no forman parte de la ruta.
-	path.pop_front();
-	path.pop_back();
+bool NavigationMesh::smoothPath(PointPath& path, int pointsPerUnit) {
+    if (path.size() < 2)
+        return false;
+    
+    PointPath smoothed;
+    
+    for (PointPath::const_iterator i = path.begin(); i != path.end(); ++i) {
+        smoothed.push_back(*i);
+        
+        PointPath::const_iterator next = i;
+        ++next;
+        
+        if (next == path.end())
+            break;
+        
+        // El número de puntos es proporcional a la longitud del tramo
+        // para mantener la velocidad constante
+        int n = (*next - *i).length() * pointsPerUnit;
+        Ogre::Real step = 1.0 / n;
+        
+        for (int j = 1; j < n; ++j)
+            smoothed.push_back(getSplinePoint(path, i, j * step));
+    }
+    
+    path.swap(smoothed);
+    
+    return true;
+}
 
-	return true;
+void NavigationMesh::stringPull(const CellPath& cellPath,
+                                const Ogre::Vector3& startPos,
+                                const Ogre::Vector3& endPos,
+                                PointPath& path) {
+    // Portales del pasillo: el primero y el último son degenerados
+    // (el punto de comienzo y el de destino). Como el pasillo, caben en la
+    // pila salvo en pasillos muy largos; se llama cada frame por enemigo y
+    // desde el hilo de PathPlanner, así que no pueden ser miembros
+    SmallVector<Ogre::Vector3, 34> lefts;
+    SmallVector<Ogre::Vector3, 34> rights;
+    
+    lefts.push_back(startPos);
+    rights.push_back(startPos);
+    
+    Ogre::Vector3 pointA, pointB;
+    
+    for (CellPath::const_iterator it = cellPath.begin(); it != cellPath.end(); ++it) {
+        CellPath::const_iterator nextIt = it;
+        ++nextIt;
+        
+        if (nextIt == cellPath.end() || !getPortal((*it)->getId(), (*nextIt)->getId(), pointA, pointB))
+            continue;
+        
+        // Orientamos el portal según el sentido de avance: el centro de la
+        // celda de origen queda detrás de él
+        if (triArea2(_centers[(*it)->getId()], pointA, pointB) > 0.0f) {
+            lefts.push_back(pointA);
+            rights.push_back(pointB);
+        }
+        else {
+            lefts.push_back(pointB);
+            rights.push_back(pointA);
+        }
+    }
+    
+    lefts.push_back(endPos);
+    rights.push_back(endPos);
+    
+    // Algoritmo del embudo
+    int portalCount = lefts.size();
+    Ogre::Vector3 apex = startPos;
+    Ogre::Vector3 left = lefts[0];
+    Ogre::Vector3 right = rights[0];
+    int apexIndex = 0;
+    int leftIndex = 0;
+    int rightIndex = 0;
+    
+    path.push_back(apex);
+    
+    for (int i = 1; i < portalCount; ++i) {
+        const Ogre::Vector3& newLeft = lefts[i];
+        const Ogre::Vector3& newRight = rights[i];
+        
+        // Intentamos estrechar el lado derecho del embudo
+        if (triArea2(apex, right, newRight) <= 0.0f) {
+            if (equalXZ(apex, right) || triArea2(apex, left, newRight) > 0.0f) {
+                right = newRight;
+                rightIndex = i;
+            }
+            else {
+                // El lado derecho cruza el izquierdo: el izquierdo es un
+                // nuevo vértice del camino y reiniciamos el embudo en él
+                apex = left;
+                apexIndex = leftIndex;
+                
+                // Portales consecutivos pueden compartir vértice
+                if (!equalXZ(path.back(), apex))
+                    path.push_back(apex);
+                
+                left = apex;
+                right = apex;
+                leftIndex = apexIndex;
+                rightIndex = apexIndex;
+                i = apexIndex;
+                continue;
+            }
+        }
+        
+        // Intentamos estrechar el lado izquierdo del embudo
+        if (triArea2(apex, left, newLeft) >= 0.0f) {
+            if (equalXZ(apex, left) || triArea2(apex, right, newLeft) < 0.0f) {
+                left = newLeft;
+                leftIndex = i;
+            }
+            else {
+                // El lado izquierdo cruza el derecho
+                apex = right;
+                apexIndex = rightIndex;
+                
+                if (!equalXZ(path.back(), apex))
+                    path.push_back(apex);
+                
+                left = apex;
+                right = apex;
+                leftIndex = apexIndex;
+                rightIndex = apexIndex;
+                i = apexIndex;
+                continue;
+            }
+        }
+    }
+    
+    // El último punto es el punto exacto a donde hay que ir
+    if (!equalXZ(path.back(), endPos))
+        path.push_back(endPos);
+    else
+        path.back() = endPos;
 }
 
 bool NavigationMesh::buildPath(PointPath& path,
                                const Ogre::Vector3& startPos,
                                const Ogre::Vector3& endPos,
                                Cell* startCell,
-                               Cell* endCell) {
+                               Cell* endCell,
+                               bool* partial) {
+    PROFILE_ZONE("NavigationMesh::buildPath");
     
     // Si no hemos proporcionado celdas las buscamos
     if (!startCell)
@@ -336,73 +829,221 @@ bool NavigationMesh::buildPath(PointPath& path,
 	endCell = findCell(endPos);
 
     // Si alguna pos no pertenece a la malla
-    if (!startCell || !endCell) {
-	cout << "Celdas no pertenecen a la rejilla" << endl;
-	return false;
-    }
-
-    // Comprobamos que existe camino
-    int startId = startCell->getId();
-    int endId = endCell->getId();
-    
-    if (_graph[startId * _cellNumber + endId] == Ogre::Math::POS_INFINITY) {
-	cout << "No se ha encontrado camino" << endl;
+    if (!startCell || !endCell)
 	return false;
-    }
 
-    
-    // Camino de celdas
+    // Pasillo de celdas desde la celda de inicio hasta la de destino
     CellPath cellPath;
+    bool partialPath;
     
-    // Reconstruir camino de celdas
-    recoverPath(startId, endId, cellPath);
+    if (!findCorridor(cellPath, startCell, endCell, &partialPath))
+        return false;
     
-    // Simplificar la ruta eliminando celdas innecesarias.
-    //simplifyPath(cellPath);
+    if (partial)
+        *partial = partialPath;
     
     // Limpiamos el camino anterior
     path.clear();
 
-    // Obtener los puntos del camino, que es finalmente lo que vamos a usar.
-    /*std::for_each(cellPath.begin(), 
-	cellPath.end(), 
-	boost::bind(&PointPath::push_back, 
-	     path, 
-	     boost::bind(&Cell::getCenter, _1)
-	    )
-	);*/
-	
-    for(CellPath::iterator i = cellPath.begin(); i != cellPath.end(); ++i)
-	path.push_back((*i)->getCenter());
+    // Camino más corto dentro del pasillo. Si es parcial termina en el
+    // centro de la última celda refinada
+    stringPull(cellPath, startPos, partialPath? cellPath.back()->getCenter() : endPos, path);
+
+    // Hemos encontrado el camino
+    return true;
+}
 
-    // El primer punto es el punto actual del personaje.
-    path.push_front(startPos);
+bool NavigationMesh::findCorridor(CellPath& cellPath,
+                                  Cell* startCell,
+                                  Cell* endCell,
+                                  bool* partial) {
+    boost::mutex::scoped_lock lock(_dynamicMutex);
+    
+    // Las marcas sólo encarecen caminos: si no hay camino estático no hay
+    // camino, y si el estático no atraviesa marcas sigue siendo el mejor
+    if (!findStaticCorridor(cellPath, startCell, endCell, partial))
+        return false;
+    
+    if (_markNumber == 0 || !isCorridorMarked(cellPath))
+        return true;
+    
+    if (partial)
+        *partial = false;
+    
+    return searchDynamicCorridor(cellPath, startCell, endCell);
+}
 
-    // El último punto es el punto exacto a donde hay que ir.
-    path.push_back(endPos);
+void NavigationMesh::findCorridors(std::vector<CellPath>& cellPaths,
+                                   const std::vector<Cell*>& startCells,
+                                   Cell* endCell) {
+    boost::mutex::scoped_lock lock(_dynamicMutex);
+    
+    int startNumber = startCells.size();
+    cellPaths.resize(startNumber);
+    
+    if (!_clusterGraph && _markNumber == 0) {
+        for (int i = 0; i < startNumber; ++i) {
+            if (!startCells[i] || !findStaticCorridor(cellPaths[i], startCells[i], endCell, 0))
+                cellPaths[i].clear();
+        }
+        
+        return;
+    }
+    
+    searchFromGoal(startCells, endCell);
+    
+    // Cada celda apunta a la siguiente hacia el destino, así que el pasillo
+    // sale ya en orden
+    for (int i = 0; i < startNumber; ++i) {
+        CellPath& cellPath = cellPaths[i];
+        cellPath.clear();
+        
+        if (!startCells[i] || _searchStamp[startCells[i]->getId()] != _searchRun)
+            continue;
+        
+        for (int j = startCells[i]->getId(); j != -1; j = _searchParent[j])
+            cellPath.push_back(_cells[j]);
+    }
+}
 
-    makeSpline(path);
+void NavigationMesh::searchFromGoal(const std::vector<Cell*>& startCells, Cell* endCell) {
+    typedef std::pair<Ogre::Real, int> OpenNode;
+    std::priority_queue<OpenNode, std::vector<OpenNode>, std::greater<OpenNode> > open;
+    
+    int endId = endCell->getId();
+    int stamp = ++_searchRun;
+    int remaining = 0;
+    
+    // Celdas de inicio distintas que quedan por alcanzar
+    for (std::vector<Cell*>::const_iterator i = startCells.begin(); i != startCells.end(); ++i) {
+        if (*i && _searchTarget[(*i)->getId()] != stamp) {
+            _searchTarget[(*i)->getId()] = stamp;
+            ++remaining;
+        }
+    }
+    
+    _searchStamp[endId] = stamp;
+    _searchCost[endId] = 0.0f;
+    _searchParent[endId] = -1;
+    open.push(OpenNode(0.0f, endId));
+    
+    // Como buildFlowField, pero con las marcas de searchDynamicCorridor: el
+    // coste de un paso es el de entrar en la celda más cercana al destino
+    while (!open.empty() && remaining > 0) {
+        OpenNode node = open.top();
+        open.pop();
+        
+        int current = node.second;
+        
+        if (node.first > _searchCost[current])
+            continue;
+        
+        if (_searchTarget[current] == stamp)
+            --remaining;
+        
+        Ogre::Real penalty = _dynamicCost[current];
+        
+        if (penalty == Ogre::Math::POS_INFINITY)
+            continue;
+        
+        for (int i = 0; i < 3; ++i) {
+            int next = _cellLinks[current * 3 + i];
+            
+            if (next == -1 || _portalBlocked[current * 3 + i])
+                continue;
+            
+            Ogre::Real cost = _searchCost[current] + getTraversalCost(next, current) * penalty;
+            
+            if (_searchStamp[next] == stamp && cost >= _searchCost[next])
+                continue;
+            
+            _searchStamp[next] = stamp;
+            _searchCost[next] = cost;
+            _searchParent[next] = current;
+            open.push(OpenNode(cost, next));
+        }
+    }
+}
 
-    // Hemos encontrado el camino
+bool NavigationMesh::findStaticCorridor(CellPath& cellPath,
+                                        Cell* startCell,
+                                        Cell* endCell,
+                                        bool* partial) {
+    cellPath.clear();
+    
+    if (partial)
+        *partial = false;
+    
+    if (_clusterGraph) {
+        ClusterGraph::Result result = _clusterGraph->findPath(startCell, endCell, cellPath);
+        
+        if (result == ClusterGraph::NO_PATH)
+            return false;
+        
+        if (partial)
+            *partial = (result == ClusterGraph::PARTIAL_PATH);
+        
+        return true;
+    }
+    
+    // Comprobamos que existe camino
+    int startId = startCell->getId();
+    int endId = endCell->getId();
+    
+    if (_graph[startId * _cellNumber + endId] == Ogre::Math::POS_INFINITY)
+        return false;
+    
+    cellPath.push_back(startCell);
+    
+    recoverPath(startId, endId, cellPath);
+    
+    if (endCell != startCell)
+        cellPath.push_back(endCell);
+    
     return true;
 }
         
 Cell* NavigationMesh::findCell(const Ogre::Vector3& pos) {
+    int index = getGridIndex(pos.x, pos.z);
+    
+    // Celdas de la casilla del índice espacial
+    if (index != -1) {
+        Cell* bestCell = 0;
+        Ogre::Real bestDistance = Ogre::Math::POS_INFINITY;
+        
+        for (int i = _gridStart[index]; i < _gridStart[index + 1]; ++i) {
+            int id = _gridCells[i];
+            
+            if (!cellContains(id, pos))
+                continue;
+            
+            Ogre::Real distance = Ogre::Math::Abs(getCellHeight(id, pos) - pos.y);
+            
+            if (distance < bestDistance) {
+                bestDistance = distance;
+                bestCell = _cells[id];
+            }
+        }
+        
+        if (bestCell)
+            return bestCell;
+    }
+    
     Ogre::Vector3 v;
     Ogre::Vector3 minDistance = Ogre::Vector3(500.0, 500.0, 500.0);
     Cell* closestCell = 0;
     
     // Recorremos las celdas buscando una que contenga al punto deseado
     // En caso de no encontrar, devolvemos la más cercana
-    for (Cells::iterator i = _cells.begin(); i != _cells.end(); ++i) {
-        if ((*i)->containsPoint(pos)) {
-            return *i;
+    for (int i = 0; i < _cellNumber; ++i) {
+        if (cellContains(i, pos)) {
+            return _cells[i];
         }
 	
-	v = (*i)->getCenter() - pos;
+	v = _centers[i] - pos;
 	if (v.squaredLength() < minDistance.squaredLength()) {
 	    minDistance = v;
-	    closestCell = (*i);
+	    closestCell = _cells[i];
 	}
     }
     
@@ -411,77 +1052,358 @@ Cell* NavigationMesh::findCell(const Ogre::Vector3& pos) {
     return closestCell;
 }
 
-bool NavigationMesh::lineOfSightTest(const Ogre::Vector3& start,
-                                     const Ogre::Vector3& end,
-                                     Cell* startCell,
-                                     Cell* endCell) {
+Cell* NavigationMesh::findCell(const Ogre::Vector3& pos, Cell* hint) {
+    if (hint) {
+        int id = hint->getId();
+        
+        if (cellContains(id, pos))
+            return hint;
+        
+        // Lo normal es pasar a una celda vecina
+        for (int i = 0; i < 3; ++i) {
+            int link = _cellLinks[id * 3 + i];
+            
+            if (link != -1 && cellContains(link, pos))
+                return _cells[link];
+        }
+    }
+    
+    return findCell(pos);
+}
+
+void NavigationMesh::findCells(const Ogre::Vector3& center, Ogre::Real radius, CellPath& cells) {
+    cells.clear();
     
-    Cell* nextCell = startCell;
-    Cell::PathResult result = Cell::EXITING_CELL;
-    Line2D line2D(Ogre::Vector2(start.x, start.z),
-                  Ogre::Vector2(end.x, end.z));
-    Cell::CellSide side;
-    Ogre::Vector2 intersection;
+    Cell* first = findCell(center);
     
-    while (result == Cell::EXITING_CELL) {
-        
-        result = nextCell->classifyPathToCell(line2D, &nextCell, side, intersection);
+    if (!first)
+        return;
+    
+    // Recorrido en anchura por los vecinos: el propio resultado hace de cola
+    cells.push_back(first);
+    Ogre::Real radiusSq = radius * radius;
+    
+    for (int i = 0; i < (int)cells.size(); ++i) {
+        int id = cells[i]->getId();
         
-        if (!nextCell) {
-            return false;
+        for (int j = 0; j < 3; ++j) {
+            int link = _cellLinks[id * 3 + j];
+            
+            if (link == -1 || std::find(cells.begin(), cells.end(), _cells[link]) != cells.end())
+                continue;
+            
+            // La zona entra en la vecina si el círculo corta el lado común
+            const Ogre::Vector3& a = getCellVertex(id, j);
+            const Ogre::Vector3& b = getCellVertex(id, (j + 1) % 3);
+            Ogre::Real edgeX = b.x - a.x;
+            Ogre::Real edgeZ = b.z - a.z;
+            Ogre::Real t = ((center.x - a.x) * edgeX + (center.z - a.z) * edgeZ) /
+                           (edgeX * edgeX + edgeZ * edgeZ);
+            t = std::min(std::max(t, 0.0f), 1.0f);
+            
+            Ogre::Real dx = a.x + edgeX * t - center.x;
+            Ogre::Real dz = a.z + edgeZ * t - center.z;
+            
+            if (dx * dx + dz * dz <= radiusSq)
+                cells.push_back(_cells[link]);
         }
     }
+}
+
+Ogre::Real NavigationMesh::sampleHeight(const Ogre::Vector3& pos, Cell* hintCell) {
+    Cell* cell = findCell(pos, hintCell);
+    
+    if (!cell)
+        return pos.y;
+    
+    int id = cell->getId();
     
-    return (result == Cell::ENDING_CELL);
+    return _heightA[id] * pos.x + _heightB[id] * pos.z + _heightC[id];
 }
 
-NavigationMesh::CellPath::iterator NavigationMesh::getFurthestVisibleCell(CellPath& path, CellPath::iterator startIt) {
+void NavigationMesh::updateFlowField(const Ogre::Vector3& targetPos) {
+    Cell* targetCell = findCell(targetPos, _flowTargetCell);
     
-    // Si el punto de comienzo es inválido devolvemos end
-    if (startIt == path.end())
-        return startIt;
+    _flowTargetPos = targetPos;
     
-    // con cellIt iteramos por las celdas
-    CellPath::iterator cellIt = startIt;
-    ++cellIt;
+    // Sólo recalculamos si el objetivo cambia de celda o cambian las marcas
+    if (targetCell == _flowTargetCell && _flowRevision == _dynamicRevision)
+        return;
     
-    // lastIt es la última celda válida con línea de visión
-    CellPath::iterator lastIt = cellIt;
+    _flowTargetCell = targetCell;
+    _flowRevision = _dynamicRevision;
+    buildFlowField();
+}
+
+Cell* NavigationMesh::getFlowTargetCell() {
+    return _flowTargetCell;
+}
+
+bool NavigationMesh::getFlowTarget(Cell* cell, const Ogre::Vector3& position, Ogre::Vector3& target) {
+    if (!cell || !_flowTargetCell)
+        return false;
     
-    if (lastIt == path.end())
-	return lastIt;
-	
-    for (; cellIt != path.end(); ++cellIt) {
-	if (lineOfSightTest((*startIt)->getCenter(), (*cellIt)->getCenter(), *startIt, *cellIt))
-	    lastIt = cellIt;
-	else
-	    return lastIt;
+    if (cell == _flowTargetCell) {
+        target = _flowTargetPos;
+        return true;
     }
     
-    return lastIt;
+    if (_flowNext[cell->getId()] == -1)
+        return false;
+    
+    // Seguimos el campo unas pocas celdas y aplicamos el embudo sobre ese
+    // pasillo corto: el primer vértice es la dirección a tomar
+    CellPath cellPath;
+    cellPath.push_back(cell);
+    
+    for (int i = 0; i < FLOW_LOOKAHEAD && cellPath.back() != _flowTargetCell; ++i)
+        cellPath.push_back(_cells[_flowNext[cellPath.back()->getId()]]);
+    
+    const Ogre::Vector3& end = (cellPath.back() == _flowTargetCell)? _flowTargetPos : cellPath.back()->getCenter();
+    
+    PointPath path;
+    stringPull(cellPath, position, end, path);
+    
+    target = (path.size() > 1)? path[1] : end;
+    
+    return true;
+}
+
+void NavigationMesh::buildFlowField() {
+    typedef std::pair<Ogre::Real, int> OpenNode;
+    std::priority_queue<OpenNode, std::vector<OpenNode>, std::greater<OpenNode> > open;
+    
+    _flowNext.assign(_cellNumber, -1);
+    _flowCost.assign(_cellNumber, Ogre::Math::POS_INFINITY);
+    
+    if (!_flowTargetCell)
+        return;
+    
+    // Dijkstra desde la celda objetivo sobre la adyacencia de celdas: cada
+    // celda apunta a la vecina por la que llegó el camino más corto
+    int targetId = _flowTargetCell->getId();
+    _flowCost[targetId] = 0.0f;
+    open.push(OpenNode(0.0f, targetId));
+    
+    while (!open.empty()) {
+        OpenNode node = open.top();
+        open.pop();
+        
+        int current = node.second;
+        
+        if (node.first > _flowCost[current])
+            continue;
+        
+        for (int i = 0; i < 3; ++i) {
+            int next = _cellLinks[current * 3 + i];
+            
+            if (next == -1 || _portalBlocked[current * 3 + i])
+                continue;
+            
+            Ogre::Real cost = _flowCost[current] + getTraversalCost(next, current) * _dynamicCost[current];
+            
+            if (cost < _flowCost[next]) {
+                _flowCost[next] = cost;
+                _flowNext[next] = current;
+                open.push(OpenNode(cost, next));
+            }
+        }
+    }
+}
+
+bool NavigationMesh::lineOfSightTest(const Ogre::Vector3& start,
+                                     const Ogre::Vector3& end,
+                                     Cell* startCell,
+                                     Cell* endCell) {
+    // Las celdas son convexas
+    if (startCell == endCell)
+        return true;
     
-    /*CellPath::iterator cellIt = path.end();
-    --cellIt;
+    LineOfSightEntry& entry = getLineOfSightEntry(start, end, startCell);
     
-    // Si startIt era la última celda devolvemos end
-    if (cellIt == startIt) {
-        return path.end();
+    if (entry.frame != _frame) {
+        Ogre::Vector3 startOffsets[3];
+        for (int i = 0; i < 3; ++i)
+            startOffsets[i] = getCellVertex(startCell->getId(), i) - start;
+        
+        entry.start = start;
+        entry.end = end;
+        entry.startCell = startCell;
+        entry.frame = _frame;
+        entry.revision = _dynamicRevision;
+        entry.visible = walkLineOfSight(start, end, startCell, endCell, startOffsets);
     }
     
-    // Recorremos las celdas de la más alejada a la origen.
-    // La primera que encontremos con la que tengamos linea directa, será la
-    // que abarque más y, por tanto, la mejor.
-    for(; cellIt != startIt; --cellIt) {
-        if (lineOfSightTest((*startIt)->getCenter(), (*cellIt)->getCenter(), *startIt, *cellIt))
-		return cellIt;
+    return entry.visible;
+}
+
+void NavigationMesh::lineOfSightTest(const Ogre::Vector3& start,
+                                     Cell* startCell,
+                                     const std::vector<Ogre::Vector3>& ends,
+                                     const std::vector<Cell*>& endCells,
+                                     std::vector<bool>& results) {
+    int targetNumber = ends.size();
+    bool knownCells = (endCells.size() == ends.size());
+    
+    results.resize(targetNumber);
+    
+    // Los vértices de la celda de origen relativos al origen son comunes a
+    // todos los objetivos
+    Ogre::Vector3 startOffsets[3];
+    for (int i = 0; i < 3; ++i)
+        startOffsets[i] = getCellVertex(startCell->getId(), i) - start;
+    
+    for (int i = 0; i < targetNumber; ++i) {
+        Cell* endCell = knownCells? endCells[i] : 0;
+        
+        if (startCell == endCell) {
+            results[i] = true;
+            continue;
+        }
+        
+        LineOfSightEntry& entry = getLineOfSightEntry(start, ends[i], startCell);
+        
+        if (entry.frame != _frame) {
+            entry.start = start;
+            entry.end = ends[i];
+            entry.startCell = startCell;
+            entry.frame = _frame;
+            entry.revision = _dynamicRevision;
+            entry.visible = walkLineOfSight(start, ends[i], startCell, endCell, startOffsets);
+        }
+        
+        results[i] = entry.visible;
     }
+}
 
-    //cout << "No se ha encontrado linea entre dos celdas" << endl;
+void NavigationMesh::newFrame() {
+    ++_frame;
+}
 
-    // No hemos encontrado una linea entre start y otra.
-    return path.end();*/
+NavigationMesh::LineOfSightEntry& NavigationMesh::getLineOfSightEntry(const Ogre::Vector3& start,
+                                                                      const Ogre::Vector3& end,
+                                                                      Cell* startCell) {
+    // FNV-1a sobre las coordenadas XZ de ambos puntos
+    Ogre::Real key[4] = {start.x, start.z, end.x, end.z};
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(key);
+    unsigned int hash = 2166136261u;
+    
+    for (unsigned int i = 0; i < sizeof(key); ++i) {
+        hash ^= bytes[i];
+        hash *= 16777619u;
+    }
+    
+    LineOfSightEntry& entry = _losCache[hash % LOS_CACHE_SIZE];
+    
+    // Si la entrada corresponde a otra consulta, o se calculó antes de
+    // cambiar las marcas dinámicas, la invalidamos
+    if (entry.frame == _frame &&
+        (entry.revision != _dynamicRevision ||
+         entry.startCell != startCell || entry.start != start || entry.end != end))
+        entry.frame = -1;
+    
+    return entry;
 }
 
+bool NavigationMesh::walkLineOfSight(const Ogre::Vector3& start,
+                                     const Ogre::Vector3& end,
+                                     Cell* startCell,
+                                     Cell* endCell,
+                                     const Ogre::Vector3* startOffsets) {
+    // Recorremos las celdas que atraviesa el segmento en el plano XZ. Para
+    // cada vértice basta saber a qué lado del segmento queda: al entrar en
+    // una celda por un lado conocido sólo hay que clasificar el vértice
+    // opuesto para saber por qué lado sale.
+    Ogre::Real dx = end.x - start.x;
+    Ogre::Real dz = end.z - start.z;
+    
+    // 1. Lado por el que el segmento sale de la celda de origen
+    Ogre::Real sides[3];
+    for (int i = 0; i < 3; ++i)
+        sides[i] = dx * startOffsets[i].z - dz * startOffsets[i].x;
+    
+    int leftIndex = -1;
+    int rightIndex = -1;
+    Ogre::Real maxT = -Ogre::Math::POS_INFINITY;
+    
+    for (int i = 0; i < 3; ++i) {
+        int j = (i + 1) % 3;
+        
+        if ((sides[i] >= 0.0f) == (sides[j] >= 0.0f))
+            continue;
+        
+        // Distancia relativa sobre el segmento al cruce con el lado
+        Ogre::Vector3 edge = startOffsets[j] - startOffsets[i];
+        Ogre::Real denominator = dx * edge.z - dz * edge.x;
+        Ogre::Real t = (startOffsets[i].x * edge.z - startOffsets[i].z * edge.x) / denominator;
+        
+        if (t > maxT) {
+            maxT = t;
+            leftIndex = (sides[i] >= 0.0f)? i : j;
+            rightIndex = (sides[i] >= 0.0f)? j : i;
+        }
+    }
+    
+    // El segmento es un punto o termina dentro de la celda de origen
+    if (leftIndex == -1 || maxT >= 1.0f)
+        return true;
+    
+    int cell = startCell->getId();
+    int endId = endCell? endCell->getId() : -1;
+    int leftVertex = _cellVertices[cell * 3 + leftIndex];
+    
+    // 2. Avanzamos de celda en celda (como mucho tantas como haya)
+    for (int steps = 0; steps < _cellNumber; ++steps) {
+        // Cruzamos el lado formado por leftIndex y rightIndex
+        int side = ((leftIndex + 1) % 3 == rightIndex)? leftIndex : rightIndex;
+        int nextCell = _cellLinks[cell * 3 + side];
+        
+        // El segmento sale de la malla o cruza un portal o una celda
+        // bloqueados (puertas, hechizos)
+        if (nextCell == -1 || _portalBlocked[cell * 3 + side] ||
+            _dynamicCost[nextCell] == Ogre::Math::POS_INFINITY)
+            return false;
+        
+        // Al ser convexa, el resto del segmento está dentro de la celda final
+        if (nextCell == endId)
+            return true;
+        
+        // Lado por el que entramos en la nueva celda (precalculado)
+        int entrySide = _cellLinkSides[cell * 3 + side];
+        
+        if (_cellVertices[nextCell * 3 + entrySide] == leftVertex) {
+            leftIndex = entrySide;
+            rightIndex = (entrySide + 1) % 3;
+        }
+        else {
+            leftIndex = (entrySide + 1) % 3;
+            rightIndex = entrySide;
+        }
+        
+        // Clasificamos el vértice opuesto para elegir el lado de salida
+        int oppositeIndex = 3 - leftIndex - rightIndex;
+        const Ogre::Vector3& opposite = getCellVertex(nextCell, oppositeIndex);
+        
+        if (dx * (opposite.z - start.z) - dz * (opposite.x - start.x) >= 0.0f)
+            leftIndex = oppositeIndex;
+        else
+            rightIndex = oppositeIndex;
+        
+        leftVertex = _cellVertices[nextCell * 3 + leftIndex];
+        
+        // Si el final queda del mismo lado que el origen respecto al lado de
+        // salida, el segmento termina en esta celda
+        const Ogre::Vector3& left = _vertices[leftVertex];
+        const Ogre::Vector3& right = getCellVertex(nextCell, rightIndex);
+        
+        if (triArea2(left, right, end) * triArea2(left, right, start) >= 0.0f)
+            return true;
+        
+        cell = nextCell;
+    }
+    
+    return false;
+}
 
 void NavigationMesh::initGraph() {
     // Reservamos memoria para el grafo
@@ -498,39 +1420,19 @@ void NavigationMesh::initGraph() {
     }
     
     // Recorremos las celdas
-    for (Cells::iterator it = _cells.begin(); it != _cells.end(); ++it) {
-	// Tomamos la celda y su id
-	Cell* cellA = *it;
-	int idA = cellA->getId();
-	
+    for (int idA = 0; idA < _cellNumber; ++idA) {
 	// El coste de ir de la celda a sí misma es 0
 	_graph[idA * _cellNumber + idA] = 0.0f;
 	
-	Cell* cellB;
-	int idB;
-	
-	// Probamos el lado SIDE_AB
-	cellB = cellA->getLink(Cell::SIDE_AB);
-	if (cellB != 0) {
-	    idB = cellB->getId();
-	    _graph[idA * _cellNumber + idB] = 1.0f;
-	    _graph[idB * _cellNumber + idA] = 1.0f;
-	}
-	
-	// Probamos el lado SIDE_BC
-	cellB = cellA->getLink(Cell::SIDE_BC);
-	if (cellB != 0) {
-	    idB = cellB->getId();
-	    _graph[idA * _cellNumber + idB] = 1.0f;
-	    _graph[idB * _cellNumber + idA] = 1.0f;
-	}
-	
-	// Probamos el lado SIDE_CA
-	cellB = cellA->getLink(Cell::SIDE_CA);
-	if (cellB != 0) {
-	    idB = cellB->getId();
-	    _graph[idA * _cellNumber + idB] = 1.0f;
-	    _graph[idB * _cellNumber + idA] = 1.0f;
+	// Probamos cada lado: el coste es la distancia a través del portal
+	for (int i = 0; i < 3; ++i) {
+	    int idB = _cellLinks[idA * 3 + i];
+	    
+	    if (idB != -1) {
+		Ogre::Real cost = getTraversalCost(idA, idB);
+		_graph[idA * _cellNumber + idB] = cost;
+		_graph[idB * _cellNumber + idA] = cost;
+	    }
 	}
     }
 }
@@ -549,43 +1451,6 @@ void NavigationMesh::floyd() {
     }
 }
 
-void NavigationMesh::precomputePaths() {
-
-    //int* newPaths = new int[_cellNumber * _cellNumber];
-    
-    // Recorremos todas las combinaciones inicio - destino
-    for (int i = 0; i < _cellNumber; ++i) {
-	for (int j = 0; j < _cellNumber; ++j) {
-	    
-	    //newPaths[i * _cellNumber + j] = _paths[i * _cellNumber + j];
-	    
-	    // Recuperamos el camino de i a j
-	    CellPath cellPath;
-	    recoverPath(i, j, cellPath);
-	    
-	    // Simplificamos el camino de i a j
-	    simplifyPath(cellPath);
-	    
-	    // Actualizamos la matriz de caminos con el camino simplificado de i a j 
-	    for (CellPath::iterator it = cellPath.begin(); it != cellPath.end(); ++it) {
-		CellPath::iterator nextIt = it;
-		++nextIt;
-
-		if (nextIt != cellPath.end()) {
-		    int idA = (*it)->getId();
-		    int idB = (*nextIt)->getId();
-		    
-		    // El camino entre nodos consecutivos es directo
-		    _paths[idA * _cellNumber + idB] = -1;
-		}
-	    }
-	}
-    }
-    
-    //delete [] _paths;
-    //_paths = newPaths;
-}
-
 void NavigationMesh::recoverPath(int i, int j, CellPath& cellPath) {
     // Tomamos el nodo intermedio por el que pasa el camino de i a j
     int k = _paths[i * _cellNumber + j];
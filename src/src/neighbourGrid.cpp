@@ -0,0 +1,165 @@
+/*
+ * This file is part of SionTower.
+ *
+ * 
+ * David Saltares M&aacute;rquez (C) 2011
+ * <david.saltares@gmail.com>
+ *
+ * 
+ * SionTower examples are free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License ad
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) ant later version.
+ *
+ * SionTower examples are distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SionTower examples.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+
+#include "neighbourGrid.h"
+
+// Tamaño máximo de la rejilla por eje (agentes muy dispersos)
+static const int MAX_GRID_SIDE = 256;
+
+NeighbourGrid::NeighbourGrid(Ogre::Real cellSize): _cellSize(cellSize),
+                                                   _originX(0.0f),
+                                                   _originZ(0.0f),
+                                                   _gridWidth(0),
+                                                   _gridHeight(0) {}
+
+void NeighbourGrid::clear() {
+    _agents.clear();
+    _gridStart.clear();
+    _gridAgents.clear();
+    _gridWidth = 0;
+    _gridHeight = 0;
+}
+
+void NeighbourGrid::addAgent(const void* owner,
+                             const Ogre::Vector3& position,
+                             const Ogre::Vector3& velocity,
+                             Ogre::Real radius,
+                             bool avoiding) {
+    Agent agent;
+    agent.owner = owner;
+    agent.position = position;
+    agent.velocity = velocity;
+    agent.radius = radius;
+    agent.avoiding = avoiding;
+    _agents.push_back(agent);
+}
+
+void NeighbourGrid::build() {
+    int agentNumber = _agents.size();
+    
+    if (agentNumber == 0) {
+        _gridWidth = 0;
+        _gridHeight = 0;
+        return;
+    }
+    
+    // Límites de los agentes en el plano XZ
+    Ogre::Real minX = _agents[0].position.x;
+    Ogre::Real minZ = _agents[0].position.z;
+    Ogre::Real maxX = minX;
+    Ogre::Real maxZ = minZ;
+    
+    for (int i = 1; i < agentNumber; ++i) {
+        minX = std::min(minX, _agents[i].position.x);
+        minZ = std::min(minZ, _agents[i].position.z);
+        maxX = std::max(maxX, _agents[i].position.x);
+        maxZ = std::max(maxZ, _agents[i].position.z);
+    }
+    
+    _originX = minX;
+    _originZ = minZ;
+    _gridWidth = std::min((int)((maxX - minX) / _cellSize) + 1, MAX_GRID_SIDE);
+    _gridHeight = std::min((int)((maxZ - minZ) / _cellSize) + 1, MAX_GRID_SIDE);
+    
+    // Ordenación por recuento: contamos, acumulamos y colocamos
+    int gridSize = _gridWidth * _gridHeight;
+    _gridStart.assign(gridSize + 1, 0);
+    _gridAgents.resize(agentNumber);
+    _agentCells.resize(agentNumber);
+    
+    for (int i = 0; i < agentNumber; ++i) {
+        int x = std::min((int)((_agents[i].position.x - _originX) / _cellSize), _gridWidth - 1);
+        int z = std::min((int)((_agents[i].position.z - _originZ) / _cellSize), _gridHeight - 1);
+        _agentCells[i] = z * _gridWidth + x;
+        ++_gridStart[_agentCells[i] + 1];
+    }
+    
+    for (int c = 0; c < gridSize; ++c)
+        _gridStart[c + 1] += _gridStart[c];
+    
+    for (int i = 0; i < agentNumber; ++i)
+        _gridAgents[_gridStart[_agentCells[i]]++] = i;
+    
+    // Tras colocar, _gridStart[c] apunta al final de c: desplazamos
+    for (int c = gridSize; c > 0; --c)
+        _gridStart[c] = _gridStart[c - 1];
+    
+    _gridStart[0] = 0;
+}
+
+int NeighbourGrid::findNeighbours(const void* owner,
+                                  const Ogre::Vector3& position,
+                                  Ogre::Real radius,
+                                  int maxNeighbours,
+                                  Neighbours& neighbours) const {
+    neighbours.clear();
+    
+    if (_gridWidth == 0 || maxNeighbours <= 0)
+        return 0;
+    
+    Ogre::Real rangeSq = radius * radius;
+    
+    // Celdas que cubren el círculo de búsqueda
+    int minX = std::max((int)Ogre::Math::Floor((position.x - radius - _originX) / _cellSize), 0);
+    int minZ = std::max((int)Ogre::Math::Floor((position.z - radius - _originZ) / _cellSize), 0);
+    int maxX = std::min((int)Ogre::Math::Floor((position.x + radius - _originX) / _cellSize), _gridWidth - 1);
+    int maxZ = std::min((int)Ogre::Math::Floor((position.z + radius - _originZ) / _cellSize), _gridHeight - 1);
+    
+    for (int z = minZ; z <= maxZ; ++z) {
+        for (int x = minX; x <= maxX; ++x) {
+            int cell = z * _gridWidth + x;
+            
+            for (int k = _gridStart[cell]; k < _gridStart[cell + 1]; ++k) {
+                int agent = _gridAgents[k];
+                
+                if (_agents[agent].owner == owner)
+                    continue;
+                
+                Ogre::Real dx = _agents[agent].position.x - position.x;
+                Ogre::Real dz = _agents[agent].position.z - position.z;
+                Ogre::Real distanceSq = dx * dx + dz * dz;
+                
+                if (distanceSq >= rangeSq)
+                    continue;
+                
+                // Inserción ordenada de los k más cercanos
+                if ((int)neighbours.size() < maxNeighbours)
+                    neighbours.push_back(Neighbour());
+                
+                int j = neighbours.size() - 1;
+                
+                for (; j > 0 && distanceSq < neighbours[j - 1].distanceSq; --j)
+                    neighbours[j] = neighbours[j - 1];
+                
+                neighbours[j].agent = agent;
+                neighbours[j].distanceSq = distanceSq;
+                
+                if ((int)neighbours.size() == maxNeighbours)
+                    rangeSq = neighbours.back().distanceSq;
+            }
+        }
+    }
+    
+    return neighbours.size();
+}
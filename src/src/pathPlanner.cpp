@@ -0,0 +1,269 @@
+/*
+ * This file is part of SionTower.
+ *
+ * 
+ * David Saltares M&aacute;rquez (C) 2011
+ * <david.saltares@gmail.com>
+ *
+ * 
+ * SionTower examples are free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License ad
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) ant later version.
+ *
+ * SionTower examples are distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SionTower examples.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <boost/bind.hpp>
+
+#include "pathPlanner.h"
+#include "cell.h"
+#include "profiler.h"
+
+PathPlanner::PathPlanner(NavigationMesh* navigationMesh,
+                         bool threaded,
+                         Ogre::Real frameBudget): _navigationMesh(navigationMesh),
+                                                  _threaded(threaded),
+                                                  _frameBudget(frameBudget),
+                                                  _nextTicket(0),
+                                                  _budget(frameBudget),
+                                                  _running(true),
+                                                  _thread(0) {
+    if (_threaded)
+        _thread = new boost::thread(boost::bind(&PathPlanner::run, this));
+}
+
+PathPlanner::~PathPlanner() {
+    if (_thread) {
+        // Despertamos al hilo trabajador para que termine
+        {
+            boost::mutex::scoped_lock lock(_mutex);
+            _running = false;
+        }
+        
+        _condition.notify_all();
+        _thread->join();
+        delete _thread;
+    }
+}
+
+int PathPlanner::requestPath(const void* owner,
+                             const Ogre::Vector3& startPos,
+                             const Ogre::Vector3& endPos,
+                             const Callback& callback,
+                             Cell* startCell,
+                             Cell* endCell) {
+    Request request;
+    request.ticket = ++_nextTicket;
+    request.owner = owner;
+    request.startPos = startPos;
+    request.endPos = endPos;
+    request.startCell = startCell? startCell : _navigationMesh->findCell(startPos);
+    request.endCell = endCell? endCell : _navigationMesh->findCell(endPos);
+    request.callback = callback;
+    
+    // Sólo la última petición de cada solicitante es válida
+    _tickets[owner] = request.ticket;
+    
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        
+        // Si tenía una petición pendiente la sustituimos
+        std::vector<Request>::iterator i;
+        for (i = _pending.begin(); i != _pending.end() && i->owner != owner; ++i);
+        
+        if (i != _pending.end())
+            *i = request;
+        else
+            _pending.push_back(request);
+    }
+    
+    _condition.notify_one();
+    
+    return request.ticket;
+}
+
+void PathPlanner::cancel(const void* owner) {
+    _tickets.erase(owner);
+    
+    boost::mutex::scoped_lock lock(_mutex);
+    
+    for (std::vector<Request>::iterator i = _pending.begin(); i != _pending.end(); ) {
+        if (i->owner == owner)
+            i = _pending.erase(i);
+        else
+            ++i;
+    }
+}
+
+void PathPlanner::update() {
+    // Sin hilo resolvemos aquí las peticiones mientras quede presupuesto
+    if (!_threaded) {
+        _timer.reset();
+        
+        while (!_pending.empty() && _budget > 0.0f) {
+            takeBatch();
+            solveBatch(_completed);
+            _budget -= _timer.getMicroseconds() * 0.001f;
+            _timer.reset();
+        }
+    }
+    
+    // Recogemos los resultados
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        _dispatching.swap(_completed);
+    }
+    
+    dispatch();
+}
+
+void PathPlanner::resetBudget() {
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        _budget = _frameBudget;
+    }
+    
+    _condition.notify_one();
+}
+
+void PathPlanner::setFrameBudget(Ogre::Real frameBudget) {
+    boost::mutex::scoped_lock lock(_mutex);
+    _frameBudget = frameBudget;
+}
+
+int PathPlanner::getPendingNumber() {
+    boost::mutex::scoped_lock lock(_mutex);
+    return _pending.size();
+}
+
+void PathPlanner::run() {
+    PROFILE_THREAD("PathPlanner");
+    std::vector<Response> responses;
+    
+    while (true) {
+        {
+            boost::mutex::scoped_lock lock(_mutex);
+            
+            // Esperamos a tener peticiones y presupuesto en este frame
+            while (_running && (_pending.empty() || _budget <= 0.0f))
+                _condition.wait(lock);
+            
+            if (!_running)
+                return;
+            
+            takeBatch();
+        }
+        
+        _timer.reset();
+        solveBatch(responses);
+        Ogre::Real elapsed = _timer.getMicroseconds() * 0.001f;
+        
+        {
+            boost::mutex::scoped_lock lock(_mutex);
+            _budget -= elapsed;
+            _completed.insert(_completed.end(), responses.begin(), responses.end());
+        }
+        
+        responses.clear();
+    }
+}
+
+bool PathPlanner::takeBatch() {
+    // Tomamos la primera petición y todas las que vayan a su misma celda
+    _batch.clear();
+    
+    if (_pending.empty())
+        return false;
+    
+    Cell* endCell = _pending.front().endCell;
+    
+    for (std::vector<Request>::iterator i = _pending.begin(); i != _pending.end(); ) {
+        if (i->endCell == endCell) {
+            _batch.push_back(*i);
+            i = _pending.erase(i);
+        }
+        else {
+            ++i;
+        }
+    }
+    
+    return true;
+}
+
+void PathPlanner::solveBatch(std::vector<Response>& responses) {
+    PROFILE_ZONE("PathPlanner::solveBatch");
+    
+    Cell* endCell = _batch.front().endCell;
+    int batchSize = _batch.size();
+    bool partial = false;
+    
+    _corridors.resize(batchSize);
+    
+    // Una petición sola puede usar la búsqueda jerárquica y su pasillo
+    // parcial; un grupo comparte una única búsqueda desde el destino
+    if (batchSize == 1) {
+        const Request& request = _batch.front();
+        
+        if (!request.startCell || !endCell ||
+            !_navigationMesh->findCorridor(_corridors[0], request.startCell, endCell, &partial))
+            _corridors[0].clear();
+    }
+    else if (endCell) {
+        _startCells.clear();
+        
+        for (std::vector<Request>::iterator i = _batch.begin(); i != _batch.end(); ++i)
+            _startCells.push_back(i->startCell);
+        
+        _navigationMesh->findCorridors(_corridors, _startCells, endCell);
+    }
+    else {
+        for (int i = 0; i < batchSize; ++i)
+            _corridors[i].clear();
+    }
+    
+    for (int i = 0; i < batchSize; ++i) {
+        const Request& request = _batch[i];
+        const NavigationMesh::CellPath& corridor = _corridors[i];
+        
+        responses.push_back(Response());
+        Response& response = responses.back();
+        
+        response.ticket = request.ticket;
+        response.owner = request.owner;
+        response.callback = request.callback;
+        response.result.found = !corridor.empty();
+        response.result.partial = partial;
+        response.result.goal = request.endPos;
+        
+        // Si el pasillo es parcial termina en el centro de su última celda
+        if (response.result.found) {
+            response.result.corridor = corridor;
+            _navigationMesh->stringPull(corridor,
+                                        request.startPos,
+                                        partial? corridor.back()->getCenter() : request.endPos,
+                                        response.result.path);
+        }
+    }
+}
+
+void PathPlanner::dispatch() {
+    for (std::vector<Response>::iterator i = _dispatching.begin(); i != _dispatching.end(); ++i) {
+        // Descartamos peticiones canceladas o sustituidas por otra más nueva
+        Tickets::iterator ticket = _tickets.find(i->owner);
+        
+        if (ticket == _tickets.end() || ticket->second != i->ticket)
+            continue;
+        
+        _tickets.erase(ticket);
+        i->callback(i->result);
+    }
+    
+    _dispatching.clear();
+}
@@ -24,9 +24,6 @@
 #include <algorithm>
 #include <cstdlib>
 
-#include <boost/bind.hpp>
-#include <boost/function.hpp>
-
 #include "game.h"
 #include "player.h"
 #include "actor.h"
@@ -46,6 +43,17 @@
 using std::cout;
 using std::endl;
 
+// Funciones de actualización indexadas por Actor::State
+const Actor::UpdateStateMethods Player::UPDATE_METHODS = {
+    static_cast<UpdateStateMethod>(&Player::stateIdle),     // IDLE
+    static_cast<UpdateStateMethod>(&Player::stateRun),      // RUN
+    static_cast<UpdateStateMethod>(&Player::stateDamaged),  // DAMAGED
+    static_cast<UpdateStateMethod>(&Player::stateAttack),   // ATTACK
+    static_cast<UpdateStateMethod>(&Player::stateWin),      // WIN
+    static_cast<UpdateStateMethod>(&Player::stateDie),      // DIE
+    0                                                       // ERASE
+};
+
 Player::Player(Ogre::SceneManager* sceneManager,
                StateGame* stateGame,
                Ogre::Camera* camera,
@@ -94,12 +102,7 @@ Player::Player(Ogre::SceneManager* sceneManager,
     _currentState = IDLE;
     
     // Gestores de estados
-    _updateMethods[IDLE] = boost::bind(&Player::stateIdle, this, _1);
-    _updateMethods[RUN] = boost::bind(&Player::stateRun, this, _1);
-    _updateMethods[ATTACK] = boost::bind(&Player::stateAttack, this, _1);
-    _updateMethods[DAMAGED] = boost::bind(&Player::stateDamaged, this, _1);
-    _updateMethods[WIN] = boost::bind(&Player::stateWin, this, _1);
-    _updateMethods[DIE] = boost::bind(&Player::stateDie, this, _1);
+    _updateMethods = UPDATE_METHODS;
 
     // Sonido
     _damagedSound = SoundFXManager::getSingleton().load("playerDamaged.wav");
@@ -120,11 +123,8 @@ void Player::update(Ogre::Real deltaT) {
     if (_currentAnimation && _currentState != ERASE)
         _currentAnimation->addTime(deltaT * 1.75);
         
-    // Buscamos la función de actualización de su estado
-    UpdateStateMethods::iterator i = _updateMethods.find(_currentState);
-    
-    if (i != _updateMethods.end())
-        i->second(deltaT);
+    // Función de actualización de su estado
+    updateState(deltaT);
         
     // Recuperación de maná
     _timeMana += deltaT;
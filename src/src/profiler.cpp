@@ -0,0 +1,227 @@
+/*
+ * This file is part of SionTower.
+ *
+ * 
+ * David Saltares M&aacute;rquez (C) 2011
+ * <david.saltares@gmail.com>
+ *
+ * 
+ * SionTower examples are free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License ad
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) ant later version.
+ *
+ * SionTower examples are distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SionTower examples.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/**
+ *  @file profiler.cpp
+ *  @date 19-10-2026
+ */
+
+#include <vector>
+#include <fstream>
+#include <cstdio>
+
+#include <boost/thread.hpp>
+
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <time.h>
+#endif
+
+#include "profiler.h"
+
+namespace {
+    // Zona cerrada
+    struct Event {
+        const char* name;
+        Profiler::Time start;
+        Profiler::Time end;
+    };
+    
+    // Búfer circular de un hilo. Sólo escribe su hilo; el mutex, sin
+    // competencia salvo durante un volcado, protege la lectura
+    struct ThreadBuffer {
+        int id;
+        std::string name;
+        const char* zone;
+        std::vector<Event> events;
+        size_t next;
+        bool full;
+        boost::mutex mutex;
+    };
+    
+    // Los búferes viven hasta el final del programa para que el volcado
+    // incluya los hilos ya terminados
+    void keepBuffer(ThreadBuffer*) {}
+    
+    boost::thread_specific_ptr<ThreadBuffer> threadBuffer(keepBuffer);
+    std::vector<ThreadBuffer*> buffers;
+    boost::mutex buffersMutex;
+    
+    ThreadBuffer* getThreadBuffer() {
+        ThreadBuffer* buffer = threadBuffer.get();
+        
+        if (!buffer) {
+            buffer = new ThreadBuffer();
+            buffer->events.resize(ProfilerZone::CAPACITY);
+            buffer->zone = 0;
+            buffer->next = 0;
+            buffer->full = false;
+            
+            boost::mutex::scoped_lock lock(buffersMutex);
+            char name[32];
+            buffer->id = buffers.size() + 1;
+            sprintf(name, "thread %d", buffer->id);
+            buffer->name = name;
+            buffers.push_back(buffer);
+            threadBuffer.reset(buffer);
+        }
+        
+        return buffer;
+    }
+    
+    // Cadena JSON, los nombres son literales del código
+    void writeString(std::ofstream& file, const std::string& text) {
+        file << '"';
+        
+        for (std::string::const_iterator i = text.begin(); i != text.end(); ++i) {
+            if (*i == '"' || *i == '\\')
+                file << '\\';
+            
+            file << *i;
+        }
+        
+        file << '"';
+    }
+    
+    // Microsegundos con decimales, la unidad de la traza
+    void writeTime(std::ofstream& file, Profiler::Time time) {
+        char buffer[32];
+        sprintf(buffer, "%llu.%03llu", time / 1000, time % 1000);
+        file << buffer;
+    }
+}
+
+Profiler::Time Profiler::now() {
+#ifdef _WIN32
+    static LARGE_INTEGER frequency = {0};
+    LARGE_INTEGER counter;
+    
+    if (!frequency.QuadPart)
+        QueryPerformanceFrequency(&frequency);
+    
+    QueryPerformanceCounter(&counter);
+    return static_cast<Time>(counter.QuadPart / frequency.QuadPart) * 1000000000ULL +
+           static_cast<Time>(counter.QuadPart % frequency.QuadPart) * 1000000000ULL / frequency.QuadPart;
+#else
+    timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return static_cast<Time>(time.tv_sec) * 1000000000ULL + time.tv_nsec;
+#endif
+}
+
+const char* Profiler::enter(const char* name) {
+    ThreadBuffer* buffer = getThreadBuffer();
+    const char* parent = buffer->zone;
+    buffer->zone = name;
+    
+    return parent;
+}
+
+void Profiler::leave(const char* name, const char* parent, Time start, Time end) {
+    ThreadBuffer* buffer = getThreadBuffer();
+    buffer->zone = parent;
+    
+    boost::mutex::scoped_lock lock(buffer->mutex);
+    
+    Event& event = buffer->events[buffer->next];
+    event.name = name;
+    event.start = start;
+    event.end = end;
+    
+    if (++buffer->next == buffer->events.size()) {
+        buffer->next = 0;
+        buffer->full = true;
+    }
+}
+
+const char* Profiler::getCurrentZone() {
+    // Sin crear el búfer: se llama desde operator new
+    ThreadBuffer* buffer = threadBuffer.get();
+    return buffer? buffer->zone : 0;
+}
+
+void Profiler::setThreadName(const std::string& name) {
+    ThreadBuffer* buffer = getThreadBuffer();
+    boost::mutex::scoped_lock lock(buffer->mutex);
+    buffer->name = name;
+}
+
+bool Profiler::dump(const std::string& fileName) {
+    std::ofstream file(fileName.c_str());
+    
+    if (!file)
+        return false;
+    
+    boost::mutex::scoped_lock lock(buffersMutex);
+    
+    // Tiempos relativos a la zona más antigua
+    Time origin = 0;
+    bool first = true;
+    
+    for (std::vector<ThreadBuffer*>::iterator i = buffers.begin(); i != buffers.end(); ++i) {
+        boost::mutex::scoped_lock bufferLock((*i)->mutex);
+        size_t size = (*i)->full? (*i)->events.size() : (*i)->next;
+        
+        for (size_t j = 0; j < size; ++j) {
+            if (first || (*i)->events[j].start < origin) {
+                origin = (*i)->events[j].start;
+                first = false;
+            }
+        }
+    }
+    
+    file << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    first = true;
+    
+    for (std::vector<ThreadBuffer*>::iterator i = buffers.begin(); i != buffers.end(); ++i) {
+        boost::mutex::scoped_lock bufferLock((*i)->mutex);
+        
+        // Nombre del hilo
+        file << (first? "\n" : ",\n") << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":"
+             << (*i)->id << ",\"args\":{\"name\":";
+        writeString(file, (*i)->name);
+        file << "}}";
+        first = false;
+        
+        // Zonas en orden de cierre, de la más antigua a la más reciente
+        size_t size = (*i)->full? (*i)->events.size() : (*i)->next;
+        size_t begin = (*i)->full? (*i)->next : 0;
+        
+        for (size_t j = 0; j < size; ++j) {
+            const Event& event = (*i)->events[(begin + j) % (*i)->events.size()];
+            
+            file << ",\n{\"ph\":\"X\",\"pid\":1,\"tid\":" << (*i)->id << ",\"name\":";
+            writeString(file, event.name);
+            file << ",\"ts\":";
+            writeTime(file, event.start - origin);
+            file << ",\"dur\":";
+            writeTime(file, event.end - event.start);
+            file << "}";
+        }
+    }
+    
+    file << "\n]}\n";
+    
+    return file.good();
+}
@@ -87,8 +87,8 @@ Spell::Spell(Ogre::SceneManager* sceneManager,
     _body->setType(SPELL);
     CollisionManager::getSingleton().addBody(_body);
         
-    // Creamos el timer para la explosión
-    _explosionTimer = new Ogre::Timer();
+    // Tiempo de simulación desde la explosión
+    _explosionTime = 0.0f;
     
     // Sincronizamos
     synchronizeBody();
@@ -102,9 +102,6 @@ Spell::~Spell() {
     
     // El body y el node se eliminan en ~GameObject
     
-    // Eliminar timer
-    delete _explosionTimer;
-    
     // Eliminar sistemas de partículas
     _sceneManager->destroyParticleSystem(_particleExplode);
     _sceneManager->destroyParticleSystem(_particleMove);
@@ -120,6 +117,8 @@ void Spell::initialiseSpellData() {
     data.mana = 3;
     data.speed = 8;
     data.explosionTime = 1500;
+    data.areaRadius = 0.0f;
+    data.areaCost = 1.0f;
     data.particleExplode = "fireExplosion";
     data.particleMove = "fire";
     data.soundCast = "fireCast.wav";
@@ -133,6 +132,8 @@ void Spell::initialiseSpellData() {
     data.mana = 6;
     data.speed = 8;
     data.explosionTime = 1500;
+    data.areaRadius = 2.5f;
+    data.areaCost = 4.0f;
     data.particleExplode = "geaExplosion";
     data.particleMove = "gea";
     data.soundCast = "geaCast.wav";
@@ -146,6 +147,8 @@ void Spell::initialiseSpellData() {
     data.mana = 8;
     data.speed = 8;
     data.explosionTime = 1500;
+    data.areaRadius = 0.0f;
+    data.areaCost = 1.0f;
     data.particleExplode = "blizzardExplosion";
     data.particleMove = "blizzard";
     data.soundCast = "blizzardCast.wav";
@@ -169,6 +172,14 @@ Ogre::Real Spell::getSpeed() const {
     return _spellData.speed;
 }
 
+Ogre::Real Spell::getAreaRadius() const {
+    return _spellData.areaRadius;
+}
+
+Ogre::Real Spell::getAreaCost() const {
+    return _spellData.areaCost;
+}
+
 const Ogre::Vector3& Spell::getDirection() const {
     return _direction;
 }
@@ -199,8 +210,8 @@ void Spell::explode() {
         // Cambiamos el estado
         _state = EXPLODE;
         
-        // Lanzamos el timer
-        _explosionTimer->reset();   
+        // Empezamos a contar el tiempo de la explosión
+        _explosionTime = 0.0f;
     }
 }
 
@@ -210,7 +221,11 @@ void Spell::update(Ogre::Real deltaT) {
         synchronizeBody();
     }
     else if (_state == EXPLODE) {
-        if (_explosionTimer->getMilliseconds() >= _spellData.explosionTime) {
+        // Con el tiempo de la simulación y no el del reloj, para que la
+        // partida se reproduzca igual con InputRecorder
+        _explosionTime += deltaT * 1000.0f;
+        
+        if (_explosionTime >= _spellData.explosionTime) {
             // Desvincula el sistema de partículas del nodo
             _node->detachObject(_particleExplode);
             
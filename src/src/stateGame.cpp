@@ -48,6 +48,13 @@
 #include "level.h"
 #include "game.h"
 #include "enemy.h"
+#include "pathPlanner.h"
+#include "neighbourGrid.h"
+#include "velocityObstacles.h"
+#include "steeringSystem.h"
+#include "aiScheduler.h"
+#include "profiler.h"
+#include "allocationTracker.h"
 
 #define _(x) gettext(x)
 
@@ -173,6 +180,29 @@ void StateGame::load() {
         _player->setPosition(_level->getPlayerPosition());
         _player->setPosition(_player->getPosition() - Ogre::Vector3(0, 0.7, 0));
         
+        // Búsqueda de caminos en segundo plano. Al grabar o reproducir la
+        // entrada, sin hilo ni presupuestos para que la partida sea repetible
+        bool deterministic = _stateManager->getInputRecorder()->isDeterministic();
+        
+        if (deterministic)
+            _pathPlanner = new PathPlanner(_level->getNavigationMesh(), false, Ogre::Math::POS_INFINITY);
+        else
+            _pathPlanner = new PathPlanner(_level->getNavigationMesh());
+        
+        // Vecindad y evitación local entre enemigos
+        _neighbourGrid = new NeighbourGrid();
+        _velocityObstacles = new VelocityObstacles(_neighbourGrid);
+        _steeringSystem = new SteeringSystem(_velocityObstacles);
+        
+        // Celda del jugador para las líneas de visión de los enemigos
+        _playerCell = 0;
+        
+        // Nivel de detalle de la IA según distancia y visibilidad
+        _aiScheduler = new AIScheduler();
+        
+        if (deterministic)
+            _aiScheduler->budget = Ogre::Math::POS_INFINITY;
+        
         // Canción derrota
         _loseSong = SongManager::getSingleton().load("Sion tower - 07 Derrota.ogg");
         
@@ -187,7 +217,7 @@ void StateGame::load() {
         _panelPause->setVisible(false);
         
         // Camera controller
-        _cameraController = new CameraController(_camera, _mouse, _player);
+        _cameraController = new CameraController(_camera, _player);
 
         // CALLBACKS de colisiones
         CollisionManager::CollisionCallback callback;
@@ -240,12 +270,23 @@ void StateGame::clear() {
             
         _spells.clear();
         
+        // Las celdas marcadas pertenecen a la malla que se va a descargar
+        _spellAreaCells.clear();
+        _spellAreaCosts.clear();
+        
         // Eliminamos los enemigos
         for (std::vector<Enemy*>::iterator i = _enemies.begin(); i != _enemies.end(); ++i)
             delete (*i);
             
         _enemies.clear();
         
+        // Detenemos la búsqueda de caminos antes de descargar la malla
+        delete _pathPlanner;
+        delete _steeringSystem;
+        delete _velocityObstacles;
+        delete _neighbourGrid;
+        delete _aiScheduler;
+        
         // Destruimos las estadísticas
         delete _gameStats;
         
@@ -263,30 +304,72 @@ void StateGame::clear() {
 
 
 void StateGame::update(Ogre::Real deltaT, bool active) {
+    PROFILE_ZONE("StateGame::update");
+    
+    // Punto de partida de la interpolación de este paso
+    if (active)
+        saveTransforms();
+    
+    // La cámara se simula antes que el personaje, que se mueve y apunta
+    // respecto a ella
+    if (active && _state != PAUSE && _state != WIN)
+        _cameraController->update(deltaT);
+    
     if (active && _state == PLAYING) {  
+        {
+            PROFILE_ZONE("StateGame::update/paths");
+            
+            // Invalidamos las consultas de la malla del frame anterior
+            _level->getNavigationMesh()->newFrame();
+            
+            // Entregamos los caminos calculados desde el frame anterior
+            _pathPlanner->update();
+            
+            // Campo de flujo hacia el jugador (sólo cambia si cambia de celda)
+            if (_level->isFlowFieldEnabled())
+                _level->getNavigationMesh()->updateFlowField(_player->getPosition());
+        }
+        
         // Actualizar personaje
-        _player->update(deltaT);
+        {
+            PROFILE_ZONE("StateGame::update/player");
+            _player->update(deltaT);
+        }
         
         // Actualizar hechizos
-        for (std::vector<Spell*>::iterator i = _spells.begin(); i != _spells.end(); ++i)
-            (*i)->update(deltaT);
+        {
+            PROFILE_ZONE("StateGame::update/spells");
+            
+            for (std::vector<Spell*>::iterator i = _spells.begin(); i != _spells.end(); ++i)
+                (*i)->update(deltaT);
+            
+            updateSpellAreas();
+        }
 
         // Actualizar enemigos
-        for (std::vector<Enemy*>::iterator i = _enemies.begin(); i != _enemies.end(); ++i)
-            (*i)->update(deltaT);
-        
-        // Actualizar cámara
-        _cameraController->update(deltaT);
+        {
+            PROFILE_ZONE("StateGame::update/enemies");
+            updateEnemies(deltaT);
+        }
         
         // Comprobar colisiones
         CollisionManager::getSingleton().checkCollisions();
         
         // Borramos elementos innecesarios
-        eraseEndedSpells();
-        eraseDeadEnemies();
+        {
+            PROFILE_ZONE("StateGame::update/erase");
+            eraseEndedSpells();
+            eraseDeadEnemies();
+        }
         
         // Comprobamos las apariciones de los enemigos
-        checkEnemySpawning();
+        {
+            PROFILE_ZONE("StateGame::update/spawning");
+            checkEnemySpawning();
+        }
+        
+        // Estadísticas, HUD y fin de partida
+        PROFILE_ZONE("StateGame::update/hud");
         
         // Actualizamos el tiempo de partida
         _gameStats->setTime(_gameTime);
@@ -306,8 +389,19 @@ void StateGame::update(Ogre::Real deltaT, bool active) {
         // Actualizamos el tiempo
         _gameTime += deltaT;
         
-        char buffer[30];
-        sprintf(buffer, "FPS: %f", Game::getRenderWindow()->getLastFPS());
+        // FPS y consumo de la IA: milisegundos y enemigos aplazados
+        char buffer[128];
+        int length = sprintf(buffer, "FPS: %f\nAI: %.2f ms (%d deferred)",
+                             Game::getRenderWindow()->getLastFPS(),
+                             _aiScheduler->getUsedTime(),
+                             _aiScheduler->getDeferredNumber());
+        
+        // Reservas de memoria del último cuadro (make memoria=si)
+        if (AllocationTracker::isEnabled())
+            sprintf(buffer + length, "\nAlloc: %lu (%llu bytes)",
+                    AllocationTracker::getFrameAllocations(),
+                    AllocationTracker::getFrameBytes());
+        
         _lblFPS->setCaption(buffer);
         
         // Si el jugador ha muerto
@@ -325,11 +419,7 @@ void StateGame::update(Ogre::Real deltaT, bool active) {
             (*i)->update(deltaT);
 
         // Actualizar enemigos
-        for (std::vector<Enemy*>::iterator i = _enemies.begin(); i != _enemies.end(); ++i)
-            (*i)->update(deltaT);
-        
-        // Actualizar cámara
-        _cameraController->update(deltaT);
+        updateEnemies(deltaT);
         
         // Comprobar colisiones
         CollisionManager::getSingleton().checkCollisions();
@@ -344,9 +434,6 @@ void StateGame::update(Ogre::Real deltaT, bool active) {
         // Actualizar personaje
         _player->update(deltaT);
         
-        // Actualizar cámara
-        _cameraController->update(deltaT);
-        
         // Comprobar colisiones
         CollisionManager::getSingleton().checkCollisions();
         
@@ -366,6 +453,42 @@ void StateGame::update(Ogre::Real deltaT, bool active) {
     }
 }
 
+void StateGame::newFrame(bool active) {
+    if (!active)
+        return;
+    
+    _aiScheduler->resetBudget();
+    _pathPlanner->resetBudget();
+}
+
+void StateGame::interpolate(Ogre::Real deltaT, Ogre::Real alpha, bool active) {
+    PROFILE_ZONE("StateGame::interpolate");
+    
+    if (!active || _state == PAUSE || _state == WIN)
+        return;
+    
+    // Dibujamos a los personajes y hechizos entre los dos últimos pasos
+    _player->interpolateTransform(alpha);
+    
+    for (std::vector<Enemy*>::iterator i = _enemies.begin(); i != _enemies.end(); ++i)
+        (*i)->interpolateTransform(alpha);
+    
+    for (std::vector<Spell*>::iterator i = _spells.begin(); i != _spells.end(); ++i)
+        (*i)->interpolateTransform(alpha);
+    
+    // La cámara entre los dos últimos pasos, como lo que sigue
+    _cameraController->interpolate(alpha);
+}
+
+void StateGame::saveTransforms() {
+    _player->saveTransform();
+    
+    for (std::vector<Enemy*>::iterator i = _enemies.begin(); i != _enemies.end(); ++i)
+        (*i)->saveTransform();
+    
+    for (std::vector<Spell*>::iterator i = _spells.begin(); i != _spells.end(); ++i)
+        (*i)->saveTransform();
+}
 
 bool StateGame::keyPressed(const OIS::KeyEvent &arg) {
     MyGUI::InputManager::getInstance().injectKeyPress(MyGUI::KeyCode::Enum(arg.key), arg.text);
@@ -430,6 +553,10 @@ bool StateGame::keyReleased(const OIS::KeyEvent &arg) {
 bool StateGame::mouseMoved(const OIS::MouseEvent &arg) {
     MyGUI::InputManager::getInstance().injectMouseMove(arg.state.X.abs, arg.state.Y.abs, arg.state.Z.abs);
     
+    // El giro y el zoom de la cámara se aplican en el siguiente paso
+    if (_state != PAUSE && _state != WIN)
+        _cameraController->mouseMoved(arg);
+    
     return true;
 }
 
@@ -530,27 +657,22 @@ void StateGame::collisionSpellEnemy(Body* bodyA, Body* bodyB) {
 }
 
 void StateGame::collisionPlayerEnemy(Body* bodyA, Body* bodyB) {
-    // Recuperamos el enemigo y el personaje
+    // Recuperamos el personaje
     GameObject* objectA = bodyA->getGameObject();
     GameObject* objectB = bodyB->getGameObject();
     
     Player* player;
-    Enemy* enemy;
     
-    if (objectA->getType() == GameObject::PLAYER) {
+    if (objectA->getType() == GameObject::PLAYER)
         player = static_cast<Player*>(objectA);
-        enemy = static_cast<Enemy*>(objectB);
-    }
-    else {
+    else
         player = static_cast<Player*>(objectB);
-        enemy = static_cast<Enemy*>(objectA);
-    }
     
-    // Separamos al personaje un poco
+    // Los enemigos ya se apartan del jugador con VelocityObstacles: sólo
+    // devolvemos al jugador fuera del enemigo
     Ogre::Vector3 direction =  player->getOldPosition() - player->getPosition();
     direction.normalise();
     player->setPosition(player->getPosition() + direction * 0.35);
-    enemy->setPosition(enemy->getPosition() + -direction * 0.15);
 }
 
 void StateGame::updateHUD() {
@@ -593,6 +715,72 @@ void StateGame::updateHUD() {
         _btnBlizzard->setEnabled(true);
 }
 
+void StateGame::updateEnemies(Ogre::Real deltaT) {
+    // Rejilla de vecinos con todos los agentes antes de moverlos: el
+    // jugador y los enemigos parados no se apartan
+    _neighbourGrid->clear();
+    _neighbourGrid->addAgent(_player,
+                             _player->getPosition(),
+                             _player->getKinematic().getVelocity(),
+                             Enemy::getAvoidanceRadius(Enemy::PLAYER),
+                             false);
+    
+    for (std::vector<Enemy*>::iterator i = _enemies.begin(); i != _enemies.end(); ++i)
+        _neighbourGrid->addAgent(*i,
+                                 (*i)->getKinematic().getPosition(),
+                                 (*i)->getKinematic().getVelocity(),
+                                 Enemy::getAvoidanceRadius((*i)->getEnemyType()),
+                                 (*i)->getState() == Actor::RUN);
+    
+    _neighbourGrid->build();
+    
+    // Qué enemigos ven al protagonista
+    sensePlayer();
+    
+    // IA de cada enemigo: decide y pide su movimiento. Los lejanos o no
+    // visibles sólo se actualizan algunos frames y el resto se reparte el
+    // presupuesto, empezando por los que se quedaron sin él
+    // La cámara se mueve al dibujar, así que al grabar o reproducir la
+    // entrada no se tiene en cuenta la visibilidad
+    Ogre::Camera* camera = _stateManager->getInputRecorder()->isDeterministic()? 0 : _camera;
+    int size = _enemies.size();
+    int first = _aiScheduler->newFrame(_player->getPosition(), camera, size);
+    
+    for (int i = 0; i < size; ++i)
+        _enemies[(first + i) % size]->update(deltaT);
+    
+    _aiScheduler->endFrame();
+    
+    // Movemos a todos los enemigos a la vez
+    _steeringSystem->update(deltaT);
+    
+    for (std::vector<Enemy*>::iterator i = _enemies.begin(); i != _enemies.end(); ++i)
+        (*i)->synchronizeMovement();
+}
+
+void StateGame::sensePlayer() {
+    NavigationMesh* navigationMesh = _level->getNavigationMesh();
+    _playerCell = navigationMesh->findCell(_player->getPosition(), _playerCell);
+    
+    _enemyPositions.clear();
+    _enemyCells.clear();
+    
+    for (std::vector<Enemy*>::iterator i = _enemies.begin(); i != _enemies.end(); ++i) {
+        _enemyPositions.push_back((*i)->getKinematic().getPosition());
+        _enemyCells.push_back((*i)->getCurrentCell());
+    }
+    
+    // Una sola consulta desde el protagonista hacia todos los enemigos
+    navigationMesh->lineOfSightTest(_player->getPosition(),
+                                    _playerCell,
+                                    _enemyPositions,
+                                    _enemyCells,
+                                    _playerVisible);
+    
+    for (int i = 0; i < (int)_enemies.size(); ++i)
+        _enemies[i]->setPlayerVisible(_playerVisible[i]);
+}
+
 void StateGame::addSpell(Spell::Type type, const Ogre::Vector3& position, const Ogre::Vector3& direction) {
     Spell* spell = new Spell(_sceneManager, type, position, direction);
     _gameStats->useMana(spell->getMana());
@@ -622,6 +810,53 @@ void StateGame::eraseEndedSpells() {
     }
 }
 
+void StateGame::updateSpellAreas() {
+    // Los enemigos rodean las explosiones con zona (Gea) mientras duran: sus
+    // celdas se encarecen en la malla y los pasillos que las cruzan se
+    // vuelven a buscar (ver NavigationMesh::isCorridorAffected). Los que ya
+    // están dentro huyen de ellas.
+    NavigationMesh* navigationMesh = _level->getNavigationMesh();
+    std::vector<Cell*>& cells = _newSpellAreaCells;
+    std::vector<Ogre::Real>& costs = _newSpellAreaCosts;
+    NavigationMesh::CellPath area;
+    
+    cells.clear();
+    costs.clear();
+    
+    for (std::vector<Enemy*>::iterator j = _enemies.begin(); j != _enemies.end(); ++j)
+        (*j)->setThreat(Ogre::Vector3::ZERO, 0.0f);
+    
+    for (std::vector<Spell*>::iterator i = _spells.begin(); i != _spells.end(); ++i) {
+        if ((*i)->getState() != Spell::EXPLODE || (*i)->getAreaRadius() <= 0.0f)
+            continue;
+        
+        Ogre::Real radius = (*i)->getAreaRadius();
+        
+        navigationMesh->findCells((*i)->getPosition(), radius, area);
+        cells.insert(cells.end(), area.begin(), area.end());
+        costs.insert(costs.end(), area.size(), (*i)->getAreaCost());
+        
+        // Los enemigos que ya están dentro huyen de su centro
+        for (std::vector<Enemy*>::iterator j = _enemies.begin(); j != _enemies.end(); ++j)
+            if ((*j)->getPosition().squaredDistance((*i)->getPosition()) < radius * radius)
+                (*j)->setThreat((*i)->getPosition(), radius);
+    }
+    
+    // Lo habitual es que no haya cambios
+    if (cells == _spellAreaCells && costs == _spellAreaCosts)
+        return;
+    
+    for (std::vector<Cell*>::iterator i = _spellAreaCells.begin(); i != _spellAreaCells.end(); ++i)
+        navigationMesh->setDynamicCost(*i, 1.0f);
+    
+    // Si varias zonas se solapan queda el mayor coste
+    for (int i = 0; i < (int)cells.size(); ++i)
+        navigationMesh->setDynamicCost(cells[i], std::max(navigationMesh->getDynamicCost(cells[i]), costs[i]));
+    
+    _spellAreaCells.swap(_newSpellAreaCells);
+    _spellAreaCosts.swap(_newSpellAreaCosts);
+}
+
 void StateGame::checkEnemySpawning() {
     // Recorremos el vector de enemy spawning
     // Añadimos todos los que su time sea menor o igual al timer (s)
@@ -631,10 +866,14 @@ void StateGame::checkEnemySpawning() {
     
     for (; keepSpawning && _nextEnemy != _level->getEnemySpawns().end(); ++_nextEnemy) {
         // Si ha pasado suficiente tiempo añadimos enemigo
-        if (_nextEnemy->getTime() <= _gameTime && _enemies.size() < 5) {
+        if (_nextEnemy->getTime() <= _gameTime && (int)_enemies.size() < _level->getMaxEnemies()) {
             Enemy* enemy = new Enemy(Game::getSceneManager(), this, _nextEnemy->getType(), _nextEnemy->getPosition());
             enemy->setOrientation(_nextEnemy->getOrientation());
             enemy->setNavigationMesh(_level->getNavigationMesh());
+            enemy->setPathPlanner(_pathPlanner);
+            enemy->setFlowField(_level->isFlowFieldEnabled());
+            enemy->setSteeringSystem(_steeringSystem);
+            enemy->setAIScheduler(_aiScheduler);
             _enemies.push_back(enemy);
         }
         // Si no, paramos y corregimos la posición del iterador
@@ -26,6 +26,8 @@
  *  @date 23-12-2010
  */
 
+#include <algorithm>
+
 #include "stateManager.h"
 #include "state.h"
 #include "stateGame.h"
@@ -35,12 +37,20 @@
 #include "stateLevel.h"
 #include "stateVictory.h"
 #include "game.h"
-
-
-StateManager::StateManager(Game* game, OIS::InputManager* inputManager): _game(game),
-                                                                         _inputManager(inputManager),
-                                                                         _numStates(0),
-                                                                         _exit(false) {
+#include "profiler.h"
+#include "allocationTracker.h"
+
+
+StateManager::StateManager(Game* game,
+                           OIS::InputManager* inputManager,
+                           InputRecorder* inputRecorder): _game(game),
+                                                          _inputManager(inputManager),
+                                                          _inputRecorder(inputRecorder),
+                                                          _numStates(0),
+                                                          _exit(false),
+                                                          _accumulator(0.0f),
+                                                          _timeStep(1.0f / 60.0f),
+                                                          _maxFrameTime(0.25f) {
     // Tomamos el log
     _log = Ogre::LogManager::getSingleton().getLog("sionTowerLog");
 
@@ -221,6 +231,20 @@ void StateManager::performOperations() {
 }
 
 bool StateManager::keyPressed(const OIS::KeyEvent &arg) {
+#ifdef SIONTOWER_PROFILER
+    // F12 vuelca las últimas zonas del perfilador, en cualquier estado
+    if (arg.key == OIS::KC_F12) {
+        if (Profiler::dump("siontower-trace.json"))
+            _log->logMessage("StateManager::keyPressed() -> Traza del perfilador en siontower-trace.json");
+        
+        return true;
+    }
+#endif
+
+    // Grabamos el evento o, al reproducir, descartamos los reales
+    if(!_inputRecorder->keyPressed(arg))
+        return true;
+
     // Le enviamos el evento al estado actual
     if(!_states.empty())
         _states[_numStates - 1]->keyPressed(arg);
@@ -229,6 +253,10 @@ bool StateManager::keyPressed(const OIS::KeyEvent &arg) {
 }
 
 bool StateManager::keyReleased(const OIS::KeyEvent &arg) {
+    // Grabamos el evento o, al reproducir, descartamos los reales
+    if(!_inputRecorder->keyReleased(arg))
+        return true;
+
     // Le enviamos el evento al estado actual
     if(!_states.empty())
         _states[_numStates - 1]->keyReleased(arg);
@@ -237,6 +265,10 @@ bool StateManager::keyReleased(const OIS::KeyEvent &arg) {
 }
 
 bool StateManager::mouseMoved(const OIS::MouseEvent &arg) {
+    // Grabamos el evento o, al reproducir, descartamos los reales
+    if(!_inputRecorder->mouseMoved(arg))
+        return true;
+
     // Le enviamos el evento al estado actual
     if(!_states.empty())
         _states[_numStates - 1]->mouseMoved(arg);
@@ -245,6 +277,10 @@ bool StateManager::mouseMoved(const OIS::MouseEvent &arg) {
 }
 
 bool StateManager::mousePressed(const OIS::MouseEvent &arg, OIS::MouseButtonID id) {
+    // Grabamos el evento o, al reproducir, descartamos los reales
+    if(!_inputRecorder->mousePressed(arg, id))
+        return true;
+
     // Le enviamos el evento al estado actual
     if(!_states.empty())
         _states[_numStates - 1]->mousePressed(arg, id);
@@ -253,6 +289,10 @@ bool StateManager::mousePressed(const OIS::MouseEvent &arg, OIS::MouseButtonID i
 }
 
 bool StateManager::mouseReleased(const OIS::MouseEvent &arg, OIS::MouseButtonID id) {
+    // Grabamos el evento o, al reproducir, descartamos los reales
+    if(!_inputRecorder->mouseReleased(arg, id))
+        return true;
+
     // Le enviamos el evento al estado actual
     if(!_states.empty())
         _states[_numStates - 1]->mouseReleased(arg, id);
@@ -261,17 +301,70 @@ bool StateManager::mouseReleased(const OIS::MouseEvent &arg, OIS::MouseButtonID
 }
 
 bool StateManager::frameStarted(const Ogre::FrameEvent& event) {
+    // Las reservas de memoria se cuentan por cuadro
+    AllocationTracker::newFrame();
+    
+    PROFILE_ZONE("StateManager::frameStarted");
+    
     // Realizamos las operaciones pendientes
     performOperations();
 
     // Actualizamos la entrada
-    _keyboard->capture();
-    _mouse->capture();
+    {
+        PROFILE_ZONE("StateManager::frameStarted/input");
+        _inputRecorder->newFrame(event.timeSinceLastFrame);
+        _keyboard->capture();
+        _mouse->capture();
+    }
 
-    // Recorremos el vector de estados al revés
+    // Acumulamos el tiempo del cuadro, sin recuperar más de _maxFrameTime
+    Ogre::Real frameTime = std::min(event.timeSinceLastFrame, _maxFrameTime);
+    _accumulator = std::min(_accumulator + frameTime, _maxFrameTime);
+    
+    // Lo que se reparte por cuadro se renueva antes de los pasos
     bool active = true;
     for (rev_it = _states.rbegin(); rev_it != _states.rend(); ++rev_it) {
-        (*rev_it)->update(event.timeSinceLastFrame, active);
+        (*rev_it)->newFrame(active);
+        active = false;
+    }
+    
+    // Simulamos en pasos fijos. Si se pide un cambio de estado paramos
+    // hasta el siguiente cuadro, como con un único update por cuadro
+    while (_accumulator >= _timeStep && _pendingOperations.empty() && !_exit) {
+        // Entregamos la entrada grabada para este paso. Si provoca un cambio
+        // de estado, el resto se entrega tras realizarlo
+        while (_pendingOperations.empty() && _inputRecorder->replayBatch(this, this));
+        
+        if (!_pendingOperations.empty())
+            break;
+        
+        // Recorremos el vector de estados al revés
+        PROFILE_ZONE("StateManager::frameStarted/step");
+        active = true;
+        for (rev_it = _states.rbegin(); rev_it != _states.rend(); ++rev_it) {
+            (*rev_it)->update(_timeStep, active);
+            active = false;
+        }
+        
+        _accumulator -= _timeStep;
+        _inputRecorder->endTick();
+        
+        if (_inputRecorder->hasEnded()) {
+            _log->logMessage("StateManager::frameStarted() -> Reproducción terminada: " +
+                             Ogre::StringConverter::toString(_inputRecorder->getTickNumber()) + " pasos, " +
+                             Ogre::StringConverter::toString(_inputRecorder->getFrameNumber()) + " cuadros, " +
+                             Ogre::StringConverter::toString(_inputRecorder->getMeanFrameTime()) + " ms de media, " +
+                             Ogre::StringConverter::toString(_inputRecorder->getMaxFrameTime()) + " ms como máximo");
+            _exit = true;
+        }
+    }
+    
+    // Interpolamos lo que se dibuja con el tiempo aún no simulado
+    PROFILE_ZONE("StateManager::frameStarted/interpolate");
+    Ogre::Real alpha = std::min(_accumulator / _timeStep, 1.0f);
+    active = true;
+    for (rev_it = _states.rbegin(); rev_it != _states.rend(); ++rev_it) {
+        (*rev_it)->interpolate(frameTime, alpha, active);
         active = false;
     }
 
@@ -29,12 +29,13 @@ Steering::Steering(const Ogre::Vector3& linear,
 
 
 // Operadores
-bool Steering::operator == (const Steering& other) {
+bool Steering::operator == (const Steering& other) const {
     return _angular == other._angular && _linear == other._linear;
 }
 
-Steering& Steering::operator + (const Steering& other) {
-    return Steering(*this) += other;
+Steering Steering::operator + (const Steering& other) const {
+    Steering result(*this);
+    return result += other;
 }
 
 Steering& Steering::operator += (const Steering& other) {
@@ -44,8 +45,9 @@ Steering& Steering::operator += (const Steering& other) {
     return *this;
 }
 
-Steering& Steering::operator * (Ogre::Real f) {
-    return Steering(*this) *= f;
+Steering Steering::operator * (Ogre::Real f) const {
+    Steering result(*this);
+    return result *= f;
 }
 
 Steering& Steering::operator *= (Ogre::Real f) {
@@ -55,8 +57,9 @@ Steering& Steering::operator *= (Ogre::Real f) {
     return *this;
 }
 
-Steering& Steering::operator / (Ogre::Real f) {
-    return Steering(*this) /= f;
+Steering Steering::operator / (Ogre::Real f) const {
+    Steering result(*this);
+    return result /= f;
 }
 
 Steering& Steering::operator /= (Ogre::Real f) {
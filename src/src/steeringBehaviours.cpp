@@ -21,9 +21,9 @@
  */
 
 #include <iostream>
+#include <algorithm>
 
 #include "steeringBehaviours.h"
-#include "enemy.h"
 
 
 using std::cout;
@@ -35,17 +35,42 @@ SteeringBehaviour::SteeringBehaviour(Kinematic* character) {
     this->character = character;
 }
 
+Ogre::Vector3 SteeringBehaviour::predictPosition(const Ogre::Vector3& position,
+                                                 const Ogre::Vector3& velocity,
+                                                 Ogre::Real maxPrediction) const {
+    // Distancia hacia el objetivo
+    Ogre::Real distance = (position - character->getPosition()).length();
+    
+    // Recuperamos la velocidad del personaje
+    Ogre::Real speed = character->getVelocity().length();
+    
+    Ogre::Real prediction;
+    
+    // Comprobar si la velocidad es demasiado pequeña para predecir
+    if (speed <= distance / maxPrediction)
+        prediction = maxPrediction;
+    else
+        prediction = distance / speed;
+    
+    return position + velocity * prediction;
+}
+
 
 // SEEK
 
-Seek::Seek(Kinematic* character, Kinematic* target): SteeringBehaviour(character) {
+Seek::Seek(Kinematic* character, const Kinematic* target): SteeringBehaviour(character) {
     this->target = target;
     maxAcceleration = 1.0f;
 }
 
 void Seek::getSteering(Steering& steering) {
+    if (character != 0 && target != 0)
+        seek(target->getPosition(), steering);
+}
+
+void Seek::seek(const Ogre::Vector3& targetPosition, Steering& steering) const {
     // Dirección hacia el objetivo
-    Ogre::Vector3 linear = target->getPosition() - character->getPosition();
+    Ogre::Vector3 linear = targetPosition - character->getPosition();
     
     // Nos limitamos a la máxima aceleración
     linear.normalise();
@@ -59,30 +84,33 @@ void Seek::getSteering(Steering& steering) {
 
 // FLEE
 
-Flee::Flee(Kinematic* character, Kinematic* target): SteeringBehaviour(character) {
+Flee::Flee(Kinematic* character, const Kinematic* target): SteeringBehaviour(character) {
     this->target = target;
     maxAcceleration = 2.0f;
 }
 
 void Flee::getSteering(Steering& steering) {
-    if (character != 0 && target != 0) {
-        // Dirección huyendo del objetivo
-        Ogre::Vector3 linear = character->getPosition() - target->getPosition();
-        
-        // Nos limitamos a la máxima aceleración
-        linear.normalise();
-        linear *= maxAcceleration;
-        
-        // Actualizamos steering
-        steering.setLinear(linear);
-        steering.setAngular(0.0f);
-    }
+    if (character != 0 && target != 0)
+        flee(target->getPosition(), steering);
+}
+
+void Flee::flee(const Ogre::Vector3& targetPosition, Steering& steering) const {
+    // Dirección huyendo del objetivo
+    Ogre::Vector3 linear = character->getPosition() - targetPosition;
+    
+    // Nos limitamos a la máxima aceleración
+    linear.normalise();
+    linear *= maxAcceleration;
+    
+    // Actualizamos steering
+    steering.setLinear(linear);
+    steering.setAngular(0.0f);
 }
 
 
 // ARRIVE
 
-Arrive::Arrive(Kinematic* character, Kinematic* target): SteeringBehaviour(character) {
+Arrive::Arrive(Kinematic* character, const Kinematic* target): SteeringBehaviour(character) {
     this->target = target;
     maxAcceleration = 5.0f;
     targetRadius = 2.0f;
@@ -91,53 +119,55 @@ Arrive::Arrive(Kinematic* character, Kinematic* target): SteeringBehaviour(chara
 }
 
 void Arrive::getSteering(Steering& steering) {
-    if (character != 0 && target != 0) {
-        // Dirección hacia el objetivo
-        Ogre::Vector3 direction = target->getPosition() - character->getPosition();
-        Ogre::Real distance = direction.length();
-        
-        // Comprobar si hemos llegado
-        if (distance <= targetRadius) {
-            steering.setNone();
-            return;
-        }
-        
-        Ogre::Real targetSpeed;
-        
-        // Si estamos fuera del área de frenado, vamos a máxima velocidad
-        if (distance > slowRadius)
-            targetSpeed = character->getMaxSpeed();
-            
-        // Si no, calculamos una velocidad nueva
-        else
-            targetSpeed = character->getMaxSpeed() * distance / slowRadius;
-            
-        // Velocidad objetivo
-        Ogre::Vector3 targetVelocity;
-        targetVelocity = direction;
-        targetVelocity.normalise();
-        targetVelocity *= targetSpeed;
-        
-        // La aceleración trata de alcanzar la velocidad objetivo
-        Ogre::Vector3 linear = (targetVelocity - character->getVelocity()) / timeToTarget;
+    if (character != 0 && target != 0)
+        arrive(target->getPosition(), steering);
+}
 
-        // Comprobamos si sobrepasamos la aceleración máxima
-        if (linear.length() > maxAcceleration) {
-            linear.normalise();
-            linear *= maxAcceleration;
-        }
+void Arrive::arrive(const Ogre::Vector3& targetPosition, Steering& steering) const {
+    // Dirección hacia el objetivo
+    Ogre::Vector3 direction = targetPosition - character->getPosition();
+    Ogre::Real distance = direction.length();
+    
+    // Comprobar si hemos llegado
+    if (distance <= targetRadius) {
+        steering.setNone();
+        return;
+    }
+    
+    Ogre::Real targetSpeed;
+    
+    // Si estamos fuera del área de frenado, vamos a máxima velocidad
+    if (distance > slowRadius)
+        targetSpeed = character->getMaxSpeed();
+        
+    // Si no, calculamos una velocidad nueva
+    else
+        targetSpeed = character->getMaxSpeed() * distance / slowRadius;
         
-        // Actualizamos steering
-        steering.setLinear(linear);
-        steering.setAngular(0.0f);
+    // Velocidad objetivo
+    Ogre::Vector3 targetVelocity;
+    targetVelocity = direction;
+    targetVelocity.normalise();
+    targetVelocity *= targetSpeed;
+    
+    // La aceleración trata de alcanzar la velocidad objetivo
+    Ogre::Vector3 linear = (targetVelocity - character->getVelocity()) / timeToTarget;
+    
+    // Comprobamos si sobrepasamos la aceleración máxima
+    if (linear.length() > maxAcceleration) {
+        linear.normalise();
+        linear *= maxAcceleration;
     }
+    
+    // Actualizamos steering
+    steering.setLinear(linear);
+    steering.setAngular(0.0f);
 }
 
 
-
 // ALIGN
 
-Align::Align(Kinematic* character, Kinematic* target): SteeringBehaviour(character) {
+Align::Align(Kinematic* character, const Kinematic* target): SteeringBehaviour(character) {
     this->target = target;
     maxAngularAcceleration = 4.0f;
     maxRotation = 3.0f;
@@ -147,9 +177,13 @@ Align::Align(Kinematic* character, Kinematic* target): SteeringBehaviour(charact
 }
 
 void Align::getSteering(Steering& steering) {
+    if (character != 0 && target != 0)
+        align(target->getOrientation(), steering);
+}
+
+void Align::align(Ogre::Real targetOrientation, Steering& steering) const {
     // Tomamos la dirección hacia el objetivo
-    Ogre::Real rotation = target->getOrientation() - character->getOrientation();
-    
+    Ogre::Real rotation = targetOrientation - character->getOrientation();
     
     // Mapeamos el resultado al intervalo (-pi, pi)
     rotation = mapToRange(rotation);
@@ -201,137 +235,84 @@ Ogre::Real Align::mapToRange(Ogre::Real angle) {
 }
 
 
-
 // VELOCITYMATCH
 
-VelocityMatch::VelocityMatch(Kinematic* character, Kinematic* target): SteeringBehaviour(character) {
+VelocityMatch::VelocityMatch(Kinematic* character, const Kinematic* target): SteeringBehaviour(character) {
     this->target = target;
     maxAcceleration = 0.2f;
     timeToTarget = 0.1f;
 }
 
 void VelocityMatch::getSteering(Steering& steering) {
-    if (character != 0 && target != 0) {
-        // La aceleración trata de llegar a la velocidad del objetivo
-        Ogre::Vector3 linear = target->getVelocity() - character->getVelocity();
-        linear /= timeToTarget;
-        
-        // Comprobamos si llevamos demasiada aceleración
-        if (linear.length() > maxAcceleration) {
-            linear.normalise();
-            linear *= maxAcceleration;
-        }
-        
-        // Actualizamos steering
-        steering.setLinear(linear);
-        steering.setAngular(0.0f);
-    }
+    if (character != 0 && target != 0)
+        matchVelocity(target->getVelocity(), steering);
 }
 
+void VelocityMatch::matchVelocity(const Ogre::Vector3& targetVelocity, Steering& steering) const {
+    // La aceleración trata de llegar a la velocidad del objetivo
+    Ogre::Vector3 linear = targetVelocity - character->getVelocity();
+    linear /= timeToTarget;
+    
+    // Comprobamos si llevamos demasiada aceleración
+    if (linear.length() > maxAcceleration) {
+        linear.normalise();
+        linear *= maxAcceleration;
+    }
+    
+    // Actualizamos steering
+    steering.setLinear(linear);
+    steering.setAngular(0.0f);
+}
 
 
 // PURSUE
 
-Pursue::Pursue(Kinematic* character, Kinematic* target): Seek(character) {
-    this->target = target;
+Pursue::Pursue(Kinematic* character, const Kinematic* target): Seek(character, target) {
     maxPrediction = 1.0f;
 }
 
 void Pursue::getSteering(Steering& steering) {
     if (character != 0 && target != 0) {
-        // 1. Calculamos el objetivo para delegar en seek
-        
-        // Distancia hacia el objetivo
-        Ogre::Vector3 direction = target->getPosition() - character->getPosition();
-        Ogre::Real distance = direction.length();
-        
-        // Recuperamos la velocidad del personaje
-        Ogre::Real speed = character->getVelocity().length();
-        
-        Ogre::Real prediction;
-        
-        // Comprobar si la velocidad es demasiado pequeña para predecir
-        if (speed <= distance / maxPrediction)
-            prediction = maxPrediction;
-        else
-            prediction = distance / speed;
-            
-        // Creamos un Steering nuevo para Seek
-        Kinematic explicitTarget = *target;
-        Ogre::Vector3 position = target->getPosition() + target->getVelocity() * prediction;
-        Seek::target = &explicitTarget;
-        Seek::target->setPosition(position);
-        
-        // 2. Delegamos en Seek
-        Seek::getSteering(steering);
+        // Buscamos la posición futura del objetivo
+        seek(predictPosition(target->getPosition(), target->getVelocity(), maxPrediction), steering);
     }
 }
 
-Evade::Evade(Kinematic* character, Kinematic* target): Flee(character) {
-    this->target = target;
+
+// EVADE
+
+Evade::Evade(Kinematic* character, const Kinematic* target): Flee(character, target) {
     maxPrediction = 1.0f;
 }
 
 void Evade::getSteering(Steering& steering) {
     if (character != 0 && target != 0) {
-        // 1. Calculamos el objetivo para delegar en flee
-        
-        // Distancia hacia el objetivo
-        Ogre::Vector3 direction = target->getPosition() - character->getPosition();
-        Ogre::Real distance = direction.length();
-        
-        // Recuperamos la velocidad del personaje
-        Ogre::Real speed = character->getVelocity().length();
-        
-        Ogre::Real prediction;
-        
-        // Comprobar si la velocidad es demasiado pequeña para predecir
-        if (speed <= distance / maxPrediction)
-            prediction = maxPrediction;
-        else
-            prediction = distance / speed;
-            
-        // Creamos un target nuevo para Seek
-        Kinematic explicitTarget = *target;
-        Ogre::Vector3 position = target->getPosition() + target->getVelocity() * prediction;
-        Flee::target = &explicitTarget;
-        Flee::target->setPosition(position);
-        
-        // 2. Delegamos en Seek
-        Flee::getSteering(steering);
+        // Huimos de la posición futura del objetivo
+        flee(predictPosition(target->getPosition(), target->getVelocity(), maxPrediction), steering);
     }
 }
 
 
-
 // FACE
 
-Face::Face(Kinematic* character, Kinematic* target): Align(character) {
-    this->target = target;
-}
+Face::Face(Kinematic* character, const Kinematic* target): Align(character, target) {}
 
 void Face::getSteering(Steering& steering) {
-    if (character != 0 && target != 0) {
-        // 1. Calculamos el objetivo para delegar en Align
-        
-        // Dirección del objetivo
-        Ogre::Vector3 direction = target->getPosition() - character->getPosition();
-        
-        // Si la dirección es 0, no hacemos nada
-        if (direction.squaredLength() == 0)
-            return;
-        
-        // Creamos un target nuevo para Align
-        Kinematic explicitTarget = *target;
-        Ogre::Real orientation = atan2(direction.x, direction.z);
-        Align::target = &explicitTarget;
-        Align::target->setOrientation(orientation);
-        
-        // 2. Delegamos en Align
-        Align::getSteering(steering);
-    }
+    if (character != 0 && target != 0)
+        face(target->getPosition(), steering);
 }
 
+void Face::face(const Ogre::Vector3& targetPosition, Steering& steering) const {
+    // Dirección del objetivo
+    Ogre::Vector3 direction = targetPosition - character->getPosition();
+    
+    // Si la dirección es 0, no hacemos nada
+    if (direction.squaredLength() == 0)
+        return;
+    
+    // Miramos hacia el objetivo
+    align(atan2(direction.x, direction.z), steering);
+}
 
 
 // WANDER
@@ -342,6 +323,7 @@ Wander::Wander(Kinematic* character): Face(character) {
     wanderRate = 500.0f;
     wanderOrientation = 0.0f;
     maxAcceleration = 10.0f;
+    _randomState = rand();
 }
 
 void Wander::getSteering(Steering& steering) {
@@ -362,28 +344,32 @@ void Wander::getSteering(Steering& steering) {
         wanderTarget += wanderDirection * wanderRadius;
         
         // 2. Delegamos en Face
-        target = new Kinematic(wanderTarget);
-        Face::getSteering(steering);
+        face(wanderTarget, steering);
         
         // 3. Linear al máximo
-        
-        // Actualizamos steering
         steering.setLinear(characterDirection * maxAcceleration);
-        
-        
-        delete target;
     }
 }
 
+Ogre::Real Wander::randomBinomial() {
+    // Generador congruencial lineal, en [-1, 1]
+    Ogre::Real a = (_randomState = _randomState * 1103515245u + 12345u) >> 8;
+    Ogre::Real b = (_randomState = _randomState * 1103515245u + 12345u) >> 8;
+    
+    return (a - b) / 16777216.0f;
+}
+
 
 
 // COLLISION AVOIDANCE
 
-CollisionAvoidance::CollisionAvoidance(Kinematic* character, const std::vector<Enemy*>& targets, Enemy* myself): Flee(character) {
-    this->targets = targets;
+CollisionAvoidance::CollisionAvoidance(Kinematic* character, const NeighbourGrid* grid, const void* myself): Flee(character) {
+    this->grid = grid;
     this->myself = myself;
     maxAcceleration = 2.0f;
     radius = 1.0f;
+    neighbourDistance = 5.0f;
+    maxNeighbours = 8;
 }
 
 void CollisionAvoidance::getSteering(Steering& steering) {
@@ -400,56 +386,55 @@ void CollisionAvoidance::getSteering(Steering& steering) {
     Ogre::Vector3 posDifference;
     Ogre::Vector3 velDifference;
     
-    Kinematic* selTarget = 0;
+    const NeighbourGrid::Agent* selTarget = 0;
     Ogre::Real selSeparation = 0.0f;
     Ogre::Real selNeededSeparation = 0.0f;
     Ogre::Vector3 selPosDifference;
     Ogre::Vector3 selVelDifference;
     
-    // Para cada enemigo
-    std::vector<Enemy*>::iterator i;
-    for (i = targets.begin(); i != targets.end(); ++i) {
-        if (*i != myself) {
-            target = &((*i)->getKinematic());
-            
-            // 1. Comprobamos que no colisionamos
-            
-            // Mínima distancia
-            neededSeparation = 2 * radius;
-            
-            // Distancia al objetivo
-            posDifference = target->getPosition() - character->getPosition();
-            posDistance = posDifference.length();
-            
-            // Si estamos colisionando, huimos
-            if (posDistance <= neededSeparation) {
-                Flee::getSteering(steering);
-                return;
-            }
-            
-            // 2. Comprobamos si colisionamos en un futuro
-            velDifference = target->getVelocity() - character->getVelocity();
-            velDistance = velDifference.length();
-            time = (posDifference.dotProduct(velDifference)) / (velDistance * velDistance);
-            
-            if (time > 0.5f)
-                continue;
-                
-            // Solo si tenemos tiempo de colisión y es mínimo
-            if (time > 0.0f && time < minTime)
-                minTime = time;
-            else
-                continue;
-            
-            // Calculamos la separación en ese momento
-            separation = posDistance - velDistance * minTime;
+    // Para cada vecino cercano (la rejilla ya descarta al propio personaje)
+    grid->findNeighbours(myself, character->getPosition(), neighbourDistance, maxNeighbours, _neighbours);
+    
+    for (NeighbourGrid::Neighbours::iterator i = _neighbours.begin(); i != _neighbours.end(); ++i) {
+        const NeighbourGrid::Agent& agent = grid->getAgent(i->agent);
+        
+        // 1. Comprobamos que no colisionamos
+        
+        // Mínima distancia
+        neededSeparation = 2 * radius;
+        
+        // Distancia al objetivo
+        posDifference = agent.position - character->getPosition();
+        posDistance = posDifference.length();
+        
+        // Si estamos colisionando, huimos
+        if (posDistance <= neededSeparation) {
+            flee(agent.position, steering);
+            return;
+        }
+        
+        // 2. Comprobamos si colisionamos en un futuro
+        velDifference = agent.velocity - character->getVelocity();
+        velDistance = velDifference.length();
+        time = (posDifference.dotProduct(velDifference)) / (velDistance * velDistance);
+        
+        if (time > 0.5f)
+            continue;
             
-            // Si es el más corto y va a colisionar lo guardamos
-            if (separation <= neededSeparation) {
-                selTarget = target;
-                selSeparation = separation;
-                selNeededSeparation = neededSeparation;
-            }
+        // Solo si tenemos tiempo de colisión y es mínimo
+        if (time > 0.0f && time < minTime)
+            minTime = time;
+        else
+            continue;
+        
+        // Calculamos la separación en ese momento
+        separation = posDistance - velDistance * minTime;
+        
+        // Si es el más corto y va a colisionar lo guardamos
+        if (separation <= neededSeparation) {
+            selTarget = &agent;
+            selSeparation = separation;
+            selNeededSeparation = neededSeparation;
         }
     }
 
@@ -463,7 +448,7 @@ void CollisionAvoidance::getSteering(Steering& steering) {
     
     // La nueva posición del personaje al cabo del tiempo
     Ogre::Vector3 charPos = character->getPosition() + character->getVelocity() * minTime;
-    Ogre::Vector3 targetPos = selTarget->getPosition() + selTarget->getVelocity() * minTime;
+    Ogre::Vector3 targetPos = selTarget->position + selTarget->velocity * minTime;
     
     // Dirección desde el objetivo al personaje
     posDifference = charPos - targetPos;
@@ -487,7 +472,9 @@ void CollisionAvoidance::getSteering(Steering& steering) {
 
 FollowPath::FollowPath(Kinematic* character, NavigationMesh::PointPath* path): Arrive(character) {
     this->path = path;
-    pathOffset = 0.5f;
+    pathOffset = 1.0f;
+    searchSegments = 3;
+    currentSegment = 0;
     
     // De Arribve
     targetRadius = 0.1f;
@@ -495,54 +482,86 @@ FollowPath::FollowPath(Kinematic* character, NavigationMesh::PointPath* path): A
     maxAcceleration = 7.0f;
 }
 
+void FollowPath::setPath(NavigationMesh::PointPath* path) {
+    this->path = path;
+    currentSegment = 0;
+}
+
 void FollowPath::getSteering(Steering& steering) {
-    // 1. Calculamos el target para delegar en Seek
-    target = new Kinematic(findTargetInPath());
+    // Llegamos al punto del camino que está pathOffset unidades por delante
+    arrive(findTargetInPath(), steering);
+}
+
+Ogre::Real FollowPath::projectOnPath(const Ogre::Vector3& point) {
+    int lastSegment = std::min(currentSegment + searchSegments, (int)path->size() - 1);
+    
+    Ogre::Real minDistance = Ogre::Math::POS_INFINITY;
+    Ogre::Real offset = 0.0f;
+    int closestSegment = currentSegment;
+    
+    // Recorremos los segmentos cercanos buscando la proyección más próxima
+    for (int i = currentSegment; i < lastSegment; ++i) {
+        const Ogre::Vector3& pointA = (*path)[i];
+        Ogre::Vector3 segment = (*path)[i + 1] - pointA;
+        Ogre::Real segmentLength = segment.squaredLength();
+        
+        Ogre::Real t = 0.0f;
+        if (segmentLength > 0.0f)
+            t = Ogre::Math::Clamp((point - pointA).dotProduct(segment) / segmentLength, 0.0f, 1.0f);
+        
+        Ogre::Real distance = (pointA + segment * t - point).squaredLength();
+        
+        // En caso de empate preferimos el segmento más avanzado
+        if (distance <= minDistance) {
+            minDistance = distance;
+            closestSegment = i;
+            offset = t * Ogre::Math::Sqrt(segmentLength);
+        }
+    }
     
-    // 2. Delegamos en Seek
-    Arrive::getSteering(steering);
+    currentSegment = closestSegment;
     
-    delete target;
+    return offset;
 }
 
-Ogre::Vector3 FollowPath::findClosestPathPoint(const Ogre::Vector3& point) {
-    Ogre::Real minDistance = Ogre::Math::POS_INFINITY;
-    Ogre::Vector3 closestPoint = *(path->begin());
+Ogre::Vector3 FollowPath::getPathPoint(Ogre::Real distance) {
+    int size = path->size();
     
-    // Recorremos la lista de puntos buscando el más cercano
-    for (NavigationMesh::PointPath::iterator i = path->begin(); i != path->end(); ++i) {
-        // Calculamos la nueva distancia
-        Ogre::Vector3 direction = point - *i;
+    // Recorremos el camino desde el inicio del segmento actual
+    for (int i = currentSegment; i < size - 1; ++i) {
+        const Ogre::Vector3& pointA = (*path)[i];
+        Ogre::Vector3 segment = (*path)[i + 1] - pointA;
+        Ogre::Real segmentLength = segment.length();
         
-        if (direction.squaredLength() < minDistance) {
-            closestPoint = *i;
-            minDistance = direction.squaredLength();
-        }
+        if (distance < segmentLength)
+            return pointA + segment * (distance / segmentLength);
+        
+        distance -= segmentLength;
     }
     
-    return closestPoint;
+    return path->back();
 }
 
 Ogre::Vector3 FollowPath::findTargetInPath() {
-    Ogre::Real minDistance = Ogre::Math::POS_INFINITY;
-    NavigationMesh::PointPath::iterator closestPointIt = path->begin();
+    int size = path->size();
     
-    // Recorremos la lista de puntos buscando el más cercano
-    for (NavigationMesh::PointPath::iterator i = path->begin(); i != path->end(); ++i) {
-        // Calculamos la nueva distancia
-        Ogre::Vector3 direction = character->getPosition() - *i;
-        
-        if (direction.squaredLength() < minDistance) {
-            minDistance = direction.squaredLength();
-            closestPointIt = i;
-        }
-    }
+    if (size == 0)
+        return character->getPosition();
     
-    NavigationMesh::PointPath::iterator targetIt = closestPointIt;
-    ++targetIt;
+    if (currentSegment >= size - 1)
+        return path->back();
     
-    if (targetIt == path->end())
-        return *closestPointIt;
+    // Avanzamos pathOffset unidades a lo largo del camino desde la proyección
+    const Ogre::Vector3& position = character->getPosition();
+    Ogre::Vector3 targetPoint = getPathPoint(projectOnPath(position) + pathOffset);
+    
+    // Si el camino vuelve sobre sí mismo el objetivo puede quedar junto al
+    // personaje y Arrive lo detendría: forzamos el avance
+    while (currentSegment < size - 2 &&
+           (targetPoint - position).squaredLength() <= targetRadius * targetRadius) {
+        ++currentSegment;
+        targetPoint = getPathPoint(pathOffset);
+    }
     
-    return *targetIt;
+    return targetPoint;
 }
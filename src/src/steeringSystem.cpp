@@ -0,0 +1,452 @@
+/*
+ * This file is part of SionTower.
+ *
+ * 
+ * David Saltares M&aacute;rquez (C) 2011
+ * <david.saltares@gmail.com>
+ *
+ * 
+ * SionTower examples are free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License ad
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) ant later version.
+ *
+ * SionTower examples are distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SionTower examples.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cmath>
+#include <algorithm>
+
+#include "steeringSystem.h"
+#include "velocityObstacles.h"
+
+// Mueve el último elemento a la posición index y reduce el vector
+template <typename T>
+static void eraseSwap(std::vector<T>& values, int index) {
+    values[index] = values.back();
+    values.pop_back();
+}
+
+// Limita la aceleración lineal del steering
+static void clampLinear(Steering& steering, Ogre::Real maxAcceleration) {
+    Ogre::Real acceleration = steering.getLinear().length();
+    Ogre::Real limit = std::max(maxAcceleration, 0.0f);
+    
+    if (acceleration > limit)
+        steering.setLinear(steering.getLinear() * (limit / acceleration));
+}
+
+SteeringSystem::SteeringSystem(VelocityObstacles* velocityObstacles): _velocityObstacles(velocityObstacles) {}
+
+int SteeringSystem::addAgent(Kinematic* kinematic, const void* owner, Ogre::Real radius) {
+    int handle;
+    
+    if (_freeHandles.empty()) {
+        handle = _indices.size();
+        _indices.push_back(0);
+    }
+    else {
+        handle = _freeHandles.back();
+        _freeHandles.pop_back();
+    }
+    
+    _indices[handle] = _handles.size();
+    _handles.push_back(handle);
+    _kinematics.push_back(kinematic);
+    _owners.push_back(owner);
+    _radius.push_back(radius);
+    
+    // Sin petición hasta que la pida
+    _active.push_back(0.0f);
+    _previous.push_back(0.0f);
+    _seek.push_back(0.0f);
+    _targetX.push_back(0.0f);
+    _targetY.push_back(0.0f);
+    _targetZ.push_back(0.0f);
+    _maxAcceleration.push_back(0.0f);
+    _targetRadius.push_back(0.0f);
+    _slowRadius.push_back(0.0f);
+    _timeToTarget.push_back(1.0f);
+    
+    // El estado cinemático se copia en cada update
+    int size = _handles.size();
+    _positionX.resize(size);
+    _positionY.resize(size);
+    _positionZ.resize(size);
+    _velocityX.resize(size);
+    _velocityY.resize(size);
+    _velocityZ.resize(size);
+    _orientation.resize(size);
+    _maxSpeed.resize(size);
+    _linearX.resize(size);
+    _linearY.resize(size);
+    _linearZ.resize(size);
+    _desiredX.resize(size);
+    _desiredY.resize(size);
+    _desiredZ.resize(size);
+    
+    return handle;
+}
+
+void SteeringSystem::removeAgent(int agent) {
+    int index = _indices[agent];
+    
+    // El último agente ocupa el hueco
+    _indices[_handles.back()] = index;
+    eraseSwap(_handles, index);
+    eraseSwap(_kinematics, index);
+    eraseSwap(_owners, index);
+    eraseSwap(_radius, index);
+    eraseSwap(_active, index);
+    eraseSwap(_previous, index);
+    eraseSwap(_seek, index);
+    eraseSwap(_targetX, index);
+    eraseSwap(_targetY, index);
+    eraseSwap(_targetZ, index);
+    eraseSwap(_maxAcceleration, index);
+    eraseSwap(_targetRadius, index);
+    eraseSwap(_slowRadius, index);
+    eraseSwap(_timeToTarget, index);
+    
+    int size = _handles.size();
+    _positionX.resize(size);
+    _positionY.resize(size);
+    _positionZ.resize(size);
+    _velocityX.resize(size);
+    _velocityY.resize(size);
+    _velocityZ.resize(size);
+    _orientation.resize(size);
+    _maxSpeed.resize(size);
+    _linearX.resize(size);
+    _linearY.resize(size);
+    _linearZ.resize(size);
+    _desiredX.resize(size);
+    _desiredY.resize(size);
+    _desiredZ.resize(size);
+    
+    // Sus comportamientos añadidos dejan de ser válidos
+    for (int i = _behaviours.size() - 1; i >= 0; --i)
+        if (_behaviours[i].agent == agent)
+            eraseSwap(_behaviours, i);
+    
+    for (int i = _previousBehaviours.size() - 1; i >= 0; --i)
+        if (_previousBehaviours[i].agent == agent)
+            eraseSwap(_previousBehaviours, i);
+    
+    _freeHandles.push_back(agent);
+}
+
+int SteeringSystem::request(int agent,
+                            const Ogre::Vector3& target,
+                            Ogre::Real maxAcceleration) {
+    int index = _indices[agent];
+    
+    _active[index] = 1.0f;
+    _targetX[index] = target.x;
+    _targetY[index] = target.y;
+    _targetZ[index] = target.z;
+    _maxAcceleration[index] = maxAcceleration;
+    
+    return index;
+}
+
+void SteeringSystem::seek(int agent, const Ogre::Vector3& target, Ogre::Real maxAcceleration) {
+    int index = request(agent, target, maxAcceleration);
+    
+    _seek[index] = 1.0f;
+    _targetRadius[index] = 0.0f;
+    _slowRadius[index] = 0.0f;
+    _timeToTarget[index] = 1.0f;
+}
+
+void SteeringSystem::arrive(int agent,
+                            const Ogre::Vector3& target,
+                            Ogre::Real maxAcceleration,
+                            Ogre::Real targetRadius,
+                            Ogre::Real slowRadius,
+                            Ogre::Real timeToTarget) {
+    int index = request(agent, target, maxAcceleration);
+    
+    _seek[index] = 0.0f;
+    _targetRadius[index] = targetRadius;
+    _slowRadius[index] = slowRadius;
+    _timeToTarget[index] = timeToTarget;
+}
+
+void SteeringSystem::followPath(int agent, FollowPath& followPath) {
+    // El progreso sobre el camino es propio de cada agente: sólo el
+    // objetivo pasa al cálculo conjunto
+    arrive(agent,
+           followPath.findTargetInPath(),
+           followPath.maxAcceleration,
+           followPath.targetRadius,
+           followPath.slowRadius,
+           followPath.timeToTarget);
+}
+
+void SteeringSystem::addBehaviour(int agent,
+                                  SteeringBehaviour* behaviour,
+                                  int priority,
+                                  Ogre::Real weight,
+                                  Ogre::Real budget) {
+    Behaviour entry;
+    entry.agent = agent;
+    entry.priority = priority;
+    entry.behaviour = behaviour;
+    entry.weight = weight;
+    entry.budget = budget;
+    
+    _behaviours.push_back(entry);
+}
+
+void SteeringSystem::repeat(int agent) {
+    int index = _indices[agent];
+    _active[index] = _previous[index];
+    
+    for (std::vector<Behaviour>::const_iterator i = _previousBehaviours.begin(); i != _previousBehaviours.end(); ++i)
+        if (i->agent == agent)
+            _behaviours.push_back(*i);
+}
+
+void SteeringSystem::update(Ogre::Real deltaT) {
+    if (_handles.empty())
+        return;
+    
+    gather();
+    computeLinear();
+    arbitrate();
+    integrate(deltaT);
+    avoid(deltaT);
+    scatter();
+    
+    // Las peticiones sólo valen para este frame, pero se recuerdan por si
+    // el agente pide repetirlas
+    _previous.swap(_active);
+    std::fill(_active.begin(), _active.end(), 0.0f);
+    _previousBehaviours.swap(_behaviours);
+    _behaviours.clear();
+}
+
+void SteeringSystem::gather() {
+    int size = _handles.size();
+    
+    for (int i = 0; i < size; ++i) {
+        const Kinematic* kinematic = _kinematics[i];
+        const Ogre::Vector3& position = kinematic->getPosition();
+        const Ogre::Vector3& velocity = kinematic->getVelocity();
+        
+        _positionX[i] = position.x;
+        _positionY[i] = position.y;
+        _positionZ[i] = position.z;
+        _velocityX[i] = velocity.x;
+        _velocityY[i] = velocity.y;
+        _velocityZ[i] = velocity.z;
+        _orientation[i] = kinematic->getOrientation();
+        _maxSpeed[i] = kinematic->getMaxSpeed();
+    }
+}
+
+void SteeringSystem::computeLinear() {
+    int size = _handles.size();
+    
+    const Ogre::Real* positionX = &_positionX[0];
+    const Ogre::Real* positionY = &_positionY[0];
+    const Ogre::Real* positionZ = &_positionZ[0];
+    const Ogre::Real* velocityX = &_velocityX[0];
+    const Ogre::Real* velocityY = &_velocityY[0];
+    const Ogre::Real* velocityZ = &_velocityZ[0];
+    const Ogre::Real* maxSpeed = &_maxSpeed[0];
+    const Ogre::Real* seek = &_seek[0];
+    const Ogre::Real* targetX = &_targetX[0];
+    const Ogre::Real* targetY = &_targetY[0];
+    const Ogre::Real* targetZ = &_targetZ[0];
+    const Ogre::Real* maxAcceleration = &_maxAcceleration[0];
+    const Ogre::Real* targetRadius = &_targetRadius[0];
+    const Ogre::Real* slowRadius = &_slowRadius[0];
+    const Ogre::Real* timeToTarget = &_timeToTarget[0];
+    Ogre::Real* linearX = &_linearX[0];
+    Ogre::Real* linearY = &_linearY[0];
+    Ogre::Real* linearZ = &_linearZ[0];
+    
+    // Seek y Arrive sin saltos: ambos se calculan y se selecciona
+    for (int i = 0; i < size; ++i) {
+        Ogre::Real dx = targetX[i] - positionX[i];
+        Ogre::Real dy = targetY[i] - positionY[i];
+        Ogre::Real dz = targetZ[i] - positionZ[i];
+        Ogre::Real distance = std::sqrt(dx * dx + dy * dy + dz * dz);
+        Ogre::Real invDistance = (distance > 0.0f)? 1.0f / distance : 0.0f;
+        
+        // Arrive: velocidad objetivo máxima fuera de slowRadius
+        Ogre::Real targetSpeed = maxSpeed[i] * std::min(distance / std::max(slowRadius[i], 0.000001f), 1.0f);
+        Ogre::Real speedFactor = targetSpeed * invDistance;
+        Ogre::Real invTime = 1.0f / timeToTarget[i];
+        Ogre::Real ax = (dx * speedFactor - velocityX[i]) * invTime;
+        Ogre::Real ay = (dy * speedFactor - velocityY[i]) * invTime;
+        Ogre::Real az = (dz * speedFactor - velocityZ[i]) * invTime;
+        Ogre::Real acceleration = std::sqrt(ax * ax + ay * ay + az * az);
+        Ogre::Real clamp = (acceleration > maxAcceleration[i])? maxAcceleration[i] / acceleration : 1.0f;
+        
+        // Dentro de targetRadius Arrive no acelera (y la velocidad se anula)
+        clamp = (distance <= targetRadius[i])? 0.0f : clamp;
+        
+        // Seek: dirección al objetivo a máxima aceleración
+        Ogre::Real seekFactor = maxAcceleration[i] * invDistance;
+        
+        linearX[i] = (seek[i] > 0.0f)? dx * seekFactor : ax * clamp;
+        linearY[i] = (seek[i] > 0.0f)? dy * seekFactor : ay * clamp;
+        linearZ[i] = (seek[i] > 0.0f)? dz * seekFactor : az * clamp;
+    }
+}
+
+void SteeringSystem::arbitrate() {
+    if (_behaviours.empty())
+        return;
+    
+    // Agrupamos por agente y, dentro de cada uno, por prioridad
+    std::sort(_behaviours.begin(), _behaviours.end());
+    
+    std::vector<Behaviour>::const_iterator i = _behaviours.begin();
+    
+    while (i != _behaviours.end()) {
+        int agent = i->agent;
+        int index = _indices[agent];
+        Ogre::Real maxAcceleration = _maxAcceleration[index];
+        Steering total;
+        bool saturated = false;
+        
+        // Sin petición el agente no se mueve en este frame
+        if (_active[index] == 0.0f) {
+            while (i != _behaviours.end() && i->agent == agent)
+                ++i;
+            
+            continue;
+        }
+        
+        while (i != _behaviours.end() && i->agent == agent) {
+            int priority = i->priority;
+            Steering group;
+            
+            // Se mezclan según su peso los comportamientos del grupo. Los
+            // de menor prioridad ya no se evalúan si estamos saturados.
+            for (; i != _behaviours.end() && i->agent == agent && i->priority == priority; ++i) {
+                if (saturated)
+                    continue;
+                
+                Steering steering;
+                i->behaviour->getSteering(steering);
+                clampLinear(steering, i->budget);
+                group += steering * i->weight;
+            }
+            
+            if (saturated)
+                continue;
+            
+            // El grupo sólo dispone de lo que dejan libre los anteriores
+            clampLinear(group, maxAcceleration - total.getLinear().length());
+            total += group;
+            saturated = total.getLinear().length() >= maxAcceleration * 0.999f;
+        }
+        
+        // La petición ocupa lo que quede
+        Steering request(Ogre::Vector3(_linearX[index], _linearY[index], _linearZ[index]));
+        clampLinear(request, saturated? 0.0f : maxAcceleration - total.getLinear().length());
+        total += request;
+        
+        _linearX[index] = total.getLinear().x;
+        _linearY[index] = total.getLinear().y;
+        _linearZ[index] = total.getLinear().z;
+    }
+}
+
+void SteeringSystem::integrate(Ogre::Real deltaT) {
+    int size = _handles.size();
+    
+    const Ogre::Real* active = &_active[0];
+    const Ogre::Real* maxSpeed = &_maxSpeed[0];
+    const Ogre::Real* linearX = &_linearX[0];
+    const Ogre::Real* linearY = &_linearY[0];
+    const Ogre::Real* linearZ = &_linearZ[0];
+    const Ogre::Real* velocityX = &_velocityX[0];
+    const Ogre::Real* velocityY = &_velocityY[0];
+    const Ogre::Real* velocityZ = &_velocityZ[0];
+    Ogre::Real* positionX = &_positionX[0];
+    Ogre::Real* positionY = &_positionY[0];
+    Ogre::Real* positionZ = &_positionZ[0];
+    Ogre::Real* desiredX = &_desiredX[0];
+    Ogre::Real* desiredY = &_desiredY[0];
+    Ogre::Real* desiredZ = &_desiredZ[0];
+    
+    // Misma regla que Kinematic::update: primero la posición con la
+    // velocidad anterior y después la velocidad
+    for (int i = 0; i < size; ++i) {
+        Ogre::Real step = deltaT * active[i];
+        positionX[i] += velocityX[i] * step;
+        positionY[i] += velocityY[i] * step;
+        positionZ[i] += velocityZ[i] * step;
+        
+        bool stop = linearX[i] == 0.0f && linearY[i] == 0.0f && linearZ[i] == 0.0f;
+        Ogre::Real vx = stop? 0.0f : velocityX[i] + linearX[i] * deltaT;
+        Ogre::Real vy = stop? 0.0f : velocityY[i] + linearY[i] * deltaT;
+        Ogre::Real vz = stop? 0.0f : velocityZ[i] + linearZ[i] * deltaT;
+        
+        Ogre::Real speedSq = vx * vx + vy * vy + vz * vz;
+        Ogre::Real limit = maxSpeed[i] * maxSpeed[i];
+        Ogre::Real scale = (speedSq > limit)? maxSpeed[i] / std::sqrt(speedSq) : 1.0f;
+        
+        // Los agentes sin petición conservan su velocidad
+        desiredX[i] = (active[i] > 0.0f)? vx * scale : velocityX[i];
+        desiredY[i] = (active[i] > 0.0f)? vy * scale : velocityY[i];
+        desiredZ[i] = (active[i] > 0.0f)? vz * scale : velocityZ[i];
+    }
+}
+
+void SteeringSystem::avoid(Ogre::Real deltaT) {
+    if (!_velocityObstacles)
+        return;
+    
+    int size = _handles.size();
+    
+    // La velocidad deseada se corrige para no chocar con los vecinos (se
+    // aplicará en el siguiente frame)
+    for (int i = 0; i < size; ++i) {
+        if (_active[i] == 0.0f)
+            continue;
+        
+        Ogre::Vector3 velocity;
+        _velocityObstacles->computeVelocity(_owners[i],
+                                            Ogre::Vector3(_positionX[i], _positionY[i], _positionZ[i]),
+                                            Ogre::Vector3(_velocityX[i], _velocityY[i], _velocityZ[i]),
+                                            _radius[i],
+                                            Ogre::Vector3(_desiredX[i], _desiredY[i], _desiredZ[i]),
+                                            _maxSpeed[i],
+                                            deltaT,
+                                            velocity);
+        _desiredX[i] = velocity.x;
+        _desiredY[i] = velocity.y;
+        _desiredZ[i] = velocity.z;
+    }
+}
+
+void SteeringSystem::scatter() {
+    int size = _handles.size();
+    
+    for (int i = 0; i < size; ++i) {
+        if (_active[i] == 0.0f)
+            continue;
+        
+        // La orientación sigue a la velocidad
+        if (_desiredX[i] != 0.0f || _desiredZ[i] != 0.0f)
+            _orientation[i] = std::atan2(_desiredX[i], _desiredZ[i]);
+        
+        Kinematic* kinematic = _kinematics[i];
+        kinematic->setPosition(Ogre::Vector3(_positionX[i], _positionY[i], _positionZ[i]));
+        kinematic->setVelocity(Ogre::Vector3(_desiredX[i], _desiredY[i], _desiredZ[i]));
+        kinematic->setOrientation(_orientation[i]);
+    }
+}
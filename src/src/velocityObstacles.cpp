@@ -0,0 +1,254 @@
+/*
+ * This file is part of SionTower.
+ *
+ * 
+ * David Saltares M&aacute;rquez (C) 2011
+ * <david.saltares@gmail.com>
+ *
+ * 
+ * SionTower examples are free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License ad
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) ant later version.
+ *
+ * SionTower examples are distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SionTower examples.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cmath>
+#include <algorithm>
+
+#include "velocityObstacles.h"
+
+// Tolerancia para rectas paralelas
+static const Ogre::Real EPSILON = 0.00001f;
+
+VelocityObstacles::VelocityObstacles(const NeighbourGrid* grid,
+                                     Ogre::Real neighbourDistance,
+                                     int maxNeighbours,
+                                     Ogre::Real timeHorizon): _grid(grid),
+                                                              _neighbourDistance(neighbourDistance),
+                                                              _maxNeighbours(maxNeighbours),
+                                                              _timeHorizon(timeHorizon) {}
+
+void VelocityObstacles::computeVelocity(const void* owner,
+                                        const Ogre::Vector3& position,
+                                        const Ogre::Vector3& velocity,
+                                        Ogre::Real radius,
+                                        const Ogre::Vector3& preferred,
+                                        Ogre::Real maxSpeed,
+                                        Ogre::Real deltaT,
+                                        Ogre::Vector3& result) {
+    Ogre::Vector2 agentPosition(position.x, position.z);
+    Ogre::Vector2 agentVelocity(velocity.x, velocity.z);
+    Ogre::Vector2 preferredVelocity(preferred.x, preferred.z);
+    
+    _grid->findNeighbours(owner, position, _neighbourDistance, _maxNeighbours, _neighbours);
+    
+    // Un semiplano de velocidades permitidas por cada vecino
+    _lines.clear();
+    
+    Ogre::Real invTimeHorizon = 1.0f / _timeHorizon;
+    Ogre::Real invTimeStep = 1.0f / std::max(deltaT, 0.001f);
+    
+    for (NeighbourGrid::Neighbours::iterator i = _neighbours.begin(); i != _neighbours.end(); ++i) {
+        const NeighbourGrid::Agent& other = _grid->getAgent(i->agent);
+        
+        Ogre::Vector2 relativePosition = Ogre::Vector2(other.position.x, other.position.z) - agentPosition;
+        Ogre::Vector2 relativeVelocity = agentVelocity - Ogre::Vector2(other.velocity.x, other.velocity.z);
+        Ogre::Real distanceSq = i->distanceSq;
+        Ogre::Real combinedRadius = radius + other.radius;
+        Ogre::Real combinedRadiusSq = combinedRadius * combinedRadius;
+        
+        Line line;
+        Ogre::Vector2 u;
+        
+        if (distanceSq > combinedRadiusSq) {
+            // Sin colisión: vector desde el centro del círculo de corte
+            Ogre::Vector2 w = relativeVelocity - relativePosition * invTimeHorizon;
+            Ogre::Real wLengthSq = w.squaredLength();
+            Ogre::Real dotProduct = w.dotProduct(relativePosition);
+            
+            if (dotProduct < 0.0f && dotProduct * dotProduct > combinedRadiusSq * wLengthSq) {
+                // Proyectamos sobre el círculo de corte
+                Ogre::Real wLength = std::sqrt(wLengthSq);
+                Ogre::Vector2 unitW = w / wLength;
+                
+                line.direction = Ogre::Vector2(unitW.y, -unitW.x);
+                u = unitW * (combinedRadius * invTimeHorizon - wLength);
+            }
+            else {
+                // Proyectamos sobre el lado más cercano del cono
+                Ogre::Real leg = std::sqrt(distanceSq - combinedRadiusSq);
+                
+                if (relativePosition.crossProduct(w) > 0.0f) {
+                    line.direction = Ogre::Vector2(relativePosition.x * leg - relativePosition.y * combinedRadius,
+                                                   relativePosition.x * combinedRadius + relativePosition.y * leg) / distanceSq;
+                }
+                else {
+                    line.direction = -Ogre::Vector2(relativePosition.x * leg + relativePosition.y * combinedRadius,
+                                                    -relativePosition.x * combinedRadius + relativePosition.y * leg) / distanceSq;
+                }
+                
+                u = line.direction * relativeVelocity.dotProduct(line.direction) - relativeVelocity;
+            }
+        }
+        else {
+            // Ya colisionan: nos separamos en este mismo frame
+            Ogre::Vector2 w = relativeVelocity - relativePosition * invTimeStep;
+            Ogre::Real wLength = w.length();
+            Ogre::Vector2 unitW = (wLength > EPSILON)? w / wLength : Ogre::Vector2(0.0f, 1.0f);
+            
+            line.direction = Ogre::Vector2(unitW.y, -unitW.x);
+            u = unitW * (combinedRadius * invTimeStep - wLength);
+        }
+        
+        // Si el otro también se aparta cada uno corrige la mitad
+        line.point = agentVelocity + u * (other.avoiding? 0.5f : 1.0f);
+        _lines.push_back(line);
+    }
+    
+    Ogre::Vector2 newVelocity;
+    int lineFail = linearProgram2(_lines, maxSpeed, preferredVelocity, false, newVelocity);
+    
+    // Sin solución factible tomamos la que menos invade los semiplanos
+    if (lineFail < (int)_lines.size())
+        linearProgram3(lineFail, maxSpeed, newVelocity);
+    
+    result = Ogre::Vector3(newVelocity.x, 0.0f, newVelocity.y);
+}
+
+bool VelocityObstacles::linearProgram1(const std::vector<Line>& lines,
+                                       int lineNo,
+                                       Ogre::Real radius,
+                                       const Ogre::Vector2& optVelocity,
+                                       bool directionOpt,
+                                       Ogre::Vector2& result) {
+    const Line& line = lines[lineNo];
+    Ogre::Real dotProduct = line.point.dotProduct(line.direction);
+    Ogre::Real discriminant = dotProduct * dotProduct + radius * radius - line.point.squaredLength();
+    
+    // La velocidad máxima no alcanza la recta
+    if (discriminant < 0.0f)
+        return false;
+    
+    Ogre::Real sqrtDiscriminant = std::sqrt(discriminant);
+    Ogre::Real tLeft = -dotProduct - sqrtDiscriminant;
+    Ogre::Real tRight = -dotProduct + sqrtDiscriminant;
+    
+    // Recortamos el segmento con los semiplanos anteriores
+    for (int i = 0; i < lineNo; ++i) {
+        Ogre::Real denominator = line.direction.crossProduct(lines[i].direction);
+        Ogre::Real numerator = lines[i].direction.crossProduct(line.point - lines[i].point);
+        
+        if (std::fabs(denominator) <= EPSILON) {
+            if (numerator < 0.0f)
+                return false;
+            
+            continue;
+        }
+        
+        Ogre::Real t = numerator / denominator;
+        
+        if (denominator >= 0.0f)
+            tRight = std::min(tRight, t);
+        else
+            tLeft = std::max(tLeft, t);
+        
+        if (tLeft > tRight)
+            return false;
+    }
+    
+    if (directionOpt) {
+        if (optVelocity.dotProduct(line.direction) > 0.0f)
+            result = line.point + line.direction * tRight;
+        else
+            result = line.point + line.direction * tLeft;
+    }
+    else {
+        Ogre::Real t = line.direction.dotProduct(optVelocity - line.point);
+        
+        if (t < tLeft)
+            result = line.point + line.direction * tLeft;
+        else if (t > tRight)
+            result = line.point + line.direction * tRight;
+        else
+            result = line.point + line.direction * t;
+    }
+    
+    return true;
+}
+
+int VelocityObstacles::linearProgram2(const std::vector<Line>& lines,
+                                      Ogre::Real radius,
+                                      const Ogre::Vector2& optVelocity,
+                                      bool directionOpt,
+                                      Ogre::Vector2& result) {
+    if (directionOpt)
+        result = optVelocity * radius;
+    else if (optVelocity.squaredLength() > radius * radius)
+        result = optVelocity.normalisedCopy() * radius;
+    else
+        result = optVelocity;
+    
+    for (int i = 0; i < (int)lines.size(); ++i) {
+        // El resultado viola el semiplano i: lo buscamos sobre su recta
+        if (lines[i].direction.crossProduct(lines[i].point - result) > 0.0f) {
+            Ogre::Vector2 previous = result;
+            
+            if (!linearProgram1(lines, i, radius, optVelocity, directionOpt, result)) {
+                result = previous;
+                return i;
+            }
+        }
+    }
+    
+    return lines.size();
+}
+
+void VelocityObstacles::linearProgram3(int beginLine,
+                                       Ogre::Real radius,
+                                       Ogre::Vector2& result) {
+    Ogre::Real distance = 0.0f;
+    
+    for (int i = beginLine; i < (int)_lines.size(); ++i) {
+        const Line& line = _lines[i];
+        
+        if (line.direction.crossProduct(line.point - result) <= distance)
+            continue;
+        
+        // Minimizamos la máxima invasión proyectando sobre la recta i
+        _projectedLines.clear();
+        
+        for (int j = 0; j < i; ++j) {
+            Line projected;
+            Ogre::Real determinant = line.direction.crossProduct(_lines[j].direction);
+            
+            if (std::fabs(determinant) <= EPSILON) {
+                // Paralelas en el mismo sentido: no restringen
+                if (line.direction.dotProduct(_lines[j].direction) > 0.0f)
+                    continue;
+                
+                projected.point = (line.point + _lines[j].point) * 0.5f;
+            }
+            else {
+                projected.point = line.point + line.direction * (_lines[j].direction.crossProduct(line.point - _lines[j].point) / determinant);
+            }
+            
+            projected.direction = (_lines[j].direction - line.direction).normalisedCopy();
+            _projectedLines.push_back(projected);
+        }
+        
+        Ogre::Vector2 previous = result;
+        
+        if (linearProgram2(_projectedLines, radius, Ogre::Vector2(-line.direction.y, line.direction.x), true, result) < (int)_projectedLines.size())
+            result = previous;
+        
+        distance = line.direction.crossProduct(line.point - result);
+    }
+}